@@ -0,0 +1,922 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_definitions.h"
+#include "teamspeak/public_rare_definitions.h"
+#include "teamspeak/clientlib_publicdefinitions.h"
+#include "ts3_functions.h"
+#include "globals.h"
+#include "ts3_buffer.h"
+#include "call_timing.h"
+#include "trace.h"
+#include "roster.h"
+#include "roster_cache.h"
+#include "channel_tree.h"
+#include "subscriptions.h"
+#include "dispatcher.h"
+#include "filter.h"
+#include "client_columns.h"
+#include "server_groups.h"
+#include "channel_permissions.h"
+#include "connection_info.h"
+#include "actions.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static std::atomic<int> armed(0);
+static std::atomic<int> allConnections(0);  /* Global menu actions run on every connected server */
+
+static std::mutex timingsMutex;
+static struct ActionTimings lastTimings = { 0, 0, 0, 0 };
+static thread_local Clock::time_point snapshotTakenAt;  /* Of the kernel running on this thread */
+
+#define LIST_NAMES 30  /* Nicknames printed by the list command, the rest is only counted */
+#define CHANNEL_GROUP_CHUNK 100  /* Clients per setclientchannelgroup command, about 40 bytes each, far below the server's command size limit */
+#define PERMISSION_CHUNK 100     /* Permissions per channeladdperm resp. channeldelperm command, about 50 bytes each at most */
+
+/* Where the channel group of a channel group action comes from */
+enum ChannelGroupSource {
+	CHANNEL_GROUP_GIVEN = 0,  /* context.arguments->groupID */
+	CHANNEL_GROUP_DEFAULT,    /* What clients get when they join a channel */
+	CHANNEL_GROUP_ADMIN       /* What clients get when they create a channel */
+};
+
+/* Kernels call this once their snapshot is complete, the rest of the kernel counts as planning */
+static void snapshotTaken() {
+	snapshotTakenAt = Clock::now();
+}
+
+/* Sends one verb to one client. Verb is a constant, so the switch folds away in every instantiation. */
+template<int Verb>
+static void applyVerb(const struct ActionContext& context, anyID clientID, uint64 myChannel, int barrier) {
+	struct Request request(context.batchID, VERB_MOVE);
+	request.clientID = clientID;
+	request.barrier = barrier;
+	switch(Verb) {
+		case ACTION_MOVE_TO_OWN_CHANNEL:
+			request.verb = VERB_MOVE;
+			request.channelID = myChannel;
+			break;
+		case ACTION_MOVE_TO_SELECTED_CHANNEL:
+			request.verb = VERB_MOVE;
+			request.channelID = context.selectedItemID;
+			break;
+		case ACTION_KICK_FROM_CHANNEL:
+			request.verb = VERB_KICK_FROM_CHANNEL;
+			break;
+		case ACTION_KICK_FROM_SERVER:
+			request.verb = VERB_KICK_FROM_SERVER;
+			break;
+		case ACTION_GRANT_TALKER:
+		case ACTION_REVOKE_TALKER:
+			request.verb = VERB_SET_IS_TALKER;
+			request.value = (Verb == ACTION_GRANT_TALKER) ? 1 : 0;
+			break;
+	}
+	dispatchRequest(context.serverConnectionHandlerID, request);
+}
+
+/* Sends every verb of a composite action to one client, in the order they are listed */
+template<int... Verbs>
+static void applyVerbs(const struct ActionContext& context, anyID clientID, uint64 myChannel, int barrier) {
+	const int sequence[] = { (applyVerb<Verbs>(context, clientID, myChannel, barrier), 0)... };
+	(void)sequence;
+}
+
+/* Applies the verbs to a contiguous run of the roster, returns whether yourself was part of it. selection is NULL without a filter. */
+template<int Filter, int... Verbs>
+static int applyRange(const struct ActionContext& context, const struct ClientSelection* selection, const anyID* begin, const anyID* end, anyID myID, uint64 myChannel) {
+	int sawMe = 0;
+	for(const anyID* c = begin; c != end; c++) {
+		if(*c == myID) {
+			sawMe = 1;
+			if(Filter != FILTER_EVERYONE) {
+				continue;
+			}
+		}
+		if(selection && !selection->has(*c)) {
+			continue;
+		}
+		applyVerbs<Verbs...>(context, *c, myChannel, 0);
+	}
+	return sawMe;
+}
+
+/*
+ * The one scan kernel behind every client action. Composite actions list several verbs, the selected set is
+ * taken from one snapshot and each client gets all of its requests back to back in a single dispatch stream.
+ */
+template<int Scope, int Filter, int... Verbs>
+static void runClientAction(const struct ActionContext& context) {
+	struct Roster roster;
+	if(rosterCacheSnapshot(context.serverConnectionHandlerID, &roster) != ERROR_ok) {
+		return;
+	}
+	struct ClientSelection selection;
+	if(context.filter && !filterSelect(*context.filter, roster, context.cancelGeneration, &selection)) {
+		return;
+	}
+	const struct ClientSelection* selected = context.filter ? &selection : NULL;
+	snapshotTaken();
+
+	const uint64 scopeChannel = (Scope == SCOPE_OWN_CHANNEL || Scope == SCOPE_OUTSIDE_OWN_CHANNEL) ? roster.myChannel : context.selectedItemID;
+	int sawMe = 0;
+	if(Scope == SCOPE_OWN_CHANNEL || Scope == SCOPE_SELECTED_CHANNEL) {
+		sawMe = applyRange<Filter, Verbs...>(context, selected, roster.channelBegin(scopeChannel), roster.channelEnd(scopeChannel), roster.myID, roster.myChannel);
+	} else {
+		const anyID* clients = roster.clients.data();
+		for(size_t i = 0; i < roster.channels.size(); i++) {
+			if(Scope != SCOPE_SERVER && roster.channels[i] == scopeChannel) {
+				continue;
+			}
+			sawMe |= applyRange<Filter, Verbs...>(context, selected, clients + roster.offsets[i], clients + roster.offsets[i + 1], roster.myID, roster.myChannel);
+		}
+	}
+
+	if(Filter == FILTER_ME_LAST && sawMe && (!selected || selected->has(roster.myID))) {
+		applyVerbs<Verbs...>(context, roster.myID, roster.myChannel, 1);
+	}
+}
+
+/* Deleting a channel with force takes its whole subtree along, so only the topmost channels are sent */
+static void runDeleteAllChannels(const struct ActionContext& context) {
+	struct ChannelTree tree;
+	if(buildChannelTree(context.serverConnectionHandlerID, &tree) != ERROR_ok) {
+		return;
+	}
+	snapshotTaken();
+
+	std::vector<uint64> targets;
+	planForcedChannelDelete(tree, &targets);
+	for(size_t c = 0; c < targets.size(); c++) {
+		dispatchChannelDelete(context.serverConnectionHandlerID, context.batchID, targets[c], 1);
+	}
+}
+
+/*
+ * Deletes the empty subtrees without force, subchannels first. The snapshot may be seconds old when a request
+ * goes out, so nothing relies on it being still empty: each round waits behind a barrier until the round below
+ * is answered, and a client who joined meanwhile makes the server refuse their channel and every one above it
+ * instead of being kicked.
+ */
+static void runDeleteEmptyChannels(const struct ActionContext& context) {
+	struct ChannelTree tree;
+	struct Roster roster;
+	if(buildChannelTree(context.serverConnectionHandlerID, &tree) != ERROR_ok || rosterCacheSnapshot(context.serverConnectionHandlerID, &roster) != ERROR_ok) {
+		return;
+	}
+	snapshotTaken();
+
+	std::vector<std::vector<uint64> > rounds;
+	planEmptyChannelDelete(tree, roster, &rounds);
+	for(size_t r = 0; r < rounds.size(); r++) {
+		for(size_t c = 0; c < rounds[r].size(); c++) {
+			struct Request request(context.batchID, VERB_DELETE_CHANNEL);
+			request.channelID = rounds[r][c];
+			request.barrier = r > 0 && c == 0;
+			dispatchRequest(context.serverConnectionHandlerID, request);
+		}
+	}
+}
+
+/*
+ * Local mute is client side only, so it skips the dispatcher: the whole scope goes to the client lib as
+ * one zero-terminated array.
+ */
+template<int Scope, int Mute>
+static void runLocalMute(const struct ActionContext& context) {
+	struct Roster roster;
+	if(rosterCacheSnapshot(context.serverConnectionHandlerID, &roster) != ERROR_ok) {
+		return;
+	}
+
+	std::vector<uint64> channels;
+	if(Scope == SCOPE_SELECTED_SUBTREE) {
+		struct ChannelTree tree;
+		if(buildChannelTree(context.serverConnectionHandlerID, &tree) != ERROR_ok) {
+			return;
+		}
+		channelSubtree(tree, context.selectedItemID, &channels);
+	} else if(Scope == SCOPE_SELECTED_CHANNEL) {
+		channels.push_back(context.selectedItemID);
+	}
+	struct ClientSelection selection;
+	if(context.filter && !filterSelect(*context.filter, roster, context.cancelGeneration, &selection)) {
+		return;
+	}
+	snapshotTaken();
+
+	std::vector<anyID> targets;
+	if(Scope == SCOPE_SERVER) {
+		targets.reserve(roster.clients.size() + 1);
+		targets.assign(roster.clients.begin(), roster.clients.end());
+	} else {
+		for(size_t i = 0; i < channels.size(); i++) {
+			targets.insert(targets.end(), roster.channelBegin(channels[i]), roster.channelEnd(channels[i]));
+		}
+	}
+	targets.erase(std::remove(targets.begin(), targets.end(), roster.myID), targets.end());
+	if(context.filter) {
+		targets.erase(std::remove_if(targets.begin(), targets.end(), [&](anyID clientID) {
+			return !selection.has(clientID);
+		}), targets.end());
+	}
+	if(targets.empty()) {
+		return;
+	}
+	targets.push_back(0);
+
+	const unsigned int error = Mute ? ts3Functions.requestMuteClients(context.serverConnectionHandlerID, targets.data(), NULL)
+	                                : ts3Functions.requestUnmuteClients(context.serverConnectionHandlerID, targets.data(), NULL);
+	char message[128];
+	if(error == ERROR_ok) {
+		snprintf(message, sizeof(message), "[b]Mass actions:[/b] %s %u clients", Mute ? "muted" : "unmuted", (unsigned int)(targets.size() - 1));
+	} else {
+		snprintf(message, sizeof(message), "[b]Mass actions:[/b] %s %u clients failed with error %u", Mute ? "muting" : "unmuting", (unsigned int)(targets.size() - 1), error);
+	}
+	ts3Functions.printMessage(context.serverConnectionHandlerID, message, PLUGIN_MESSAGE_TARGET_SERVER);
+}
+
+/* Dry run of a command: names the clients a filter picks on the whole server, yourself excluded */
+static void runListClients(const struct ActionContext& context) {
+	struct Roster roster;
+	if(rosterCacheSnapshot(context.serverConnectionHandlerID, &roster) != ERROR_ok) {
+		return;
+	}
+	struct ClientSelection selection;
+	if(context.filter && !filterSelect(*context.filter, roster, context.cancelGeneration, &selection)) {
+		return;
+	}
+	snapshotTaken();
+
+	size_t matches = 0;
+	std::string names;
+	for(size_t i = 0; i < roster.clients.size(); i++) {
+		const anyID clientID = roster.clients[i];
+		if(clientID == roster.myID || (context.filter && !selection.has(clientID))) {
+			continue;
+		}
+		if(++matches > LIST_NAMES) {
+			continue;
+		}
+		Ts3Buffer<char> nickname;
+		if(ts3Functions.getClientVariableAsString(context.serverConnectionHandlerID, clientID, CLIENT_NICKNAME, nickname.out()) == ERROR_ok) {
+			names += (matches > 1 ? ", " : "") + std::string(nickname.get());
+		}
+	}
+	if(matches > LIST_NAMES) {
+		names += ", ...";
+	}
+
+	std::string message = "[b]Mass actions:[/b] " + std::to_string(matches) + " of " + std::to_string(roster.clients.size()) + " clients match";
+	if(matches) {
+		message += ": " + names;
+	}
+	ts3Functions.printMessage(context.serverConnectionHandlerID, message.c_str(), PLUGIN_MESSAGE_TARGET_SERVER);
+}
+
+/*
+ * Adds resp. removes the clients a filter picks to or from the given server group. The server addresses group
+ * changes by database ID, which every connection of a user shares, so the picked clients are collapsed to their
+ * database IDs first. The group's members are then asked for once and only database IDs whose membership
+ * actually changes get a request, everyone already in resp. not in the group costs nothing.
+ */
+template<int Add>
+static void runServerGroupChange(const struct ActionContext& context) {
+	struct Roster roster;
+	if(rosterCacheSnapshot(context.serverConnectionHandlerID, &roster) != ERROR_ok) {
+		return;
+	}
+	struct ClientSelection selection;
+	if(context.filter && !filterSelect(*context.filter, roster, context.cancelGeneration, &selection)) {
+		return;
+	}
+	struct ClientColumns columns;
+	if(clientColumnsSnapshot(roster, &columns) != ERROR_ok) {
+		return;
+	}
+
+	/* Database ID -> the first picked client of it, it stands for the user in reports and the journal */
+	std::map<uint64, anyID> targets;
+	size_t picked = 0;
+	for(size_t i = 0; i < columns.rows; i++) {
+		const anyID clientID = roster.clients[i];
+		if(clientID == roster.myID || (context.filter && !selection.has(clientID)) || !columns.databaseID[i]) {
+			continue;
+		}
+		picked++;
+		targets.insert(std::make_pair(columns.databaseID[i], clientID));
+	}
+	if(targets.empty()) {
+		ts3Functions.printMessage(context.serverConnectionHandlerID, "[b]Mass actions:[/b] No clients match", PLUGIN_MESSAGE_TARGET_SERVER);
+		return;
+	}
+
+	std::vector<uint64> members;
+	if(!serverGroupMembers(context.serverConnectionHandlerID, context.arguments->groupID, context.cancelGeneration, &members)) {
+		return;  /* The listing's own report says why */
+	}
+	snapshotTaken();
+
+	size_t changes = 0;
+	for(std::map<uint64, anyID>::const_iterator it = targets.begin(); it != targets.end(); ++it) {
+		if(std::binary_search(members.begin(), members.end(), it->first) == (Add != 0)) {
+			continue;
+		}
+		if(Add) {
+			dispatchAddToGroup(context.serverConnectionHandlerID, context.batchID, context.arguments->groupID, it->first, it->second);
+		} else {
+			dispatchRemoveFromGroup(context.serverConnectionHandlerID, context.batchID, context.arguments->groupID, it->first, it->second);
+		}
+		changes++;
+	}
+
+	char message[256];
+	snprintf(message, sizeof(message), "[b]Mass actions:[/b] %u matching clients are %u users, %u of them %s server group %llu already",
+		(unsigned int)picked, (unsigned int)targets.size(), (unsigned int)(targets.size() - changes), Add ? "are in" : "are not in", (long long unsigned int)context.arguments->groupID);
+	ts3Functions.printMessage(context.serverConnectionHandlerID, message, PLUGIN_MESSAGE_TARGET_SERVER);
+}
+
+/*
+ * Gives clients a channel group in the channel they are in: everyone in the selected channel from the menu, the
+ * clients a filter picks from a command. The client lib takes arrays, so a whole channel goes out in one
+ * command per CHANNEL_GROUP_CHUNK clients instead of one per client. A channel group belongs to a database ID
+ * in a channel, connections of one user in one channel are one entry and clients that have the group already
+ * are left out.
+ */
+template<int Source>
+static void runSetChannelGroup(const struct ActionContext& context) {
+	uint64 groupID = context.arguments->groupID;
+	if(Source != CHANNEL_GROUP_GIVEN) {
+		const size_t flag = (Source == CHANNEL_GROUP_ADMIN) ? VIRTUALSERVER_DEFAULT_CHANNEL_ADMIN_GROUP : VIRTUALSERVER_DEFAULT_CHANNEL_GROUP;
+		if(ts3Functions.getServerVariableAsUInt64(context.serverConnectionHandlerID, flag, &groupID) != ERROR_ok || !groupID) {
+			ts3Functions.printMessage(context.serverConnectionHandlerID, "[b]Mass actions:[/b] The server did not tell which channel group that is", PLUGIN_MESSAGE_TARGET_SERVER);
+			return;
+		}
+	}
+
+	struct Roster roster;
+	if(rosterCacheSnapshot(context.serverConnectionHandlerID, &roster) != ERROR_ok) {
+		return;
+	}
+	struct ClientSelection selection;
+	if(context.filter && !filterSelect(*context.filter, roster, context.cancelGeneration, &selection)) {
+		return;
+	}
+	struct ClientColumns columns;
+	if(clientColumnsSnapshot(roster, &columns) != ERROR_ok) {
+		return;
+	}
+	snapshotTaken();
+
+	std::set<std::pair<uint64, uint64> > changes;  /* Channel, database ID */
+	size_t picked = 0;
+	for(size_t c = 0; c < roster.channels.size(); c++) {
+		if(!context.filter && roster.channels[c] != context.selectedItemID) {
+			continue;
+		}
+		for(size_t i = roster.offsets[c]; i < roster.offsets[c + 1]; i++) {
+			if(roster.clients[i] == roster.myID || (context.filter && !selection.has(roster.clients[i])) || !columns.databaseID[i]) {
+				continue;
+			}
+			picked++;
+			if(columns.channelGroup[i] != groupID) {
+				changes.insert(std::make_pair(roster.channels[c], columns.databaseID[i]));
+			}
+		}
+	}
+
+	std::vector<uint64> entries;
+	size_t commands = 0;
+	for(std::set<std::pair<uint64, uint64> >::const_iterator it = changes.begin(); it != changes.end(); ++it) {
+		entries.push_back(it->first);
+		entries.push_back(it->second);
+		if(entries.size() == 2 * CHANNEL_GROUP_CHUNK) {
+			dispatchSetChannelGroups(context.serverConnectionHandlerID, context.batchID, groupID, entries);
+			entries.clear();
+			commands++;
+		}
+	}
+	if(!entries.empty()) {
+		dispatchSetChannelGroups(context.serverConnectionHandlerID, context.batchID, groupID, entries);
+		commands++;
+	}
+
+	char message[256];
+	snprintf(message, sizeof(message), "[b]Mass actions:[/b] %u clients, %u of them get channel group %llu in %u commands",
+		(unsigned int)picked, (unsigned int)changes.size(), (long long unsigned int)groupID, (unsigned int)commands);
+	ts3Functions.printMessage(context.serverConnectionHandlerID, message, PLUGIN_MESSAGE_TARGET_SERVER);
+}
+
+/*
+ * Bans the clients a filter picks by address. banclient bans one connection's identity and address, so a raid
+ * from a few addresses under many identities fills the ban list with duplicates. Here the addresses are asked
+ * for first and the clients grouped by them: every address gets one banadd, and since an address ban
+ * disconnects nobody, its clients online are kicked. Only clients whose address the server did not tell get
+ * banclient. Every ban lasts the given duration, bans and kicks carry the given reason. Clients sharing
+ * your own address are left alone, banning it would ban you, and without your own address nothing is banned.
+ */
+static void runBanByAddress(const struct ActionContext& context) {
+	struct Roster roster;
+	if(rosterCacheSnapshot(context.serverConnectionHandlerID, &roster) != ERROR_ok) {
+		return;
+	}
+	struct ClientSelection selection;
+	if(context.filter && !filterSelect(*context.filter, roster, context.cancelGeneration, &selection)) {
+		return;
+	}
+	std::vector<anyID> clients;
+	for(size_t i = 0; i < roster.clients.size(); i++) {
+		if(roster.clients[i] != roster.myID && (!context.filter || selection.has(roster.clients[i]))) {
+			clients.push_back(roster.clients[i]);
+		}
+	}
+	if(clients.empty()) {
+		return;
+	}
+	const size_t picked = clients.size();
+	clients.push_back(roster.myID);
+	std::map<anyID, std::string> addresses;
+	if(!connectionAddresses(context.serverConnectionHandlerID, clients, context.cancelGeneration, &addresses)) {
+		return;
+	}
+	clients.pop_back();
+	snapshotTaken();
+
+	/* Without your own address nothing tells which bans would hit you */
+	const std::map<anyID, std::string>::const_iterator mine = addresses.find(roster.myID);
+	if(mine == addresses.end()) {
+		ts3Functions.printMessage(context.serverConnectionHandlerID, "[b]Mass actions:[/b] The server did not tell your own address, nobody was banned", PLUGIN_MESSAGE_TARGET_SERVER);
+		return;
+	}
+	const std::string myAddress = mine->second;
+	std::map<std::string, std::vector<anyID> > byAddress;
+	std::vector<anyID> unknown;
+	size_t spared = 0;
+	for(size_t i = 0; i < clients.size(); i++) {
+		const std::map<anyID, std::string>::const_iterator it = addresses.find(clients[i]);
+		if(it == addresses.end()) {
+			unknown.push_back(clients[i]);
+		} else if(it->second == myAddress) {
+			spared++;
+		} else {
+			byAddress[it->second].push_back(clients[i]);
+		}
+	}
+
+	uint64 seconds = context.arguments->banSeconds;
+	const std::string& reason = context.arguments->banReason;
+	for(std::map<std::string, std::vector<anyID> >::const_iterator it = byAddress.begin(); it != byAddress.end(); ++it) {
+		dispatchBanAddress(context.serverConnectionHandlerID, context.batchID, it->first, it->second.front(), seconds, reason);
+		for(size_t i = 0; i < it->second.size(); i++) {
+			struct Request kick(context.batchID, VERB_KICK_FROM_SERVER);
+			kick.clientID = it->second[i];
+			kick.reason = reason;
+			dispatchRequest(context.serverConnectionHandlerID, kick);
+		}
+	}
+	for(size_t i = 0; i < unknown.size(); i++) {
+		dispatchBanClient(context.serverConnectionHandlerID, context.batchID, unknown[i], seconds, reason);
+	}
+
+	char message[256];
+	snprintf(message, sizeof(message), "[b]Mass actions:[/b] %u matching clients, banned for %s: %u addresses, %u clients one by one, %u left alone as they share your address",
+		(unsigned int)picked, filterFormatDuration(seconds * 1000).c_str(), (unsigned int)byAddress.size(), (unsigned int)unknown.size(), (unsigned int)spared);
+	ts3Functions.printMessage(context.serverConnectionHandlerID, message, PLUGIN_MESSAGE_TARGET_SERVER);
+}
+
+enum PermissionTargets {
+	PERMISSION_TARGETS_SUBCHANNELS,
+	PERMISSION_TARGETS_SIBLINGS  /* Channels with the same parent */
+};
+
+/*
+ * Makes the permissions of other channels those of the selected one. The server lists permissions per
+ * channel, so the source and every target are asked for once, together, and only the difference is sent:
+ * per target commands of up to PERMISSION_CHUNK permissions setting what is missing or has another value and
+ * removing what the source does not have, a target that matches already costs nothing.
+ */
+template<int Targets>
+static void runClonePermissions(const struct ActionContext& context) {
+	struct ChannelTree tree;
+	if(buildChannelTree(context.serverConnectionHandlerID, &tree) != ERROR_ok) {
+		return;
+	}
+	const int source = tree.findChannel(context.selectedItemID);
+	if(source < 0) {
+		return;
+	}
+	std::vector<uint64> targets;
+	if(Targets == PERMISSION_TARGETS_SUBCHANNELS) {
+		channelSubtree(tree, context.selectedItemID, &targets);
+		targets.erase(std::remove(targets.begin(), targets.end(), context.selectedItemID), targets.end());
+	} else {
+		for(size_t c = 0; c < tree.channels.size(); c++) {
+			if((int)c != source && tree.parents[c] == tree.parents[source]) {
+				targets.push_back(tree.channels[c]);
+			}
+		}
+	}
+	if(targets.empty()) {
+		ts3Functions.printMessage(context.serverConnectionHandlerID, "[b]Mass actions:[/b] There are no channels to copy the permissions to", PLUGIN_MESSAGE_TARGET_SERVER);
+		return;
+	}
+
+	std::vector<uint64> channels(targets);
+	channels.push_back(context.selectedItemID);
+	std::map<uint64, ChannelPermissions> permissions;
+	if(!channelPermissionsFetch(context.serverConnectionHandlerID, channels, context.cancelGeneration, &permissions)) {
+		return;
+	}
+	snapshotTaken();
+
+	const ChannelPermissions& wanted = permissions[context.selectedItemID];
+	size_t differing = 0, set = 0, removed = 0;
+	for(size_t t = 0; t < targets.size(); t++) {
+		const ChannelPermissions& current = permissions[targets[t]];
+		std::vector<uint64> add, remove;
+		for(ChannelPermissions::const_iterator it = wanted.begin(); it != wanted.end(); ++it) {
+			const ChannelPermissions::const_iterator has = current.find(it->first);
+			if(has == current.end() || has->second != it->second) {
+				add.push_back(it->first);
+				add.push_back((unsigned int)it->second);
+			}
+		}
+		for(ChannelPermissions::const_iterator it = current.begin(); it != current.end(); ++it) {
+			if(!wanted.count(it->first)) {
+				remove.push_back(it->first);
+			}
+		}
+		for(size_t i = 0; i < add.size(); i += 2 * PERMISSION_CHUNK) {
+			const std::vector<uint64> chunk(add.begin() + i, add.begin() + std::min(add.size(), i + 2 * PERMISSION_CHUNK));
+			dispatchAddChannelPermissions(context.serverConnectionHandlerID, context.batchID, targets[t], chunk);
+		}
+		for(size_t i = 0; i < remove.size(); i += PERMISSION_CHUNK) {
+			const std::vector<uint64> chunk(remove.begin() + i, remove.begin() + std::min(remove.size(), i + PERMISSION_CHUNK));
+			dispatchDeleteChannelPermissions(context.serverConnectionHandlerID, context.batchID, targets[t], chunk);
+		}
+		differing += !add.empty() || !remove.empty();
+		set += add.size() / 2;
+		removed += remove.size();
+	}
+
+	char message[256];
+	snprintf(message, sizeof(message), "[b]Mass actions:[/b] %u channels, %u of them differ: %u permissions set, %u removed",
+		(unsigned int)targets.size(), (unsigned int)differing, (unsigned int)set, (unsigned int)removed);
+	ts3Functions.printMessage(context.serverConnectionHandlerID, message, PLUGIN_MESSAGE_TARGET_SERVER);
+}
+
+/* Scopes reaching beyond the channels the user picked need every channel subscribed, the selected channel needs only itself */
+#define VIEW(scope) ((scope) == SCOPE_OWN_CHANNEL ? VIEW_SUBSCRIBED : (scope) == SCOPE_SELECTED_CHANNEL ? VIEW_SELECTED_CHANNEL : VIEW_SERVER)
+
+#define HEADER(type, id, text) { type, id, text, NULL, NULL, GUARD_NONE, VIEW_SUBSCRIBED }
+/* The verbs of a composite action are applied in the order listed */
+#define CLIENT_ACTION(type, id, text, name, scope, filter, ...) { type, id, text, name, &runClientAction<scope, filter, __VA_ARGS__>, GUARD_NONE, VIEW(scope) }
+#define LOCAL_MUTE(type, id, text, name, scope, mute) { type, id, text, name, &runLocalMute<scope, mute>, GUARD_NONE, VIEW(scope) }
+
+static const struct ActionDescriptor actions[] = {
+	HEADER(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_1, "[MOVING]"),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_2, "Move all clients into own channel", "Move everyone into your channel", SCOPE_OUTSIDE_OWN_CHANNEL, FILTER_EVERYONE, ACTION_MOVE_TO_OWN_CHANNEL),
+	HEADER(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_25, ""),
+	HEADER(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_3, "[KICKING]"),
+	HEADER(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_4, "=[clients in channel]"),
+	HEADER(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_5, "==[from channel]"),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_6, "everyone (but you)", "Kick your channel from channel (but you)", SCOPE_OWN_CHANNEL, FILTER_NOT_ME, ACTION_KICK_FROM_CHANNEL),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_7, "everyone", "Kick your channel from channel", SCOPE_OWN_CHANNEL, FILTER_EVERYONE, ACTION_KICK_FROM_CHANNEL),
+	HEADER(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_8, "==[from server]"),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_9, "everyone (but you)", "Kick your channel from server (but you)", SCOPE_OWN_CHANNEL, FILTER_NOT_ME, ACTION_KICK_FROM_SERVER),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_10, "everyone", "Kick your channel from server", SCOPE_OWN_CHANNEL, FILTER_ME_LAST, ACTION_KICK_FROM_SERVER),
+	HEADER(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_11, "=[clients in server]"),
+	HEADER(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_12, "==[from channel]"),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_13, "everyone (but you)", "Kick the server from channel (but you)", SCOPE_SERVER, FILTER_NOT_ME, ACTION_KICK_FROM_CHANNEL),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_14, "everyone", "Kick the server from channel", SCOPE_SERVER, FILTER_EVERYONE, ACTION_KICK_FROM_CHANNEL),
+	HEADER(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_15, "==[from server]"),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_16, "everyone (but you)", "Kick the server from server (but you)", SCOPE_SERVER, FILTER_NOT_ME, ACTION_KICK_FROM_SERVER),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_17, "everyone", "Kick the server from server", SCOPE_SERVER, FILTER_ME_LAST, ACTION_KICK_FROM_SERVER),
+	HEADER(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_26, ""),
+	HEADER(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_28, "[TALKPOWER]"),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_18, "Give everyone talkpower", "Give your channel talkpower", SCOPE_OWN_CHANNEL, FILTER_EVERYONE, ACTION_GRANT_TALKER),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_19, "Take everyones talkpower", "Take your channel's talkpower", SCOPE_OWN_CHANNEL, FILTER_EVERYONE, ACTION_REVOKE_TALKER),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_29, "Take talkpower, then kick from channel (but you)", "Take talkpower and kick your channel (but you)", SCOPE_OWN_CHANNEL, FILTER_NOT_ME, ACTION_REVOKE_TALKER, ACTION_KICK_FROM_CHANNEL),
+	HEADER(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_27, ""),
+	HEADER(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_30, "[LOCAL MUTE]"),
+	LOCAL_MUTE(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_31, "Mute everyone on the server", "Mute the server", SCOPE_SERVER, 1),
+	LOCAL_MUTE(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_32, "Unmute everyone on the server", "Unmute the server", SCOPE_SERVER, 0),
+	HEADER(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_33, ""),
+	HEADER(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_20, "[MISC]"),
+	{ PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_34, "Run on all connections", NULL, NULL, GUARD_ALL_CONNECTIONS_ON, VIEW_SUBSCRIBED },
+	{ PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_35, "Run on this connection only", NULL, NULL, GUARD_ALL_CONNECTIONS_OFF, VIEW_SUBSCRIBED },
+	{ PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_36, "Time client lib calls", NULL, NULL, GUARD_CALL_TIMING_ON, VIEW_SUBSCRIBED },
+	{ PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_37, "Stop timing client lib calls", NULL, NULL, GUARD_CALL_TIMING_OFF, VIEW_SUBSCRIBED },
+	{ PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_38, "Record timelines", NULL, NULL, GUARD_TRACE_ON, VIEW_SUBSCRIBED },
+	{ PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_39, "Stop recording timelines", NULL, NULL, GUARD_TRACE_OFF, VIEW_SUBSCRIBED },
+	{ PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_21, "ACTIVATE FOR THIS SESSION", NULL, NULL, GUARD_ARM, VIEW_SUBSCRIBED },
+	{ PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_22, "DEACTIVATE FOR THIS SESSION", NULL, NULL, GUARD_DISARM, VIEW_SUBSCRIBED },
+	{ PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_23, "Delete every channel", "Delete every channel", &runDeleteAllChannels, GUARD_ARMED, VIEW_SUBSCRIBED },
+	{ PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_24, "Delete every empty channel", "Delete every empty channel", &runDeleteEmptyChannels, GUARD_ARMED, VIEW_SERVER },
+
+	/* CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL */
+
+	HEADER(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_1, "[MOVING]"),
+	HEADER(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_11, "=[from this channel]"),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_2, "to your channel", "Move channel into your channel", SCOPE_SELECTED_CHANNEL, FILTER_EVERYONE, ACTION_MOVE_TO_OWN_CHANNEL),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_15, "to your channel, then take talkpower", "Move channel into your channel and take talkpower", SCOPE_SELECTED_CHANNEL, FILTER_NOT_ME, ACTION_MOVE_TO_OWN_CHANNEL, ACTION_REVOKE_TALKER),
+	HEADER(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_12, "=[to this channel]"),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_13, "your channel", "Move your channel into channel", SCOPE_OWN_CHANNEL, FILTER_EVERYONE, ACTION_MOVE_TO_SELECTED_CHANNEL),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_14, "whole server", "Move everyone into channel", SCOPE_OUTSIDE_SELECTED_CHANNEL, FILTER_EVERYONE, ACTION_MOVE_TO_SELECTED_CHANNEL),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_16, "whole server, then take talkpower", "Move everyone into channel and take talkpower", SCOPE_OUTSIDE_SELECTED_CHANNEL, FILTER_NOT_ME, ACTION_MOVE_TO_SELECTED_CHANNEL, ACTION_REVOKE_TALKER),
+	HEADER(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_3, ""),
+	HEADER(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_4, "[KICKING]"),
+	HEADER(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_5, "=[from channel]"),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_6, "everyone (but you)", "Kick channel from channel (but you)", SCOPE_SELECTED_CHANNEL, FILTER_NOT_ME, ACTION_KICK_FROM_CHANNEL),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_7, "everyone", "Kick channel from channel", SCOPE_SELECTED_CHANNEL, FILTER_EVERYONE, ACTION_KICK_FROM_CHANNEL),
+	HEADER(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_8, "=[from server]"),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_9, "everyone (but you)", "Kick channel from server (but you)", SCOPE_SELECTED_CHANNEL, FILTER_NOT_ME, ACTION_KICK_FROM_SERVER),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_10, "everyone", "Kick channel from server", SCOPE_SELECTED_CHANNEL, FILTER_ME_LAST, ACTION_KICK_FROM_SERVER),
+	HEADER(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_17, ""),
+	HEADER(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_18, "[LOCAL MUTE]"),
+	LOCAL_MUTE(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_19, "mute this channel", "Mute channel", SCOPE_SELECTED_CHANNEL, 1),
+	LOCAL_MUTE(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_20, "unmute this channel", "Unmute channel", SCOPE_SELECTED_CHANNEL, 0),
+	LOCAL_MUTE(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_21, "mute this channel and its subchannels", "Mute channel tree", SCOPE_SELECTED_SUBTREE, 1),
+	LOCAL_MUTE(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_22, "unmute this channel and its subchannels", "Unmute channel tree", SCOPE_SELECTED_SUBTREE, 0),
+	HEADER(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_23, ""),
+	HEADER(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_24, "[CHANNEL GROUP]"),
+	{ PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_25, "everyone (but you): default channel group", "Give channel the default channel group", &runSetChannelGroup<CHANNEL_GROUP_DEFAULT>, GUARD_NONE, VIEW_SELECTED_CHANNEL },
+	{ PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_26, "everyone (but you): channel admin", "Make channel channel admins", &runSetChannelGroup<CHANNEL_GROUP_ADMIN>, GUARD_NONE, VIEW_SELECTED_CHANNEL },
+	HEADER(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_27, ""),
+	HEADER(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_28, "[PERMISSIONS]"),
+	{ PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_29, "copy to its subchannels", "Copy channel permissions to subchannels", &runClonePermissions<PERMISSION_TARGETS_SUBCHANNELS>, GUARD_ARMED, VIEW_SUBSCRIBED },
+	{ PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_30, "copy to the channels next to it", "Copy channel permissions to sibling channels", &runClonePermissions<PERMISSION_TARGETS_SIBLINGS>, GUARD_ARMED, VIEW_SUBSCRIBED }
+};
+
+/* Chat commands, "/mass <verb> <filter>". Every client action leaves yourself out, you are not part of a filter's targets. */
+static const struct ActionDescriptor commands[] = {
+	{ PLUGIN_MENU_TYPE_GLOBAL, -1, "list", "List matching clients", &runListClients, GUARD_NONE, VIEW_SERVER },
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, -1, "kick", "Kick matching clients from server", SCOPE_SERVER, FILTER_NOT_ME, ACTION_KICK_FROM_SERVER),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, -1, "chkick", "Kick matching clients from channel", SCOPE_SERVER, FILTER_NOT_ME, ACTION_KICK_FROM_CHANNEL),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, -1, "move", "Move matching clients into your channel", SCOPE_OUTSIDE_OWN_CHANNEL, FILTER_NOT_ME, ACTION_MOVE_TO_OWN_CHANNEL),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, -1, "talk", "Give matching clients talkpower", SCOPE_SERVER, FILTER_NOT_ME, ACTION_GRANT_TALKER),
+	CLIENT_ACTION(PLUGIN_MENU_TYPE_GLOBAL, -1, "untalk", "Take talkpower of matching clients", SCOPE_SERVER, FILTER_NOT_ME, ACTION_REVOKE_TALKER),
+	LOCAL_MUTE(PLUGIN_MENU_TYPE_GLOBAL, -1, "mute", "Mute matching clients", SCOPE_SERVER, 1),
+	LOCAL_MUTE(PLUGIN_MENU_TYPE_GLOBAL, -1, "unmute", "Unmute matching clients", SCOPE_SERVER, 0),
+	{ PLUGIN_MENU_TYPE_GLOBAL, -1, "groupadd", "Add matching clients to server group", &runServerGroupChange<1>, GUARD_NONE, VIEW_SERVER },
+	{ PLUGIN_MENU_TYPE_GLOBAL, -1, "groupdel", "Remove matching clients from server group", &runServerGroupChange<0>, GUARD_NONE, VIEW_SERVER },
+	{ PLUGIN_MENU_TYPE_GLOBAL, -1, "chgroup", "Give matching clients channel group", &runSetChannelGroup<CHANNEL_GROUP_GIVEN>, GUARD_NONE, VIEW_SERVER },
+	{ PLUGIN_MENU_TYPE_GLOBAL, -1, "ban", "Ban the addresses of matching clients", &runBanByAddress, GUARD_ARMED, VIEW_SERVER }
+};
+
+#undef HEADER
+#undef CLIENT_ACTION
+#undef LOCAL_MUTE
+#undef VIEW
+
+const struct ActionDescriptor* actionTable(size_t* count) {
+	*count = sizeof(actions) / sizeof(actions[0]);
+	return actions;
+}
+
+const struct ActionDescriptor* actionCommands(size_t* count) {
+	*count = sizeof(commands) / sizeof(commands[0]);
+	return commands;
+}
+
+const struct ActionDescriptor* actionFindCommand(const char* verb) {
+	for(size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+		if(!strcmp(commands[i].text, verb)) {
+			return &commands[i];
+		}
+	}
+	return NULL;
+}
+
+int actionTakesGroup(const struct ActionDescriptor* action) {
+	return action->run == &runServerGroupChange<1> || action->run == &runServerGroupChange<0> || action->run == &runSetChannelGroup<CHANNEL_GROUP_GIVEN>;
+}
+
+int actionTakesBanTerms(const struct ActionDescriptor* action) {
+	return action->run == &runBanByAddress;
+}
+
+const struct ActionDescriptor* actionFind(enum PluginMenuType type, int menuID) {
+	for(size_t i = 0; i < sizeof(actions) / sizeof(actions[0]); i++) {
+		if(actions[i].type == type && actions[i].menuID == menuID) {
+			return &actions[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Runs an action on several connections at once. The subscriptions of all of them are requested before
+ * waiting for any, and each connection gets its own batch, so the dispatcher paces and reports them
+ * independently and the slowest server alone decides how long it takes.
+ */
+static void runOnConnections(const struct ActionDescriptor* action, const std::vector<uint64>& connections, uint64 selectedItemID, const struct ClientFilter* filter, const struct CommandArguments& arguments) {
+	if(!action->run || (action->guard == GUARD_ARMED && !armed.load())) {
+		return;
+	}
+	/* Filtered runs say in their report which clients they were about */
+	std::string name = action->name;
+	if(arguments.groupID) {
+		name += " " + std::to_string(arguments.groupID);
+	}
+	if(arguments.banSeconds) {
+		name += " for " + filterFormatDuration(arguments.banSeconds * 1000);
+	}
+	if(filter) {
+		name += ": " + filter->text;
+	}
+	ts3BufferResetActionPeak();
+	struct ActionTimings timings = { 0, 0, 0, 0 };
+	const uint64 generation = dispatchCancelGeneration();  /* The abort hotkey bumps it, whatever step we are in */
+
+	/* A connection that does not show all its clients is left alone, acting on part of a server would surprise */
+	std::vector<struct SubscribeTicket> tickets(connections.size());
+	std::vector<int> complete(connections.size(), 1);
+	const Clock::time_point subscribeStarted = Clock::now();
+	if(action->view != VIEW_SUBSCRIBED) {
+		for(size_t i = 0; i < connections.size(); i++) {
+			if(action->view == VIEW_SELECTED_CHANNEL) {
+				complete[i] = subscribeChannel(connections[i], selectedItemID, &tickets[i]) == ERROR_ok;
+			} else {
+				complete[i] = subscribeMissingChannels(connections[i], &tickets[i]) == ERROR_ok;
+			}
+		}
+		for(size_t i = 0; i < connections.size(); i++) {
+			complete[i] = waitForSubscriptions(tickets[i], generation) && complete[i];
+		}
+	}
+	const Clock::time_point subscribed = Clock::now();
+	timings.subscribeSeconds = std::chrono::duration<double>(subscribed - subscribeStarted).count();
+
+	/*
+	 * Kernels wait for the answers to what they ask the server, so with several connections each runs on a
+	 * thread of its own and every server answers at the same time. The job ends once all of them are done.
+	 */
+	std::vector<double> snapshotSeconds(connections.size(), 0), planSeconds(connections.size(), 0);
+	auto runConnection = [&](size_t i) {
+		if(dispatchCancelGeneration() != generation) {
+			restoreSubscriptions(tickets[i]);
+			const std::string message = "[b]Mass actions:[/b] " + name + " aborted, nothing was done";
+			ts3Functions.printMessage(connections[i], message.c_str(), PLUGIN_MESSAGE_TARGET_SERVER);
+			return;
+		}
+		if(!complete[i]) {
+			restoreSubscriptions(tickets[i]);
+			const std::string message = "[b]Mass actions:[/b] " + name + ": not every channel could be subscribed, so not every client is known, nothing was done";
+			ts3Functions.printMessage(connections[i], message.c_str(), PLUGIN_MESSAGE_TARGET_SERVER);
+			return;
+		}
+
+		/* Everything the kernel dispatches is reported as one batch, kernels that send nothing leave it empty */
+		struct ActionContext context;
+		context.serverConnectionHandlerID = connections[i];
+		context.batchID = dispatchBeginBatch(connections[i], name.c_str());
+		context.selectedItemID = selectedItemID;
+		context.filter = filter;
+		context.arguments = &arguments;
+		context.cancelGeneration = generation;
+
+		const Clock::time_point started = Clock::now();
+		snapshotTakenAt = started;
+		action->run(context);
+		const Clock::time_point planned = Clock::now();
+		snapshotSeconds[i] = std::chrono::duration<double>(snapshotTakenAt - started).count();
+		planSeconds[i] = std::chrono::duration<double>(planned - snapshotTakenAt).count();
+		if(action->view != VIEW_SUBSCRIBED) {
+			tracePhase(context.batchID, "subscribe", subscribeStarted, subscribed);
+		}
+		tracePhase(context.batchID, "snapshot", started, snapshotTakenAt);
+		tracePhase(context.batchID, "plan", snapshotTakenAt, planned);
+
+		/* Requests address clients by ID, so the subscriptions can go back as soon as everything is queued */
+		restoreSubscriptions(tickets[i]);
+		if(dispatchCancelGeneration() != generation) {
+			dispatchCancelBatch(context.batchID);  /* What the kernel queued after the abort must not go out */
+		} else {
+			dispatchEndBatch(context.batchID);
+		}
+	};
+	if(connections.size() == 1) {
+		runConnection(0);
+	} else {
+		std::vector<std::thread> threads;
+		for(size_t i = 0; i < connections.size(); i++) {
+			threads.push_back(std::thread(runConnection, i));
+		}
+		for(size_t i = 0; i < threads.size(); i++) {
+			threads[i].join();
+		}
+	}
+	for(size_t i = 0; i < connections.size(); i++) {
+		timings.snapshotSeconds += snapshotSeconds[i];
+		timings.planSeconds += planSeconds[i];
+	}
+
+	std::lock_guard<std::mutex> lock(timingsMutex);
+	timings.runs = lastTimings.runs + 1;
+	lastTimings = timings;
+}
+
+void actionRun(const struct ActionDescriptor* action, uint64 serverConnectionHandlerID, uint64 selectedItemID) {
+	runOnConnections(action, std::vector<uint64>(1, serverConnectionHandlerID), selectedItemID, NULL, CommandArguments());
+}
+
+static std::vector<uint64> establishedConnections() {
+	std::vector<uint64> connections;
+	Ts3Buffer<uint64> handlerList;
+	if(ts3Functions.getServerConnectionHandlerList(handlerList.out()) != ERROR_ok) {
+		return connections;
+	}
+	for(size_t i = 0; i < handlerList.size(); i++) {
+		int status;
+		if(ts3Functions.getConnectionStatus(handlerList[i], &status) == ERROR_ok && status == STATUS_CONNECTION_ESTABLISHED) {
+			connections.push_back(handlerList[i]);
+		}
+	}
+	return connections;
+}
+
+void actionRunOnAllConnections(const struct ActionDescriptor* action) {
+	runOnConnections(action, establishedConnections(), 0, NULL, CommandArguments());
+}
+
+void actionRunFiltered(const struct ActionDescriptor* action, uint64 serverConnectionHandlerID, const struct ClientFilter& filter, const struct CommandArguments& arguments) {
+	runOnConnections(action, std::vector<uint64>(1, serverConnectionHandlerID), 0, &filter, arguments);
+}
+
+void actionRunFilteredOnAllConnections(const struct ActionDescriptor* action, const struct ClientFilter& filter, const struct CommandArguments& arguments) {
+	runOnConnections(action, establishedConnections(), 0, &filter, arguments);
+}
+
+void actionLastTimings(struct ActionTimings* timings) {
+	std::lock_guard<std::mutex> lock(timingsMutex);
+	*timings = lastTimings;
+}
+
+int actionsOnAllConnections() {
+	return allConnections.load();
+}
+
+int actionsArmed() {
+	return armed.load();
+}
+
+/* Of a pair of switch items only the one that changes something is enabled */
+static void enableSwitch(enum ActionGuard onGuard, enum ActionGuard offGuard, int isOn) {
+	for(size_t i = 0; i < sizeof(actions) / sizeof(actions[0]); i++) {
+		if(actions[i].guard == onGuard) {
+			ts3Functions.setPluginMenuEnabled(pluginID, actions[i].menuID, !isOn);
+		} else if(actions[i].guard == offGuard) {
+			ts3Functions.setPluginMenuEnabled(pluginID, actions[i].menuID, isOn);
+		}
+	}
+}
+
+void actionsSetAllConnections(int enabled) {
+	allConnections.store(enabled ? 1 : 0);
+	enableSwitch(GUARD_ALL_CONNECTIONS_ON, GUARD_ALL_CONNECTIONS_OFF, enabled);
+}
+
+void actionsSetCallTiming(int enabled) {
+	callTimingSetEnabled(enabled);
+	enableSwitch(GUARD_CALL_TIMING_ON, GUARD_CALL_TIMING_OFF, enabled);
+}
+
+void actionsSetTracing(int enabled) {
+	traceSetEnabled(enabled);
+	enableSwitch(GUARD_TRACE_ON, GUARD_TRACE_OFF, enabled);
+}
+
+void actionsSetArmed(int isArmed) {
+	armed.store(isArmed ? 1 : 0);
+	for(size_t i = 0; i < sizeof(actions) / sizeof(actions[0]); i++) {
+		switch(actions[i].guard) {
+			case GUARD_ARMED:
+			case GUARD_DISARM:
+				ts3Functions.setPluginMenuEnabled(pluginID, actions[i].menuID, isArmed);
+				break;
+			case GUARD_ARM:
+				ts3Functions.setPluginMenuEnabled(pluginID, actions[i].menuID, !isArmed);
+				break;
+			default:
+				break;
+		}
+	}
+}
@@ -0,0 +1,232 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef ACTIONS_H
+#define ACTIONS_H
+
+#include <stddef.h>
+#include <string>
+#include "teamspeak/public_definitions.h"
+#include "plugin_definitions.h"
+
+/*
+ * Every menu entry is one row of a single action table: where it is shown, its text and, for mass actions,
+ * the kernel that runs it. Client actions are described as scope x filter x verbs and each combination is
+ * instantiated from one scan template, so the table drives ts3plugin_initMenus and the menu dispatch alike.
+ * An action with several verbs applies all of them to each selected client in one traversal.
+ */
+
+/*
+ * Menu IDs for this plugin. Pass these IDs when creating a menuitem to the TS3 client. When the menu item is triggered,
+ * ts3plugin_onMenuItemEvent will be called passing the menu ID of the triggered menu item.
+ * These IDs are freely choosable by the plugin author. It's not really needed to use an enum, it just looks prettier.
+ */
+enum {
+	MENU_ID_GLOBAL_1,
+	MENU_ID_GLOBAL_2,
+	MENU_ID_GLOBAL_3,
+	MENU_ID_GLOBAL_4,
+	MENU_ID_GLOBAL_5,
+	MENU_ID_GLOBAL_6,
+	MENU_ID_GLOBAL_7,
+	MENU_ID_GLOBAL_8,
+	MENU_ID_GLOBAL_9,
+	MENU_ID_GLOBAL_10,
+	MENU_ID_GLOBAL_11,
+	MENU_ID_GLOBAL_12,
+	MENU_ID_GLOBAL_13,
+	MENU_ID_GLOBAL_14,
+	MENU_ID_GLOBAL_15,
+	MENU_ID_GLOBAL_16,
+	MENU_ID_GLOBAL_17,
+	MENU_ID_GLOBAL_18,
+	MENU_ID_GLOBAL_19,
+	MENU_ID_GLOBAL_20,
+	MENU_ID_GLOBAL_21,
+	MENU_ID_GLOBAL_22,
+	MENU_ID_GLOBAL_23,
+	MENU_ID_GLOBAL_24,
+	MENU_ID_GLOBAL_25,
+	MENU_ID_GLOBAL_26,
+	MENU_ID_GLOBAL_27,
+	MENU_ID_GLOBAL_28,
+	MENU_ID_GLOBAL_29,
+	MENU_ID_GLOBAL_30,
+	MENU_ID_GLOBAL_31,
+	MENU_ID_GLOBAL_32,
+	MENU_ID_GLOBAL_33,
+	MENU_ID_GLOBAL_34,
+	MENU_ID_GLOBAL_35,
+	MENU_ID_GLOBAL_36,
+	MENU_ID_GLOBAL_37,
+	MENU_ID_GLOBAL_38,
+	MENU_ID_GLOBAL_39,
+	MENU_ID_CHANNEL_1,
+	MENU_ID_CHANNEL_2,
+	MENU_ID_CHANNEL_3,
+	MENU_ID_CHANNEL_4,
+	MENU_ID_CHANNEL_5,
+	MENU_ID_CHANNEL_6,
+	MENU_ID_CHANNEL_7,
+	MENU_ID_CHANNEL_8,
+	MENU_ID_CHANNEL_9,
+	MENU_ID_CHANNEL_10,
+	MENU_ID_CHANNEL_11,
+	MENU_ID_CHANNEL_12,
+	MENU_ID_CHANNEL_13,
+	MENU_ID_CHANNEL_14,
+	MENU_ID_CHANNEL_15,
+	MENU_ID_CHANNEL_16,
+	MENU_ID_CHANNEL_17,
+	MENU_ID_CHANNEL_18,
+	MENU_ID_CHANNEL_19,
+	MENU_ID_CHANNEL_20,
+	MENU_ID_CHANNEL_21,
+	MENU_ID_CHANNEL_22,
+	MENU_ID_CHANNEL_23,
+	MENU_ID_CHANNEL_24,
+	MENU_ID_CHANNEL_25,
+	MENU_ID_CHANNEL_26,
+	MENU_ID_CHANNEL_27,
+	MENU_ID_CHANNEL_28,
+	MENU_ID_CHANNEL_29,
+	MENU_ID_CHANNEL_30,
+	MENU_ID_CLIENT_1,
+	MENU_ID_CLIENT_2
+};
+
+/* Which clients an action looks at */
+enum ActionScope {
+	SCOPE_OWN_CHANNEL = 0,
+	SCOPE_SELECTED_CHANNEL,
+	SCOPE_SERVER,
+	SCOPE_OUTSIDE_OWN_CHANNEL,       /* Everyone on the server not in your channel */
+	SCOPE_OUTSIDE_SELECTED_CHANNEL,
+	SCOPE_SELECTED_SUBTREE          /* The selected channel and every channel below it */
+};
+
+/* Which channels must be subscribed while an action runs, so it sees every client it is about */
+enum ActionView {
+	VIEW_SUBSCRIBED = 0,    /* Only what is subscribed already, e.g. your own channel */
+	VIEW_SELECTED_CHANNEL,  /* The channel of the channel menu */
+	VIEW_SERVER             /* Every channel */
+};
+
+/* How yourself is treated within the scope */
+enum ActionFilter {
+	FILTER_EVERYONE = 0,
+	FILTER_NOT_ME,
+	FILTER_ME_LAST   /* Everyone else first, yourself once all of their answers arrived */
+};
+
+enum ActionVerb {
+	ACTION_MOVE_TO_OWN_CHANNEL = 0,
+	ACTION_MOVE_TO_SELECTED_CHANNEL,
+	ACTION_KICK_FROM_CHANNEL,
+	ACTION_KICK_FROM_SERVER,
+	ACTION_GRANT_TALKER,
+	ACTION_REVOKE_TALKER
+};
+
+/* Session switches toggling menu items. Destructive actions stay disabled until they were armed for the session. */
+enum ActionGuard {
+	GUARD_NONE = 0,
+	GUARD_ARMED,               /* Only enabled while armed */
+	GUARD_ARM,                 /* The "activate" item */
+	GUARD_DISARM,              /* The "deactivate" item */
+	GUARD_ALL_CONNECTIONS_ON,  /* Global actions run on every connected server from now on */
+	GUARD_ALL_CONNECTIONS_OFF,
+	GUARD_CALL_TIMING_ON,      /* Client lib calls are timed for the info panel from now on */
+	GUARD_CALL_TIMING_OFF,
+	GUARD_TRACE_ON,            /* Every batch records a timeline from now on */
+	GUARD_TRACE_OFF
+};
+
+struct ClientFilter;
+
+/* What a command takes before its filter, all zero resp. empty for menu actions */
+struct CommandArguments {
+	uint64 groupID;         /* Server resp. channel group of the group commands */
+	uint64 banSeconds;      /* Duration of the ban command, at least 1 as 0 would ban forever */
+	std::string banReason;
+};
+
+struct ActionContext {
+	uint64 serverConnectionHandlerID;
+	uint64 batchID;
+	uint64 selectedItemID;  /* Channel of a channel menu, 0 for the global menu */
+	const struct ClientFilter* filter;  /* Only clients matching it are targeted, NULL for menu actions */
+	const struct CommandArguments* arguments;  /* Never NULL */
+	uint64 cancelGeneration;  /* dispatchCancelGeneration when the job started, for waiting on what the kernel asks */
+};
+
+typedef void (*ActionKernel)(const struct ActionContext& context);
+
+struct ActionDescriptor {
+	enum PluginMenuType type;
+	int menuID;
+	const char* text;    /* Menu text */
+	const char* name;    /* Shown in the batch report, NULL for headers and separators */
+	ActionKernel run;    /* NULL if the item does not dispatch anything */
+	enum ActionGuard guard;
+	enum ActionView view;
+};
+
+/* Where the time of an action run went, summed over its connections */
+struct ActionTimings {
+	size_t runs;              /* Action runs since the plugin was loaded, the rest is about the last one */
+	double subscribeSeconds;  /* Waiting for the subscriptions the view of the action needs */
+	double snapshotSeconds;   /* Roster and channel tree */
+	double planSeconds;       /* Picking the targets and queueing the requests */
+};
+
+/* All menu items in the order they are shown */
+const struct ActionDescriptor* actionTable(size_t* count);
+
+/* NULL if no such menu item */
+const struct ActionDescriptor* actionFind(enum PluginMenuType type, int menuID);
+
+/* Runs a mass action as one batch, called on the worker thread */
+void actionRun(const struct ActionDescriptor* action, uint64 serverConnectionHandlerID, uint64 selectedItemID);
+
+/* Runs a global menu action on every established connection, each with its own batch */
+void actionRunOnAllConnections(const struct ActionDescriptor* action);
+
+/* The actions behind the verbs of the chat command, text is the verb. Not part of the menus. */
+const struct ActionDescriptor* actionCommands(size_t* count);
+
+/* NULL if no command has this verb */
+const struct ActionDescriptor* actionFindCommand(const char* verb);
+
+/* Group commands take a server or channel group ID before the filter */
+int actionTakesGroup(const struct ActionDescriptor* action);
+
+/* Ban takes a duration and optionally a quoted reason before the filter */
+int actionTakesBanTerms(const struct ActionDescriptor* action);
+
+/* Runs a command action for the clients matching filter, on one or on every established connection */
+void actionRunFiltered(const struct ActionDescriptor* action, uint64 serverConnectionHandlerID, const struct ClientFilter& filter, const struct CommandArguments& arguments);
+void actionRunFilteredOnAllConnections(const struct ActionDescriptor* action, const struct ClientFilter& filter, const struct CommandArguments& arguments);
+
+void actionLastTimings(struct ActionTimings* timings);
+
+/* Enables or disables the guarded menu items, called from the GUI thread */
+void actionsSetArmed(int isArmed);
+
+/* Switches global menu actions between the current and all connections, called from the GUI thread */
+void actionsSetAllConnections(int enabled);
+int actionsOnAllConnections();
+
+/* Whether GUARD_ARMED actions run, commands tell when they do not */
+int actionsArmed();
+
+/* Switches timing of client lib calls, called from the GUI thread */
+void actionsSetCallTiming(int enabled);
+
+/* Switches recording of batch timelines, called from the GUI thread */
+void actionsSetTracing(int enabled);
+
+#endif
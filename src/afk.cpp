@@ -0,0 +1,335 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_definitions.h"
+#include "teamspeak/public_rare_definitions.h"
+#include "ts3_functions.h"
+#include "globals.h"
+#include "ts3_buffer.h"
+#include "roster.h"
+#include "roster_cache.h"
+#include "dispatcher.h"
+#include "filter.h"
+#include "afk.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct AfkDeadline {
+	Clock::time_point at;
+	uint64 serverConnectionHandlerID;
+	anyID clientID;
+
+	/* std::priority_queue is a max-heap, the earliest deadline has to compare greatest */
+	bool operator<(const AfkDeadline& other) const {
+		return at > other.at;
+	}
+};
+
+struct AfkServer {
+	uint64 channelID;
+	uint64 threshold;  /* Milliseconds */
+	anyID myID;
+	std::unordered_map<anyID, Clock::time_point> deadlines;  /* The heap entry that counts, older ones are skipped */
+	std::unordered_set<anyID> asked;                          /* Due, waiting for the answer to our requestClientVariables */
+	std::unordered_set<anyID> moving;                         /* Move sent, counted once the client arrives */
+	size_t moved;
+};
+
+static std::mutex afkMutex;
+static std::condition_variable afkWake;
+static std::priority_queue<AfkDeadline> heap;
+static std::map<uint64, AfkServer> servers;
+static std::thread sweeperThread;
+static bool sweeperRunning = false;
+
+/* Caller holds afkMutex */
+static void schedule(uint64 serverConnectionHandlerID, AfkServer& server, anyID clientID, Clock::time_point at) {
+	server.deadlines[clientID] = at;
+	AfkDeadline entry = { at, serverConnectionHandlerID, clientID };
+	heap.push(entry);
+
+	/* Every talk pushes a new entry, rebuild once the outdated ones outnumber the live ones */
+	size_t live = 0;
+	for(std::map<uint64, AfkServer>::const_iterator it = servers.begin(); it != servers.end(); ++it) {
+		live += it->second.deadlines.size();
+	}
+	if(heap.size() <= 64 || heap.size() <= 2 * live) {
+		return;
+	}
+	std::vector<AfkDeadline> entries;
+	entries.reserve(live);
+	for(std::map<uint64, AfkServer>::const_iterator it = servers.begin(); it != servers.end(); ++it) {
+		for(std::unordered_map<anyID, Clock::time_point>::const_iterator d = it->second.deadlines.begin(); d != it->second.deadlines.end(); ++d) {
+			AfkDeadline kept = { d->second, it->first, d->first };
+			entries.push_back(kept);
+		}
+	}
+	heap = std::priority_queue<AfkDeadline>(std::less<AfkDeadline>(), std::move(entries));
+}
+
+static void idleTimeAnswered(uint64 serverConnectionHandlerID, const struct Request& request, unsigned int error);
+
+/* The variables request of the sweeper, its answer is handled by idleTimeAnswered */
+static void askIdleTime(uint64 serverConnectionHandlerID, uint64 batchID, anyID clientID) {
+	struct Request request(batchID, VERB_REQUEST_VARIABLES);
+	request.clientID = clientID;
+	request.onAnswered = &idleTimeAnswered;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+/* Pops what is due and asks the server for the idle time of those clients, nothing else is looked at */
+static void sweeperLoop() {
+	std::unique_lock<std::mutex> lock(afkMutex);
+	while(sweeperRunning) {
+		if(heap.empty()) {
+			afkWake.wait(lock);
+			continue;
+		}
+		const Clock::time_point next = heap.top().at;
+		if(Clock::now() < next) {
+			afkWake.wait_until(lock, next);
+			continue;
+		}
+
+		std::vector<AfkDeadline> due;
+		const Clock::time_point now = Clock::now();
+		while(!heap.empty() && heap.top().at <= now) {
+			const AfkDeadline entry = heap.top();
+			heap.pop();
+			std::map<uint64, AfkServer>::iterator server = servers.find(entry.serverConnectionHandlerID);
+			if(server == servers.end()) {
+				continue;
+			}
+			std::unordered_map<anyID, Clock::time_point>::iterator deadline = server->second.deadlines.find(entry.clientID);
+			if(deadline == server->second.deadlines.end() || deadline->second != entry.at) {
+				continue;  /* Rescheduled or gone since */
+			}
+			server->second.deadlines.erase(deadline);
+			server->second.asked.insert(entry.clientID);
+			due.push_back(entry);
+		}
+
+		lock.unlock();
+		for(size_t i = 0; i < due.size(); i++) {
+			askIdleTime(due[i].serverConnectionHandlerID, 0, due[i].clientID);
+		}
+		lock.lock();
+	}
+}
+
+void afkStart() {
+	std::lock_guard<std::mutex> lock(afkMutex);
+	if(sweeperRunning) {
+		return;
+	}
+	sweeperRunning = true;
+	sweeperThread = std::thread(sweeperLoop);
+}
+
+void afkStop() {
+	{
+		std::lock_guard<std::mutex> lock(afkMutex);
+		if(!sweeperRunning) {
+			return;
+		}
+		sweeperRunning = false;
+		servers.clear();
+		heap = std::priority_queue<AfkDeadline>();
+	}
+	afkWake.notify_all();
+	sweeperThread.join();
+}
+
+static std::string channelName(uint64 serverConnectionHandlerID, uint64 channelID) {
+	Ts3Buffer<char> name;
+	if(ts3Functions.getChannelVariableAsString(serverConnectionHandlerID, channelID, CHANNEL_NAME, name.out()) != ERROR_ok) {
+		return "channel " + std::to_string(channelID);
+	}
+	return name.get();
+}
+
+void afkEnable(uint64 serverConnectionHandlerID, uint64 thresholdMilliseconds) {
+	struct Roster roster;
+	if(rosterCacheSnapshot(serverConnectionHandlerID, &roster) != ERROR_ok || !roster.myChannel) {
+		return;
+	}
+
+	/* Nobody's idle time is known yet, everyone outside the AFK channel starts out asked */
+	std::vector<anyID> ask;
+	{
+		std::lock_guard<std::mutex> lock(afkMutex);
+		AfkServer& server = servers[serverConnectionHandlerID];
+		server.channelID = roster.myChannel;
+		server.threshold = thresholdMilliseconds;
+		server.myID = roster.myID;
+		server.deadlines.clear();
+		server.asked.clear();
+		server.moving.clear();
+		server.moved = 0;
+		for(size_t i = 0; i < roster.channels.size(); i++) {
+			if(roster.channels[i] == server.channelID) {
+				continue;
+			}
+			for(size_t c = roster.offsets[i]; c < roster.offsets[i + 1]; c++) {
+				if(roster.clients[c] != roster.myID) {
+					server.asked.insert(roster.clients[c]);
+					ask.push_back(roster.clients[c]);
+				}
+			}
+		}
+	}
+
+	const std::string message = "[b]Mass actions:[/b] Clients idle for " + filterFormatDuration(thresholdMilliseconds) + " are moved to " +
+		channelName(serverConnectionHandlerID, roster.myChannel) + ", /mass afk off stops it";
+	ts3Functions.printMessage(serverConnectionHandlerID, message.c_str(), PLUGIN_MESSAGE_TARGET_SERVER);
+
+	const uint64 batchID = dispatchBeginBatch(serverConnectionHandlerID, "AFK sweeper: ask for idle times");
+	for(size_t i = 0; i < ask.size(); i++) {
+		askIdleTime(serverConnectionHandlerID, batchID, ask[i]);
+	}
+	dispatchEndBatch(batchID);
+}
+
+void afkDisable(uint64 serverConnectionHandlerID) {
+	{
+		std::lock_guard<std::mutex> lock(afkMutex);
+		servers.erase(serverConnectionHandlerID);
+	}
+	ts3Functions.printMessage(serverConnectionHandlerID, "[b]Mass actions:[/b] The AFK sweeper is off", PLUGIN_MESSAGE_TARGET_SERVER);
+}
+
+void afkPrintStatus(uint64 serverConnectionHandlerID) {
+	uint64 channelID = 0, threshold = 0;
+	size_t watched = 0, checking = 0, moving = 0, moved = 0;
+	{
+		std::lock_guard<std::mutex> lock(afkMutex);
+		std::map<uint64, AfkServer>::const_iterator it = servers.find(serverConnectionHandlerID);
+		if(it != servers.end()) {
+			channelID = it->second.channelID;
+			threshold = it->second.threshold;
+			watched = it->second.deadlines.size();
+			checking = it->second.asked.size();
+			moving = it->second.moving.size();
+			moved = it->second.moved;
+		}
+	}
+
+	std::string message = "[b]Mass actions:[/b] The AFK sweeper is off, /mass afk DURATION makes your channel the AFK channel";
+	if(channelID) {
+		message = "[b]Mass actions:[/b] Clients idle for " + filterFormatDuration(threshold) + " are moved to " + channelName(serverConnectionHandlerID, channelID) + ", " +
+			std::to_string(watched) + " watched, " + std::to_string(checking) + " being checked, " + std::to_string(moving) + " being moved, " + std::to_string(moved) + " moved";
+	}
+	ts3Functions.printMessage(serverConnectionHandlerID, message.c_str(), PLUGIN_MESSAGE_TARGET_SERVER);
+}
+
+/*
+ * The answer to a due client's request: move it, or wait for the rest of the threshold. The server sends the
+ * variables before the answer, so the client lib's idle time is the fresh one now; an update event on its own
+ * may carry one left by an older request. A moved client keeps a deadline until it is seen arriving, so if the
+ * server refuses the move, e.g. the AFK channel is full, it is tried again after another threshold. The refusal
+ * shows in the move's batch report. A refused request is retried the same way.
+ */
+static void idleTimeAnswered(uint64 serverConnectionHandlerID, const struct Request& request, unsigned int error) {
+	const anyID clientID = request.clientID;
+	uint64 idle = 0;
+	if(error == ERROR_ok && ts3Functions.getClientVariableAsUInt64(serverConnectionHandlerID, clientID, CLIENT_IDLE_TIME, &idle) != ERROR_ok) {
+		error = ERROR_undefined;
+	}
+
+	uint64 channelID;
+	{
+		std::lock_guard<std::mutex> lock(afkMutex);
+		std::map<uint64, AfkServer>::iterator it = servers.find(serverConnectionHandlerID);
+		if(it == servers.end() || !it->second.asked.erase(clientID)) {
+			return;  /* Talked, left or the sweeper was turned off meanwhile */
+		}
+		AfkServer& server = it->second;
+		if(error != ERROR_ok) {
+			schedule(serverConnectionHandlerID, server, clientID, Clock::now() + std::chrono::milliseconds(server.threshold));
+			afkWake.notify_one();
+			return;
+		}
+		if(idle < server.threshold) {
+			schedule(serverConnectionHandlerID, server, clientID, Clock::now() + std::chrono::milliseconds(server.threshold - idle));
+			afkWake.notify_one();
+			return;
+		}
+		server.moving.insert(clientID);
+		schedule(serverConnectionHandlerID, server, clientID, Clock::now() + std::chrono::milliseconds(server.threshold));
+		afkWake.notify_one();
+		channelID = server.channelID;
+	}
+	const uint64 batchID = dispatchBeginQuietBatch(serverConnectionHandlerID, "AFK sweeper: move idle client");
+	dispatchClientMove(serverConnectionHandlerID, batchID, clientID, channelID);
+	dispatchEndBatch(batchID);
+}
+
+void afkClientTalked(uint64 serverConnectionHandlerID, anyID clientID) {
+	std::lock_guard<std::mutex> lock(afkMutex);
+	std::map<uint64, AfkServer>::iterator it = servers.find(serverConnectionHandlerID);
+	if(it == servers.end()) {
+		return;
+	}
+	AfkServer& server = it->second;
+	if(server.deadlines.count(clientID) || server.asked.erase(clientID)) {
+		schedule(serverConnectionHandlerID, server, clientID, Clock::now() + std::chrono::milliseconds(server.threshold));
+		afkWake.notify_one();
+	}
+}
+
+void afkClientMoved(uint64 serverConnectionHandlerID, anyID clientID, uint64 newChannelID, int visibility) {
+	std::lock_guard<std::mutex> lock(afkMutex);
+	std::map<uint64, AfkServer>::iterator it = servers.find(serverConnectionHandlerID);
+	if(it == servers.end() || clientID == it->second.myID) {
+		return;
+	}
+	AfkServer& server = it->second;
+	if(newChannelID == 0 || visibility == LEAVE_VISIBILITY || newChannelID == server.channelID) {
+		if(server.moving.erase(clientID) && newChannelID == server.channelID) {
+			server.moved++;
+		}
+		server.deadlines.erase(clientID);
+		server.asked.erase(clientID);
+		return;
+	}
+	server.moving.erase(clientID);  /* Moved elsewhere by someone else before our move arrived */
+	/* New in view or back from the AFK channel, either way not idle for long. Moves within the server keep their deadline. */
+	if(!server.deadlines.count(clientID) && !server.asked.count(clientID)) {
+		schedule(serverConnectionHandlerID, server, clientID, Clock::now() + std::chrono::milliseconds(server.threshold));
+		afkWake.notify_one();
+	}
+}
+
+void afkChannelDeleted(uint64 serverConnectionHandlerID, uint64 channelID) {
+	bool stopped = false;
+	{
+		std::lock_guard<std::mutex> lock(afkMutex);
+		std::map<uint64, AfkServer>::iterator it = servers.find(serverConnectionHandlerID);
+		if(it != servers.end() && it->second.channelID == channelID) {
+			servers.erase(it);
+			stopped = true;
+		}
+	}
+	if(stopped) {
+		ts3Functions.printMessage(serverConnectionHandlerID, "[b]Mass actions:[/b] The AFK channel was deleted, the AFK sweeper is off", PLUGIN_MESSAGE_TARGET_SERVER);
+	}
+}
+
+void afkDrop(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(afkMutex);
+	servers.erase(serverConnectionHandlerID);
+}
@@ -0,0 +1,40 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef AFK_H
+#define AFK_H
+
+#include "teamspeak/public_definitions.h"
+
+/*
+ * AFK sweeper: moves clients idle for longer than a threshold into an AFK channel. Every watched client
+ * has a deadline, the moment it would cross the threshold if it stays idle, and a min-heap orders them, so
+ * the sweeper thread only wakes up for the next deadline and only touches the clients due then.
+ *
+ * Idle time is only known after asking the server, so a due client is asked again first: once the request
+ * is answered and the client still idle, it is moved, otherwise it gets a new deadline from the idle time the
+ * server reported. Talking resets the deadline without asking.
+ */
+
+void afkStart();
+void afkStop();
+
+/* Makes your current channel the AFK channel of a connection and asks for everyone's idle time. Worker thread. */
+void afkEnable(uint64 serverConnectionHandlerID, uint64 thresholdMilliseconds);
+void afkDisable(uint64 serverConnectionHandlerID);
+
+/* Prints whether and how the sweeper runs on a connection */
+void afkPrintStatus(uint64 serverConnectionHandlerID);
+
+/* Clientlib events of watched connections */
+void afkClientTalked(uint64 serverConnectionHandlerID, anyID clientID);
+void afkClientMoved(uint64 serverConnectionHandlerID, anyID clientID, uint64 newChannelID, int visibility);
+void afkChannelDeleted(uint64 serverConnectionHandlerID, uint64 channelID);
+
+/* Forgets a connection, called on disconnect */
+void afkDrop(uint64 serverConnectionHandlerID);
+
+#endif
@@ -0,0 +1,196 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <stddef.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include "call_timing.h"
+
+typedef std::chrono::steady_clock Clock;
+
+/* Every client lib function the plugin calls */
+#define TIMED_FUNCTIONS(X) \
+	X(banadd) \
+	X(banclient) \
+	X(cleanUpConnectionInfo) \
+	X(createReturnCode) \
+	X(freeMemory) \
+	X(getChannelClientList) \
+	X(getChannelList) \
+	X(getChannelOfClient) \
+	X(getChannelVariableAsInt) \
+	X(getChannelVariableAsString) \
+	X(getClientID) \
+	X(getClientSelfVariableAsString) \
+	X(getClientVariableAsInt) \
+	X(getClientVariableAsString) \
+	X(getClientVariableAsUInt64) \
+	X(getConfigPath) \
+	X(getConnectionStatus) \
+	X(getConnectionVariableAsString) \
+	X(getCurrentServerConnectionHandlerID) \
+	X(getErrorMessage) \
+	X(getParentChannelOfChannel) \
+	X(getServerConnectionHandlerList) \
+	X(getServerVariableAsString) \
+	X(getServerVariableAsUInt64) \
+	X(printMessage) \
+	X(requestChannelAddPerm) \
+	X(requestChannelDelete) \
+	X(requestChannelDelPerm) \
+	X(requestChannelPermList) \
+	X(requestChannelSubscribe) \
+	X(requestChannelUnsubscribe) \
+	X(requestClientKickFromChannel) \
+	X(requestClientKickFromServer) \
+	X(requestClientMove) \
+	X(requestClientSetIsTalker) \
+	X(requestClientVariables) \
+	X(requestConnectionInfo) \
+	X(requestMuteClients) \
+	X(requestServerGroupAddClient) \
+	X(requestServerGroupClientList) \
+	X(requestServerGroupDelClient) \
+	X(requestSetClientChannelGroup) \
+	X(requestUnmuteClients) \
+	X(setPluginMenuEnabled)
+
+enum TimedFunction {
+#define X(name) TIMED_##name,
+	TIMED_FUNCTIONS(X)
+#undef X
+	TIMED_COUNT
+};
+
+static const char* const timedNames[TIMED_COUNT] = {
+#define X(name) #name,
+	TIMED_FUNCTIONS(X)
+#undef X
+};
+
+struct Counters {
+	std::atomic<uint64> calls;
+	std::atomic<uint64> totalNanoseconds;
+	std::atomic<uint64> maxNanoseconds;
+	std::atomic<uint64> buckets[CALL_TIMING_BUCKETS];
+};
+
+static std::atomic<int> enabled(0);
+static struct Counters counters[TIMED_COUNT];
+
+static void record(int function, uint64 nanoseconds) {
+	struct Counters& c = counters[function];
+	c.calls.fetch_add(1, std::memory_order_relaxed);
+	c.totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+	uint64 current = c.maxNanoseconds.load(std::memory_order_relaxed);
+	while(nanoseconds > current && !c.maxNanoseconds.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed)) {
+	}
+
+	int bucket = 0;
+	for(uint64 us = nanoseconds / 1000; us && bucket < CALL_TIMING_BUCKETS - 1; us >>= 1) {
+		bucket++;
+	}
+	c.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+/* Records the time until it goes out of scope, which is after the forwarded call returned */
+struct ScopedTiming {
+	int function;
+	Clock::time_point started;
+
+	explicit ScopedTiming(int timedFunction) : function(timedFunction), started(Clock::now()) {
+	}
+	~ScopedTiming() {
+		record(function, (uint64)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - started).count());
+	}
+};
+
+/* One wrapper per function, Function only tells them apart */
+template<int Function, typename R, typename... Args>
+struct TimedCall {
+	static R (*original)(Args...);
+
+	static R call(Args... args) {
+		if(!enabled.load(std::memory_order_relaxed)) {
+			return original(args...);
+		}
+		const ScopedTiming timing(Function);
+		return original(args...);
+	}
+};
+
+template<int Function, typename R, typename... Args>
+R (*TimedCall<Function, R, Args...>::original)(Args...) = NULL;
+
+template<int Function, typename R, typename... Args>
+static void wrap(R (*&function)(Args...)) {
+	if(!function) {
+		return;
+	}
+	TimedCall<Function, R, Args...>::original = function;
+	function = &TimedCall<Function, R, Args...>::call;
+}
+
+void callTimingInstall(struct TS3Functions* functions) {
+#define X(name) wrap<TIMED_##name>(functions->name);
+	TIMED_FUNCTIONS(X)
+#undef X
+}
+
+void callTimingSetEnabled(int enable) {
+	if(enable && !enabled.load()) {
+		for(int f = 0; f < TIMED_COUNT; f++) {
+			counters[f].calls = 0;
+			counters[f].totalNanoseconds = 0;
+			counters[f].maxNanoseconds = 0;
+			for(int b = 0; b < CALL_TIMING_BUCKETS; b++) {
+				counters[f].buckets[b] = 0;
+			}
+		}
+	}
+	enabled.store(enable ? 1 : 0);
+}
+
+int callTimingEnabled() {
+	return enabled.load();
+}
+
+/* Upper bound of the bucket where fraction of the calls are reached, never above the slowest call */
+static double percentile(const struct CallTiming& timing, double fraction) {
+	const uint64 rank = (uint64)(fraction * timing.calls);
+	uint64 seen = 0;
+	for(int b = 0; b < CALL_TIMING_BUCKETS; b++) {
+		seen += timing.buckets[b];
+		if(seen > rank) {
+			return b < CALL_TIMING_BUCKETS - 1 ? std::min((double)(1ull << b) / 1e6, timing.maxSeconds) : timing.maxSeconds;
+		}
+	}
+	return timing.maxSeconds;
+}
+
+void callTimingSnapshot(std::vector<struct CallTiming>* timings) {
+	timings->clear();
+	for(int f = 0; f < TIMED_COUNT; f++) {
+		struct CallTiming timing;
+		timing.name = timedNames[f];
+		timing.calls = counters[f].calls.load();
+		if(!timing.calls) {
+			continue;
+		}
+		timing.totalSeconds = counters[f].totalNanoseconds.load() / 1e9;
+		timing.maxSeconds = counters[f].maxNanoseconds.load() / 1e9;
+		for(int b = 0; b < CALL_TIMING_BUCKETS; b++) {
+			timing.buckets[b] = counters[f].buckets[b].load();
+		}
+		timing.p50Seconds = percentile(timing, 0.5);
+		timing.p99Seconds = percentile(timing, 0.99);
+		timings->push_back(timing);
+	}
+	std::sort(timings->begin(), timings->end(), [](const struct CallTiming& a, const struct CallTiming& b) {
+		return a.totalSeconds > b.totalSeconds;
+	});
+}
@@ -0,0 +1,43 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef CALL_TIMING_H
+#define CALL_TIMING_H
+
+#include <stddef.h>
+#include <vector>
+#include "teamspeak/public_definitions.h"
+#include "ts3_functions.h"
+
+/*
+ * Timing proxy for the client lib. callTimingInstall swaps every function the plugin uses for a wrapper that
+ * forwards to the original. While timing is enabled the wrappers count calls and sort their latency into a
+ * histogram of power of two microsecond buckets, while disabled they only forward.
+ */
+
+#define CALL_TIMING_BUCKETS 24  /* Bucket 0 is below 1 us, bucket b is below 2^b us, the last one takes the rest */
+
+struct CallTiming {
+	const char* name;
+	uint64 calls;
+	double totalSeconds;
+	double maxSeconds;
+	double p50Seconds;  /* Upper bound of the bucket holding the median, at most maxSeconds */
+	double p99Seconds;
+	uint64 buckets[CALL_TIMING_BUCKETS];
+};
+
+/* Called from ts3plugin_setFunctionPointers with the table the plugin keeps */
+void callTimingInstall(struct TS3Functions* functions);
+
+/* Enabling starts from zero */
+void callTimingSetEnabled(int enabled);
+int callTimingEnabled();
+
+/* Functions called at least once since timing was enabled, most total time first */
+void callTimingSnapshot(std::vector<struct CallTiming>* timings);
+
+#endif
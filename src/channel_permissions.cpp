@@ -0,0 +1,35 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <stdio.h>
+#include <map>
+#include <vector>
+#include "teamspeak/public_definitions.h"
+#include "dispatcher.h"
+#include "collector.h"
+#include "channel_permissions.h"
+
+static ReplyCollector<uint64, ChannelPermissions> permissionLists;  /* Per channel */
+
+int channelPermissionsFetch(uint64 serverConnectionHandlerID, const std::vector<uint64>& channels, uint64 cancelGeneration, std::map<uint64, ChannelPermissions>* permissions) {
+	char name[64];
+	snprintf(name, sizeof(name), "Ask the server for the permissions of %u channels", (unsigned int)channels.size());
+	size_t failed = 0;
+	const int answered = permissionLists.ask(serverConnectionHandlerID, channels, name, cancelGeneration, [&](uint64 batchID, uint64 channelID) {
+		dispatchListChannelPermissions(serverConnectionHandlerID, batchID, channelID);
+	}, &failed);
+
+	for(size_t i = 0; i < channels.size(); i++) {
+		permissionLists.take(serverConnectionHandlerID, channels[i], &(*permissions)[channels[i]]);
+	}
+	return answered && !failed;
+}
+
+void channelPermissionsOnListEntry(uint64 serverConnectionHandlerID, uint64 channelID, unsigned int permissionID, int permissionValue) {
+	permissionLists.update(serverConnectionHandlerID, channelID, [&](ChannelPermissions& permissions) {
+		permissions[permissionID] = permissionValue;
+	});
+}
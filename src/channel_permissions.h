@@ -0,0 +1,32 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef CHANNEL_PERMISSIONS_H
+#define CHANNEL_PERMISSIONS_H
+
+#include <map>
+#include <vector>
+#include "teamspeak/public_definitions.h"
+
+/*
+ * Permissions set on channels as the server has them. The client lib keeps none of them, the list of a
+ * channel is asked for with one request and arrives as one onChannelPermListEvent per permission before the
+ * answer to it.
+ */
+
+typedef std::map<unsigned int, int> ChannelPermissions;  /* Permission ID -> value */
+
+/*
+ * Lists the permissions of all channels in one batch, a channel without any gets an empty map. Returns 0 if a
+ * single listing was refused, the maps are incomplete then, or if it was aborted since cancelGeneration or the
+ * connection dropped. Runs on the worker thread.
+ */
+int channelPermissionsFetch(uint64 serverConnectionHandlerID, const std::vector<uint64>& channels, uint64 cancelGeneration, std::map<uint64, ChannelPermissions>* permissions);
+
+/* onChannelPermListEvent, records the value in the channel's map while channelPermissionsFetch waits */
+void channelPermissionsOnListEntry(uint64 serverConnectionHandlerID, uint64 channelID, unsigned int permissionID, int permissionValue);
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <stddef.h>
+#include <algorithm>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_definitions.h"
+#include "teamspeak/public_rare_definitions.h"
+#include "ts3_functions.h"
+#include "globals.h"
+#include "ts3_buffer.h"
+#include "channel_tree.h"
+
+int ChannelTree::findChannel(uint64 channelID) const {
+	std::vector<uint64>::const_iterator it = std::lower_bound(channels.begin(), channels.end(), channelID);
+	if(it == channels.end() || *it != channelID) {
+		return -1;
+	}
+	return (int)(it - channels.begin());
+}
+
+unsigned int buildChannelTree(uint64 serverConnectionHandlerID, struct ChannelTree* tree) {
+	unsigned int error;
+
+	Ts3Buffer<uint64> channelList;
+	if((error = ts3Functions.getChannelList(serverConnectionHandlerID, channelList.out())) != ERROR_ok) {
+		return error;
+	}
+	tree->channels.assign(channelList.get(), channelList.get() + channelList.size());
+	std::sort(tree->channels.begin(), tree->channels.end());
+
+	const size_t count = tree->channels.size();
+	tree->parents.assign(count, -1);
+	tree->subscribed.assign(count, 0);
+	tree->defaultIndex = -1;
+	for(size_t i = 0; i < count; i++) {
+		uint64 parentID;
+		if(ts3Functions.getParentChannelOfChannel(serverConnectionHandlerID, tree->channels[i], &parentID) == ERROR_ok && parentID) {
+			tree->parents[i] = tree->findChannel(parentID);
+		}
+		int flag;
+		if(ts3Functions.getChannelVariableAsInt(serverConnectionHandlerID, tree->channels[i], CHANNEL_FLAG_ARE_SUBSCRIBED, &flag) == ERROR_ok) {
+			tree->subscribed[i] = (char)flag;
+		}
+		if(tree->defaultIndex < 0 && ts3Functions.getChannelVariableAsInt(serverConnectionHandlerID, tree->channels[i], CHANNEL_FLAG_DEFAULT, &flag) == ERROR_ok && flag) {
+			tree->defaultIndex = (int)i;
+		}
+	}
+
+	/* Children by counting sort on the parent index */
+	tree->childOffsets.assign(count + 1, 0);
+	for(size_t i = 0; i < count; i++) {
+		if(tree->parents[i] >= 0) {
+			tree->childOffsets[tree->parents[i] + 1]++;
+		}
+	}
+	for(size_t i = 0; i < count; i++) {
+		tree->childOffsets[i + 1] += tree->childOffsets[i];
+	}
+	tree->children.resize(tree->childOffsets[count]);
+	std::vector<size_t> fill(tree->childOffsets.begin(), tree->childOffsets.end() - 1);
+	for(size_t i = 0; i < count; i++) {
+		if(tree->parents[i] >= 0) {
+			tree->children[fill[tree->parents[i]]++] = (int)i;
+		}
+	}
+
+	/* Parents before children: start with the top-level channels, then append children of what is already listed */
+	tree->order.clear();
+	tree->order.reserve(count);
+	for(size_t i = 0; i < count; i++) {
+		if(tree->parents[i] < 0) {
+			tree->order.push_back((int)i);
+		}
+	}
+	for(size_t k = 0; k < tree->order.size(); k++) {
+		const int node = tree->order[k];
+		tree->order.insert(tree->order.end(), tree->children.begin() + tree->childOffsets[node], tree->children.begin() + tree->childOffsets[node + 1]);
+	}
+
+	return ERROR_ok;
+}
+
+void planForcedChannelDelete(const struct ChannelTree& tree, std::vector<uint64>* targets) {
+	/* The default channel and its ancestors cannot go, everything hanging off that path goes with its topmost channel */
+	std::vector<char> pinned(tree.channels.size(), 0);
+	for(int i = tree.defaultIndex; i >= 0; i = tree.parents[i]) {
+		pinned[i] = 1;
+	}
+
+	targets->clear();
+	for(size_t k = 0; k < tree.order.size(); k++) {
+		const int node = tree.order[k];
+		const int parent = tree.parents[node];
+		if(!pinned[node] && (parent < 0 || pinned[parent])) {
+			targets->push_back(tree.channels[node]);
+		}
+	}
+}
+
+void planEmptyChannelDelete(const struct ChannelTree& tree, const struct Roster& roster, std::vector<std::vector<uint64> >* rounds) {
+	const size_t count = tree.channels.size();
+	std::vector<char> empty(count, 0);
+	for(size_t i = 0; i < count; i++) {
+		const int r = roster.findChannel(tree.channels[i]);
+		empty[i] = tree.subscribed[i] && r >= 0 && roster.offsets[r] == roster.offsets[r + 1] && (int)i != tree.defaultIndex;
+	}
+
+	/* Bottom-up: an occupied channel makes its parent occupied */
+	for(size_t k = count; k-- > 0; ) {
+		const int node = tree.order[k];
+		if(!empty[node] && tree.parents[node] >= 0) {
+			empty[tree.parents[node]] = 0;
+		}
+	}
+
+	/* Children before parents again, a channel's round is one past the highest of its children */
+	std::vector<size_t> round(count, 0);
+	rounds->clear();
+	for(size_t k = count; k-- > 0; ) {
+		const int node = tree.order[k];
+		if(!empty[node]) {
+			continue;
+		}
+		for(size_t c = tree.childOffsets[node]; c < tree.childOffsets[node + 1]; c++) {
+			round[node] = std::max(round[node], round[tree.children[c]] + 1);
+		}
+		if(rounds->size() <= round[node]) {
+			rounds->resize(round[node] + 1);
+		}
+		(*rounds)[round[node]].push_back(tree.channels[node]);
+	}
+}
+
+void channelSubtree(const struct ChannelTree& tree, uint64 channelID, std::vector<uint64>* subtree) {
+	subtree->clear();
+	const int root = tree.findChannel(channelID);
+	if(root < 0) {
+		return;
+	}
+
+	std::vector<int> nodes(1, root);
+	for(size_t k = 0; k < nodes.size(); k++) {
+		const int node = nodes[k];
+		subtree->push_back(tree.channels[node]);
+		nodes.insert(nodes.end(), tree.children.begin() + tree.childOffsets[node], tree.children.begin() + tree.childOffsets[node + 1]);
+	}
+}
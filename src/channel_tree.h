@@ -0,0 +1,46 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef CHANNEL_TREE_H
+#define CHANNEL_TREE_H
+
+#include <vector>
+#include "teamspeak/public_definitions.h"
+#include "roster.h"
+
+/*
+ * Channel hierarchy of a connection, built from getChannelList and getParentChannelOfChannel. Channels are
+ * sorted by ID like in the roster, parents and children refer to indices into channels. order lists every
+ * channel after its parent, so walking it backwards visits children before their parents.
+ */
+struct ChannelTree {
+	std::vector<uint64> channels;
+	std::vector<int> parents;        /* -1 for top-level channels */
+	std::vector<size_t> childOffsets;
+	std::vector<int> children;       /* Children of channels[i] are children[childOffsets[i]] .. children[childOffsets[i + 1]] */
+	std::vector<int> order;
+	std::vector<char> subscribed;    /* Only subscribed channels show their clients */
+	int defaultIndex;                /* -1 if unknown */
+
+	int findChannel(uint64 channelID) const;
+};
+
+unsigned int buildChannelTree(uint64 serverConnectionHandlerID, struct ChannelTree* tree);
+
+/* Channels to delete with force so everything but the default channel is gone, i.e. only the topmost deletable ones */
+void planForcedChannelDelete(const struct ChannelTree& tree, std::vector<uint64>* targets);
+
+/*
+ * Every channel of the maximal empty subtrees, in rounds that can each be deleted without force once the ones
+ * before are gone: rounds[0] are those without subchannels, rounds[r] those whose deepest subchannel is in
+ * round r - 1. Channels we are not subscribed to, or that the roster does not know, count as occupied.
+ */
+void planEmptyChannelDelete(const struct ChannelTree& tree, const struct Roster& roster, std::vector<std::vector<uint64> >* rounds);
+
+/* channelID and every channel below it, parents first */
+void channelSubtree(const struct ChannelTree& tree, uint64 channelID, std::vector<uint64>* subtree);
+
+#endif
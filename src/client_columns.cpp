@@ -0,0 +1,349 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <stdlib.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_definitions.h"
+#include "teamspeak/public_rare_definitions.h"
+#include "ts3_functions.h"
+#include "globals.h"
+#include "ts3_buffer.h"
+#include "client_columns.h"
+
+#define DETAILS_FRESH_MS 10000  /* Idle times asked for this recently are used as they are, off by at most that much */
+
+typedef std::chrono::steady_clock Clock;
+
+/* The columns of one connection, rows in no particular order */
+struct ServerColumns {
+	std::unordered_map<anyID, size_t> rows;  /* Client -> row */
+	std::vector<anyID> clients;              /* Row -> client */
+	std::vector<unsigned char> stale;        /* Read again before the next use */
+	std::vector<uint64> idle;
+	std::vector<uint64> databaseID;
+	std::vector<uint64> channelGroup;
+	std::vector<int> talkPower;
+	std::vector<unsigned char> talker;
+	std::vector<unsigned char> inputMuted;
+	std::vector<unsigned char> outputMuted;
+	std::vector<unsigned char> away;
+	std::vector<unsigned char> recording;
+	std::vector<Clock::time_point> detailsAsked;  /* Last answered requestClientVariables, the epoch if none */
+	std::vector<uint64> groupIDs;
+	std::vector<std::vector<uint64> > groupRows;  /* Bitsets over the rows of this store */
+};
+
+/* One row as read from the client lib, without the lock held */
+struct RowValues {
+	anyID clientID;
+	uint64 idle;
+	uint64 databaseID;
+	uint64 channelGroup;
+	int talkPower;
+	unsigned char talker;
+	unsigned char inputMuted;
+	unsigned char outputMuted;
+	unsigned char away;
+	unsigned char recording;
+	std::vector<uint64> groups;
+};
+
+static std::mutex columnsMutex;
+static std::map<uint64, ServerColumns> stores;
+
+static bool testBit(const std::vector<uint64>& bits, size_t row) {
+	return (bits[row / 64] >> (row % 64)) & 1;
+}
+
+static void assignBit(std::vector<uint64>& bits, size_t row, bool value) {
+	const uint64 mask = (uint64)1 << (row % 64);
+	bits[row / 64] = value ? (bits[row / 64] | mask) : (bits[row / 64] & ~mask);
+}
+
+/* New rows start out stale, caller holds columnsMutex */
+static size_t addRow(ServerColumns& store, anyID clientID) {
+	const size_t row = store.clients.size();
+	store.rows[clientID] = row;
+	store.clients.push_back(clientID);
+	store.stale.push_back(1);
+	store.idle.push_back(0);
+	store.databaseID.push_back(0);
+	store.channelGroup.push_back(0);
+	store.talkPower.push_back(0);
+	store.talker.push_back(0);
+	store.inputMuted.push_back(0);
+	store.outputMuted.push_back(0);
+	store.away.push_back(0);
+	store.recording.push_back(0);
+	store.detailsAsked.push_back(Clock::time_point());
+	for(size_t g = 0; g < store.groupRows.size(); g++) {
+		store.groupRows[g].resize(COLUMN_WORDS(row + 1), 0);
+		assignBit(store.groupRows[g], row, false);
+	}
+	return row;
+}
+
+/* Swap-remove like the roster cache, the last row takes the place of the removed one. Caller holds columnsMutex. */
+static void removeRow(ServerColumns& store, anyID clientID) {
+	std::unordered_map<anyID, size_t>::iterator it = store.rows.find(clientID);
+	if(it == store.rows.end()) {
+		return;
+	}
+	const size_t row = it->second;
+	const size_t last = store.clients.size() - 1;
+	store.rows.erase(it);
+	if(row != last) {
+		store.clients[row] = store.clients[last];
+		store.rows[store.clients[row]] = row;
+		store.stale[row] = store.stale[last];
+		store.idle[row] = store.idle[last];
+		store.databaseID[row] = store.databaseID[last];
+		store.channelGroup[row] = store.channelGroup[last];
+		store.talkPower[row] = store.talkPower[last];
+		store.talker[row] = store.talker[last];
+		store.inputMuted[row] = store.inputMuted[last];
+		store.outputMuted[row] = store.outputMuted[last];
+		store.away[row] = store.away[last];
+		store.recording[row] = store.recording[last];
+		store.detailsAsked[row] = store.detailsAsked[last];
+		for(size_t g = 0; g < store.groupRows.size(); g++) {
+			assignBit(store.groupRows[g], row, testBit(store.groupRows[g], last));
+		}
+	}
+	store.clients.pop_back();
+	store.stale.pop_back();
+	store.idle.pop_back();
+	store.databaseID.pop_back();
+	store.channelGroup.pop_back();
+	store.talkPower.pop_back();
+	store.talker.pop_back();
+	store.inputMuted.pop_back();
+	store.outputMuted.pop_back();
+	store.away.pop_back();
+	store.recording.pop_back();
+	store.detailsAsked.pop_back();
+	for(size_t g = 0; g < store.groupRows.size(); g++) {
+		assignBit(store.groupRows[g], last, false);
+		store.groupRows[g].resize(COLUMN_WORDS(last));
+	}
+}
+
+static int readInt(uint64 serverConnectionHandlerID, anyID clientID, size_t flag) {
+	int value;
+	return ts3Functions.getClientVariableAsInt(serverConnectionHandlerID, clientID, flag, &value) == ERROR_ok ? value : 0;
+}
+
+static uint64 readUInt64(uint64 serverConnectionHandlerID, anyID clientID, size_t flag) {
+	uint64 value;
+	return ts3Functions.getClientVariableAsUInt64(serverConnectionHandlerID, clientID, flag, &value) == ERROR_ok ? value : 0;
+}
+
+static void readRow(uint64 serverConnectionHandlerID, anyID clientID, struct RowValues* values) {
+	values->clientID = clientID;
+	values->idle = readUInt64(serverConnectionHandlerID, clientID, CLIENT_IDLE_TIME);
+	values->databaseID = readUInt64(serverConnectionHandlerID, clientID, CLIENT_DATABASE_ID);
+	values->channelGroup = readUInt64(serverConnectionHandlerID, clientID, CLIENT_CHANNEL_GROUP_ID);
+	values->talkPower = readInt(serverConnectionHandlerID, clientID, CLIENT_TALK_POWER);
+	values->talker = readInt(serverConnectionHandlerID, clientID, CLIENT_IS_TALKER) != 0;
+	values->inputMuted = readInt(serverConnectionHandlerID, clientID, CLIENT_INPUT_MUTED) != 0;
+	values->outputMuted = readInt(serverConnectionHandlerID, clientID, CLIENT_OUTPUT_MUTED) != 0;
+	values->away = readInt(serverConnectionHandlerID, clientID, CLIENT_AWAY) != 0;
+	values->recording = readInt(serverConnectionHandlerID, clientID, CLIENT_IS_RECORDING) != 0;
+
+	/* A comma separated list of IDs */
+	values->groups.clear();
+	Ts3Buffer<char> list;
+	if(ts3Functions.getClientVariableAsString(serverConnectionHandlerID, clientID, CLIENT_SERVERGROUPS, list.out()) != ERROR_ok) {
+		return;
+	}
+	for(const char* p = list.get(); *p; ) {
+		char* end;
+		const uint64 groupID = strtoull(p, &end, 10);
+		if(end == p) {
+			break;
+		}
+		values->groups.push_back(groupID);
+		p = (*end == ',') ? end + 1 : end;
+	}
+}
+
+/* Caller holds columnsMutex */
+static void writeRow(ServerColumns& store, size_t row, const struct RowValues& values) {
+	store.idle[row] = values.idle;
+	store.databaseID[row] = values.databaseID;
+	store.channelGroup[row] = values.channelGroup;
+	store.talkPower[row] = values.talkPower;
+	store.talker[row] = values.talker;
+	store.inputMuted[row] = values.inputMuted;
+	store.outputMuted[row] = values.outputMuted;
+	store.away[row] = values.away;
+	store.recording[row] = values.recording;
+
+	for(size_t g = 0; g < store.groupRows.size(); g++) {
+		assignBit(store.groupRows[g], row, false);
+	}
+	for(size_t i = 0; i < values.groups.size(); i++) {
+		size_t g = 0;
+		while(g < store.groupIDs.size() && store.groupIDs[g] != values.groups[i]) {
+			g++;
+		}
+		if(g == store.groupIDs.size()) {
+			store.groupIDs.push_back(values.groups[i]);
+			store.groupRows.push_back(std::vector<uint64>(COLUMN_WORDS(store.clients.size()), 0));
+		}
+		assignBit(store.groupRows[g], row, true);
+	}
+}
+
+unsigned int clientColumnsSnapshot(const struct Roster& roster, struct ClientColumns* columns) {
+	const uint64 serverConnectionHandlerID = roster.serverConnectionHandlerID;
+
+	/* Stale rows are taken out of the store and read without the lock, an update meanwhile marks them again */
+	std::vector<struct RowValues> refreshed;
+	{
+		std::lock_guard<std::mutex> lock(columnsMutex);
+		std::map<uint64, ServerColumns>::iterator found = stores.find(serverConnectionHandlerID);
+		if(found == stores.end()) {
+			return ERROR_not_connected;
+		}
+		ServerColumns& store = found->second;
+		for(size_t i = 0; i < roster.clients.size(); i++) {
+			std::unordered_map<anyID, size_t>::const_iterator it = store.rows.find(roster.clients[i]);
+			const size_t row = (it != store.rows.end()) ? it->second : addRow(store, roster.clients[i]);
+			if(store.stale[row]) {
+				store.stale[row] = 0;
+				refreshed.push_back(RowValues());
+				refreshed.back().clientID = roster.clients[i];
+			}
+		}
+	}
+	for(size_t i = 0; i < refreshed.size(); i++) {
+		readRow(serverConnectionHandlerID, refreshed[i].clientID, &refreshed[i]);
+	}
+
+	std::lock_guard<std::mutex> lock(columnsMutex);
+	std::map<uint64, ServerColumns>::iterator found = stores.find(serverConnectionHandlerID);
+	if(found == stores.end()) {
+		return ERROR_not_connected;  /* Dropped while the rows were read */
+	}
+	ServerColumns& store = found->second;
+	for(size_t i = 0; i < refreshed.size(); i++) {
+		std::unordered_map<anyID, size_t>::const_iterator it = store.rows.find(refreshed[i].clientID);
+		if(it != store.rows.end()) {
+			writeRow(store, it->second, refreshed[i]);
+		}
+	}
+
+	/* Gather into roster order. A client that left while its row was read gets an empty row. */
+	const size_t rows = roster.clients.size();
+	std::vector<size_t> source(rows);
+	std::vector<unsigned char> present(rows);
+	for(size_t i = 0; i < rows; i++) {
+		std::unordered_map<anyID, size_t>::const_iterator it = store.rows.find(roster.clients[i]);
+		present[i] = (it != store.rows.end());
+		source[i] = present[i] ? it->second : 0;
+	}
+
+	columns->rows = rows;
+	columns->idle.resize(rows);
+	columns->databaseID.resize(rows);
+	columns->channelGroup.resize(rows);
+	columns->talkPower.resize(rows);
+	columns->talker.resize(rows);
+	columns->inputMuted.resize(rows);
+	columns->outputMuted.resize(rows);
+	columns->away.resize(rows);
+	columns->recording.resize(rows);
+	columns->detailsFresh.resize(rows);
+	const Clock::time_point freshSince = Clock::now() - std::chrono::milliseconds(DETAILS_FRESH_MS);
+	for(size_t i = 0; i < rows; i++) {
+		const size_t row = source[i];
+		const bool keep = present[i] != 0;
+		columns->idle[i] = keep ? store.idle[row] : 0;
+		columns->databaseID[i] = keep ? store.databaseID[row] : 0;
+		columns->channelGroup[i] = keep ? store.channelGroup[row] : 0;
+		columns->talkPower[i] = keep ? store.talkPower[row] : 0;
+		columns->talker[i] = keep ? store.talker[row] : 0;
+		columns->inputMuted[i] = keep ? store.inputMuted[row] : 0;
+		columns->outputMuted[i] = keep ? store.outputMuted[row] : 0;
+		columns->away[i] = keep ? store.away[row] : 0;
+		columns->recording[i] = keep ? store.recording[row] : 0;
+		columns->detailsFresh[i] = keep && store.detailsAsked[row] != Clock::time_point() && store.detailsAsked[row] >= freshSince;
+	}
+
+	columns->groupIDs = store.groupIDs;
+	columns->groupRows.assign(store.groupIDs.size(), std::vector<uint64>(COLUMN_WORDS(rows), 0));
+	for(size_t g = 0; g < store.groupIDs.size(); g++) {
+		for(size_t i = 0; i < rows; i++) {
+			if(present[i] && testBit(store.groupRows[g], source[i])) {
+				assignBit(columns->groupRows[g], i, true);
+			}
+		}
+	}
+	return ERROR_ok;
+}
+
+void clientColumnsDetailsAsked(uint64 serverConnectionHandlerID, const std::vector<anyID>& clients, std::chrono::steady_clock::time_point askedAt) {
+	std::lock_guard<std::mutex> lock(columnsMutex);
+	std::map<uint64, ServerColumns>::iterator it = stores.find(serverConnectionHandlerID);
+	if(it == stores.end()) {
+		return;
+	}
+	for(size_t i = 0; i < clients.size(); i++) {
+		std::unordered_map<anyID, size_t>::const_iterator row = it->second.rows.find(clients[i]);
+		if(row != it->second.rows.end()) {
+			it->second.detailsAsked[row->second] = askedAt;
+		}
+	}
+}
+
+void clientColumnsClientUpdated(uint64 serverConnectionHandlerID, anyID clientID) {
+	std::lock_guard<std::mutex> lock(columnsMutex);
+	std::map<uint64, ServerColumns>::iterator it = stores.find(serverConnectionHandlerID);
+	if(it == stores.end()) {
+		return;
+	}
+	std::unordered_map<anyID, size_t>::const_iterator row = it->second.rows.find(clientID);
+	if(row != it->second.rows.end()) {
+		it->second.stale[row->second] = 1;
+	}
+}
+
+void clientColumnsClientMoved(uint64 serverConnectionHandlerID, anyID clientID, uint64 newChannelID, int visibility) {
+	std::lock_guard<std::mutex> lock(columnsMutex);
+	std::map<uint64, ServerColumns>::iterator it = stores.find(serverConnectionHandlerID);
+	if(it == stores.end()) {
+		return;
+	}
+	if(newChannelID == 0 || visibility == LEAVE_VISIBILITY) {
+		removeRow(it->second, clientID);
+		return;
+	}
+	std::unordered_map<anyID, size_t>::const_iterator row = it->second.rows.find(clientID);
+	if(row != it->second.rows.end()) {
+		it->second.stale[row->second] = 1;
+	}
+}
+
+void clientColumnsOpen(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(columnsMutex);
+	stores[serverConnectionHandlerID] = ServerColumns();
+}
+
+void clientColumnsDrop(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(columnsMutex);
+	stores.erase(serverConnectionHandlerID);
+}
+
+void clientColumnsClear() {
+	std::lock_guard<std::mutex> lock(columnsMutex);
+	stores.clear();
+}
@@ -0,0 +1,64 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef CLIENT_COLUMNS_H
+#define CLIENT_COLUMNS_H
+
+#include <chrono>
+#include <vector>
+#include "teamspeak/public_definitions.h"
+#include "roster.h"
+
+/*
+ * Per server connection store of the client properties filters test, one array per property (structure of
+ * arrays). A client's row is read from the client lib when it is first needed and again only after
+ * onUpdateClientEvent or a move marked it stale, so a filter run costs getter calls only for what changed
+ * since the last one.
+ */
+
+/* Rows in the order of the roster they were taken for, bitsets hold one bit per row */
+struct ClientColumns {
+	size_t rows;
+	std::vector<uint64> idle;            /* Milliseconds, as of the last requestClientVariables */
+	std::vector<uint64> databaseID;
+	std::vector<uint64> channelGroup;
+	std::vector<int> talkPower;
+	std::vector<unsigned char> talker;   /* 0 or 1 */
+	std::vector<unsigned char> inputMuted;
+	std::vector<unsigned char> outputMuted;
+	std::vector<unsigned char> away;
+	std::vector<unsigned char> recording;
+	std::vector<unsigned char> detailsFresh;  /* 1 if idle time, platform and version were asked for lately */
+	std::vector<uint64> groupIDs;                   /* Every server group any of the rows is in */
+	std::vector<std::vector<uint64> > groupRows;    /* Membership bitset of each of groupIDs */
+};
+
+/* Words of a bitset over rows */
+#define COLUMN_WORDS(rows) (((rows) + 63) / 64)
+
+/*
+ * Reads stale rows of the roster's clients from the client lib and fills columns in roster order. Fails with
+ * ERROR_not_connected if the connection has no store, e.g. because it was dropped since the roster was taken.
+ */
+unsigned int clientColumnsSnapshot(const struct Roster& roster, struct ClientColumns* columns);
+
+/* The server answered requestClientVariables for clients, asked at askedAt. Their details count as fresh for a while. */
+void clientColumnsDetailsAsked(uint64 serverConnectionHandlerID, const std::vector<anyID>& clients, std::chrono::steady_clock::time_point askedAt);
+
+/* onUpdateClientEvent: the client's properties changed, its row is read again before the next use */
+void clientColumnsClientUpdated(uint64 serverConnectionHandlerID, anyID clientID);
+
+/* Moving changes the channel group, leaving frees the row for a client that gets the ID next */
+void clientColumnsClientMoved(uint64 serverConnectionHandlerID, anyID clientID, uint64 newChannelID, int visibility);
+
+/* Starts an empty store for a connection, called once it is established. Nothing else creates one. */
+void clientColumnsOpen(uint64 serverConnectionHandlerID);
+
+/* Forgets a connection resp. every connection, called on disconnect and shutdown */
+void clientColumnsDrop(uint64 serverConnectionHandlerID);
+void clientColumnsClear();
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef COLLECTOR_H
+#define COLLECTOR_H
+
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "teamspeak/public_definitions.h"
+#include "dispatcher.h"
+
+/*
+ * Answers the server sends as events before the return code of the request that asked for them. A collector
+ * keeps one Value per connection and Item while a worker thread waits: ask() opens the slots, sends one
+ * request per item as a batch and waits for it, the event callbacks fill the slots with update() and the
+ * worker empties them with take(). Events for slots nobody opened are dropped.
+ */
+template<typename Item, typename Value>
+class ReplyCollector {
+public:
+	/*
+	 * Opens a slot per item, queues dispatch(batchID, item) for each in a batch named name and waits for it.
+	 * Returns what dispatchWaitBatch does. The slots stay open until taken, also when 0 is returned.
+	 */
+	template<typename Dispatch>
+	int ask(uint64 serverConnectionHandlerID, const std::vector<Item>& items, const char* name, uint64 cancelGeneration, Dispatch dispatch, size_t* failed) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for(size_t i = 0; i < items.size(); i++) {
+				slots[Key(serverConnectionHandlerID, items[i])] = Value();
+			}
+		}
+		const uint64 batchID = dispatchBeginBatch(serverConnectionHandlerID, name);
+		for(size_t i = 0; i < items.size(); i++) {
+			dispatch(batchID, items[i]);
+		}
+		dispatchEndBatch(batchID);
+		return dispatchWaitBatch(batchID, cancelGeneration, failed);
+	}
+
+	int isOpen(uint64 serverConnectionHandlerID, const Item& item) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return slots.count(Key(serverConnectionHandlerID, item)) != 0;
+	}
+
+	/* Calls change(Value&) under the lock if the slot is open */
+	template<typename Change>
+	void update(uint64 serverConnectionHandlerID, const Item& item, Change change) {
+		std::lock_guard<std::mutex> lock(mutex);
+		typename std::map<Key, Value>::iterator it = slots.find(Key(serverConnectionHandlerID, item));
+		if(it != slots.end()) {
+			change(it->second);
+		}
+	}
+
+	/* Moves what the slot collected into value and closes it, returns 0 if it was not open */
+	int take(uint64 serverConnectionHandlerID, const Item& item, Value* value) {
+		std::lock_guard<std::mutex> lock(mutex);
+		typename std::map<Key, Value>::iterator it = slots.find(Key(serverConnectionHandlerID, item));
+		if(it == slots.end()) {
+			return 0;
+		}
+		*value = std::move(it->second);
+		slots.erase(it);
+		return 1;
+	}
+
+private:
+	typedef std::pair<uint64, Item> Key;  /* Connection, item */
+
+	std::mutex mutex;
+	std::map<Key, Value> slots;
+};
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_definitions.h"
+#include "ts3_functions.h"
+#include "globals.h"
+#include "ts3_buffer.h"
+#include "dispatcher.h"
+#include "collector.h"
+#include "connection_info.h"
+
+static ReplyCollector<anyID, std::string> clientAddresses;  /* Per client, empty until known */
+
+int connectionAddresses(uint64 serverConnectionHandlerID, const std::vector<anyID>& clients, uint64 cancelGeneration, std::map<anyID, std::string>* addresses) {
+	char name[64];
+	snprintf(name, sizeof(name), "Ask the server for the addresses of %u clients", (unsigned int)clients.size());
+	const int answered = clientAddresses.ask(serverConnectionHandlerID, clients, name, cancelGeneration, [&](uint64 batchID, anyID clientID) {
+		dispatchRequestConnectionInfo(serverConnectionHandlerID, batchID, clientID);
+	}, NULL);
+
+	for(size_t i = 0; i < clients.size(); i++) {
+		std::string address;
+		if(clientAddresses.take(serverConnectionHandlerID, clients[i], &address) && !address.empty()) {
+			(*addresses)[clients[i]] = address;
+		}
+	}
+	return answered;
+}
+
+void connectionInfoOnEvent(uint64 serverConnectionHandlerID, anyID clientID) {
+	if(!clientAddresses.isOpen(serverConnectionHandlerID, clientID)) {
+		return;
+	}
+	Ts3Buffer<char> address;
+	const unsigned int error = ts3Functions.getConnectionVariableAsString(serverConnectionHandlerID, clientID, CONNECTION_CLIENT_IP, address.out());
+	ts3Functions.cleanUpConnectionInfo(serverConnectionHandlerID, clientID);
+	if(error != ERROR_ok || !address.get()) {
+		return;
+	}
+	const std::string known = address.get();
+	clientAddresses.update(serverConnectionHandlerID, clientID, [&](std::string& slot) {
+		slot = known;
+	});
+}
@@ -0,0 +1,31 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef CONNECTION_INFO_H
+#define CONNECTION_INFO_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "teamspeak/public_definitions.h"
+
+/*
+ * Addresses of clients. The server only tells them on requestConnectionInfo, one client per request, and
+ * onConnectionInfoEvent says when the answer is there; the address is read right then and the client lib's
+ * copy of the connection info is freed again.
+ */
+
+/*
+ * Looks up the IP of every client in one batch. A refused request only means a client is missing from
+ * addresses, e.g. because they left meanwhile. Returns 0 if it was aborted since cancelGeneration or the
+ * connection dropped. Runs on the worker thread.
+ */
+int connectionAddresses(uint64 serverConnectionHandlerID, const std::vector<anyID>& clients, uint64 cancelGeneration, std::map<anyID, std::string>* addresses);
+
+/* onConnectionInfoEvent, reads the address if connectionAddresses asked for this client */
+void connectionInfoOnEvent(uint64 serverConnectionHandlerID, anyID clientID);
+
+#endif
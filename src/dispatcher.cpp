@@ -0,0 +1,911 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_errors_rare.h"
+#include "teamspeak/public_definitions.h"
+#include "ts3_functions.h"
+#include "globals.h"
+#include "ts3_buffer.h"
+#include "dispatcher.h"
+#include "trace.h"
+#include "journal.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define DISPATCH_INITIAL_RATE 8.0     /* Requests per second before anything was learned */
+#define DISPATCH_MIN_RATE     1.0
+#define DISPATCH_MAX_RATE     100.0
+#define DISPATCH_BURST        4.0     /* Token bucket capacity */
+#define DISPATCH_MAX_IN_FLIGHT 32     /* Unanswered requests per connection */
+#define DISPATCH_MAX_ATTEMPTS 6
+#define DISPATCH_BACKOFF_MS   1000    /* First pause after a flood error, doubled per consecutive flood */
+#define DISPATCH_MAX_BACKOFF_MS 16000
+#define BATCH_REPORT_TARGETS  5       /* Failed targets listed per error in a batch report */
+#define BATCH_PROGRESS_MS     2000    /* Minimum time between two progress lines of a batch */
+#define BATCH_REMEMBERED      64      /* Finished batches whose outcome dispatchWaitBatch can still tell */
+
+struct Pending {
+	struct Request request;
+	uint64 sequence;  /* Order it was queued in on its connection, flooded requests go back to their place */
+	int attempts;
+	Clock::time_point queuedAt;
+	Clock::time_point sentAt;
+	struct JournalRecord journal;  /* Target and invoker described when queued, while they are still known. Only while the journal is open. */
+};
+
+struct Batch {
+	uint64 id;
+	uint64 serverConnectionHandlerID;
+	std::string name;
+	size_t total;
+	size_t succeeded;
+	size_t failed;
+	size_t canceled;  /* Still queued when the batch was aborted */
+	int closed;
+	int quiet;        /* Only reported if something failed */
+	Clock::time_point started;
+	Clock::time_point lastProgress;
+	double latencySum;  /* Queued until answered, seconds */
+	double latencyMax;
+	double roundTripSum;  /* Last send until answered, seconds */
+	std::map<unsigned int, std::vector<struct Request> > failures;  /* Error -> failed requests */
+};
+
+/* Looked up before a connection's queue is created, never while dispatchMutex is held */
+struct ServerIdentity {
+	std::string serverUID;
+	std::string invokerUID;  /* Yourself, for the journal */
+	std::string invokerName;
+};
+
+struct ServerQueue {
+	std::string serverUID;
+	std::string invokerUID;
+	std::string invokerName;
+	std::deque<Pending> queue;  /* Ordered by sequence */
+	uint64 nextSequence;
+	std::map<std::string, Pending> inFlight;
+	double rate;
+	int slowStart;  /* No flood error seen on this virtual server yet, the rate doubles per round of clean answers */
+	double tokens;
+	Clock::time_point lastRefill;
+	Clock::time_point blockedUntil;
+	int floodStreak;
+};
+
+static std::mutex dispatchMutex;
+static std::condition_variable dispatchWake;
+static std::condition_variable batchDone;  /* A batch was finished or dropped, or everything was canceled */
+static uint64 cancelGeneration = 0;        /* Bumped by dispatcherCancelAll, tells waiters their batch was aborted */
+static std::map<uint64, ServerQueue> servers;
+struct LearnedRate {
+	double rate;    /* Requests per second */
+	int slowStart;  /* Still probing for the server's limit */
+};
+static std::map<std::string, LearnedRate> learnedRates;  /* Per virtual server UID */
+static std::map<uint64, Batch> batches;
+/* How the most recently finished batches ended */
+struct FinishedBatch {
+	size_t failed;
+	int dropped;  /* Its connection went away before all answers arrived */
+};
+static std::map<uint64, FinishedBatch> finishedBatches;
+/* A finished request whose onAnswered is still to be called */
+struct Answer {
+	uint64 serverConnectionHandlerID;
+	struct Request request;
+	unsigned int error;
+};
+/* What finished requests still need, collected under dispatchMutex and delivered by deliverFinished without it */
+struct Finished {
+	std::vector<Answer> answers;
+	std::vector<JournalRecord> records;  /* The journal copies into a mapped page, which may fault to disk */
+};
+static Finished finished;
+static uint64 nextBatchID = 1;
+static std::thread dispatchThread;
+static bool dispatchRunning = false;
+
+/* Calls into the client lib, so the caller must not hold dispatchMutex */
+static void lookupIdentity(uint64 serverConnectionHandlerID, struct ServerIdentity* identity) {
+	Ts3Buffer<char> serverUID;
+	if(ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_UNIQUE_IDENTIFIER, serverUID.out()) == ERROR_ok) {
+		identity->serverUID = serverUID.get();
+	}
+	if(journalIsOpen()) {
+		Ts3Buffer<char> uid, nickname;
+		if(ts3Functions.getClientSelfVariableAsString(serverConnectionHandlerID, CLIENT_UNIQUE_IDENTIFIER, uid.out()) == ERROR_ok) {
+			identity->invokerUID = uid.get();
+		}
+		if(ts3Functions.getClientSelfVariableAsString(serverConnectionHandlerID, CLIENT_NICKNAME, nickname.out()) == ERROR_ok) {
+			identity->invokerName = nickname.get();
+		}
+	}
+}
+
+/* Caller holds dispatchMutex. identity is only used if the connection has no queue yet. */
+static ServerQueue& serverQueue(uint64 serverConnectionHandlerID, const struct ServerIdentity& identity) {
+	std::map<uint64, ServerQueue>::iterator it = servers.find(serverConnectionHandlerID);
+	if(it != servers.end()) {
+		return it->second;
+	}
+
+	ServerQueue& server = servers[serverConnectionHandlerID];
+	server.serverUID = identity.serverUID;
+	server.invokerUID = identity.invokerUID;
+	server.invokerName = identity.invokerName;
+	server.nextSequence = 0;
+	std::map<std::string, LearnedRate>::const_iterator learned = learnedRates.find(server.serverUID);
+	server.rate = (learned != learnedRates.end()) ? learned->second.rate : DISPATCH_INITIAL_RATE;
+	server.slowStart = (learned != learnedRates.end()) ? learned->second.slowStart : 1;
+	server.tokens = DISPATCH_BURST;
+	server.lastRefill = Clock::now();
+	server.blockedUntil = server.lastRefill;
+	server.floodStreak = 0;
+	return server;
+}
+
+static void setRate(ServerQueue& server, double rate) {
+	server.rate = std::max(DISPATCH_MIN_RATE, std::min(DISPATCH_MAX_RATE, rate));
+	if(!server.serverUID.empty()) {
+		const struct LearnedRate learned = { server.rate, server.slowStart };
+		learnedRates[server.serverUID] = learned;
+	}
+}
+
+/* Caller holds dispatchMutex */
+static void rememberFinished(uint64 batchID, size_t failed, int dropped) {
+	const struct FinishedBatch finished = { failed, dropped };
+	finishedBatches[batchID] = finished;
+	if(finishedBatches.size() > BATCH_REMEMBERED) {
+		finishedBatches.erase(finishedBatches.begin());
+	}
+}
+
+/* Caller holds dispatchMutex. Queues the final report of a batch once it is closed and fully answered. */
+static void checkBatch(std::map<uint64, Batch>::iterator it, std::vector<Batch>& reports) {
+	if(it->second.closed && it->second.succeeded + it->second.failed + it->second.canceled == it->second.total) {
+		reports.push_back(it->second);
+		rememberFinished(it->first, it->second.failed, 0);
+		batches.erase(it);
+		batchDone.notify_all();
+	}
+}
+
+/* Lists are answered with "empty result" when there is nothing to list */
+static bool isListing(enum RequestVerb verb) {
+	return verb == VERB_LIST_GROUP_MEMBERS || verb == VERB_LIST_CHANNEL_PERMISSIONS;
+}
+
+/* Requests that only ask the server something, they are not journaled */
+static bool isQuery(enum RequestVerb verb) {
+	return verb == VERB_REQUEST_VARIABLES || verb == VERB_REQUEST_CONNECTION_INFO || isListing(verb);
+}
+
+/* Requests about a channel rather than a client */
+static bool isChannelVerb(enum RequestVerb verb) {
+	return verb == VERB_DELETE_CHANNEL || verb == VERB_LIST_CHANNEL_PERMISSIONS || verb == VERB_ADD_CHANNEL_PERMISSIONS || verb == VERB_DELETE_CHANNEL_PERMISSIONS;
+}
+
+static bool isGroupChange(enum RequestVerb verb) {
+	return verb == VERB_ADD_TO_GROUP || verb == VERB_REMOVE_FROM_GROUP || verb == VERB_SET_CHANNEL_GROUPS;
+}
+
+/* Caller holds dispatchMutex. Accounts the final answer of a request to its batch and collects its journal record. */
+static void finishRequest(uint64 serverConnectionHandlerID, Pending& pending, unsigned int error, std::vector<Batch>& reports) {
+	if(isListing(pending.request.verb) && error == ERROR_database_empty_result) {
+		error = ERROR_ok;  /* Nothing to list */
+	}
+	if(pending.request.onAnswered) {
+		const struct Answer answer = { serverConnectionHandlerID, pending.request, error };
+		finished.answers.push_back(answer);
+	}
+	if(journalIsOpen() && !isQuery(pending.request.verb)) {
+		struct JournalRecord& record = pending.journal;
+		record.channelID = isGroupChange(pending.request.verb) ? pending.request.groupID : pending.request.channelID;
+		record.result = error;
+		record.verb = (unsigned short)pending.request.verb;
+		record.clientID = pending.request.clientID;
+		finished.records.push_back(record);
+	}
+
+	std::map<uint64, Batch>::iterator it = batches.find(pending.request.batchID);
+	if(it == batches.end()) {
+		return;
+	}
+
+	Batch& batch = it->second;
+	const Clock::time_point now = Clock::now();
+	const double latency = std::chrono::duration<double>(now - pending.queuedAt).count();
+	batch.latencySum += latency;
+	batch.latencyMax = std::max(batch.latencyMax, latency);
+	batch.roundTripSum += std::chrono::duration<double>(now - pending.sentAt).count();
+	if(error == ERROR_ok) {
+		batch.succeeded++;
+	} else {
+		batch.failed++;
+		batch.failures[error].push_back(pending.request);
+	}
+
+	/* Throttled progress for long batches, the final report replaces the last one */
+	if(batch.closed && now - batch.lastProgress >= std::chrono::milliseconds(BATCH_PROGRESS_MS) && batch.succeeded + batch.failed + batch.canceled < batch.total) {
+		batch.lastProgress = now;
+		reports.push_back(batch);
+	}
+	checkBatch(it, reports);
+}
+
+/* Prints a progress line for unfinished batches and the full report for finished ones */
+static void printBatchStatus(const Batch& batch) {
+	const double elapsed = std::chrono::duration<double>(Clock::now() - batch.started).count();
+	const size_t answered = batch.succeeded + batch.failed;
+	char message[512];
+
+	if(answered + batch.canceled < batch.total) {
+		if(batch.quiet) {
+			return;
+		}
+		snprintf(message, sizeof(message), "[b]Mass actions:[/b] %s: %u/%u done, %u failed (%.1f actions/s)",
+			batch.name.c_str(), (unsigned int)answered, (unsigned int)batch.total, (unsigned int)batch.failed, elapsed > 0 ? answered / elapsed : 0.0);
+		ts3Functions.printMessage(batch.serverConnectionHandlerID, message, PLUGIN_MESSAGE_TARGET_SERVER);
+		return;
+	}
+
+	traceFinish(batch.id);
+	if(!batch.total || (batch.quiet && !batch.failed && !batch.canceled)) {
+		return;  /* Empty batches are not worth a report, quiet ones only if they failed */
+	}
+	snprintf(message, sizeof(message), "[b]Mass actions:[/b] %s %s, %u/%u succeeded in %.1f s (%.1f actions/s, latency avg %.0f ms, max %.0f ms, round trip avg %.0f ms)",
+		batch.name.c_str(), batch.canceled ? "aborted" : "finished", (unsigned int)batch.succeeded, (unsigned int)batch.total, elapsed, elapsed > 0 ? answered / elapsed : 0.0,
+		answered ? 1000.0 * batch.latencySum / answered : 0.0, 1000.0 * batch.latencyMax, answered ? 1000.0 * batch.roundTripSum / answered : 0.0);
+	ts3Functions.printMessage(batch.serverConnectionHandlerID, message, PLUGIN_MESSAGE_TARGET_SERVER);
+	if(batch.canceled) {
+		snprintf(message, sizeof(message), "%u requests were still queued and have not been sent", (unsigned int)batch.canceled);
+		ts3Functions.printMessage(batch.serverConnectionHandlerID, message, PLUGIN_MESSAGE_TARGET_SERVER);
+	}
+
+	for(std::map<unsigned int, std::vector<struct Request> >::const_iterator it = batch.failures.begin(); it != batch.failures.end(); ++it) {
+		Ts3Buffer<char> errorMessage;
+		std::string line;
+		if(ts3Functions.getErrorMessage(it->first, errorMessage.out()) == ERROR_ok) {
+			line = errorMessage.get();
+		} else {
+			snprintf(message, sizeof(message), "error %u", it->first);
+			line = message;
+		}
+
+		snprintf(message, sizeof(message), "%ux ", (unsigned int)it->second.size());
+		line = message + line + ":";
+		for(size_t i = 0; i < it->second.size() && i < BATCH_REPORT_TARGETS; i++) {
+			const struct Request& request = it->second[i];
+			if(isChannelVerb(request.verb)) {
+				snprintf(message, sizeof(message), " channel %llu", (long long unsigned int)request.channelID);
+			} else if(request.verb == VERB_LIST_GROUP_MEMBERS) {
+				snprintf(message, sizeof(message), " server group %llu", (long long unsigned int)request.groupID);
+			} else if(request.verb == VERB_SET_CHANNEL_GROUPS) {
+				snprintf(message, sizeof(message), " %u clients", (unsigned int)(request.entries.size() / 2));
+			} else if(request.verb == VERB_BAN_ADDRESS) {
+				snprintf(message, sizeof(message), " address %s", request.address.c_str());
+			} else {
+				snprintf(message, sizeof(message), " client %u", (unsigned int)request.clientID);
+			}
+			line += message;
+		}
+		if(it->second.size() > BATCH_REPORT_TARGETS) {
+			line += " ...";
+		}
+		ts3Functions.printMessage(batch.serverConnectionHandlerID, line.c_str(), PLUGIN_MESSAGE_TARGET_SERVER);
+	}
+}
+
+static void printBatchStatuses(const std::vector<Batch>& reports) {
+	for(size_t i = 0; i < reports.size(); i++) {
+		printBatchStatus(reports[i]);
+	}
+}
+
+/* Caller must not hold dispatchMutex, onAnswered may queue the next request */
+static void deliverFinished(Finished& taken) {
+	for(size_t i = 0; i < taken.records.size(); i++) {
+		journalAppend(taken.records[i]);
+	}
+	for(size_t i = 0; i < taken.answers.size(); i++) {
+		taken.answers[i].request.onAnswered(taken.answers[i].serverConnectionHandlerID, taken.answers[i].request, taken.answers[i].error);
+	}
+}
+
+static bool queuedBefore(const Pending& a, const Pending& b) {
+	return a.sequence < b.sequence;
+}
+
+/*
+ * Caller holds dispatchMutex. Requeues a flooded request and pauses the connection. The requests flooded by
+ * one burst are answered one by one, each goes back to where it was queued, so they are resent in order.
+ */
+static void onFlood(uint64 serverConnectionHandlerID, ServerQueue& server, Pending pending, std::vector<Batch>& reports) {
+	const Clock::time_point now = Clock::now();
+
+	if(++pending.attempts >= DISPATCH_MAX_ATTEMPTS) {
+		printf("PLUGIN: dispatcher: dropping request after %d flood errors\n", pending.attempts);
+		finishRequest(serverConnectionHandlerID, pending, ERROR_client_is_flooding, reports);
+	} else {
+		server.queue.insert(std::upper_bound(server.queue.begin(), server.queue.end(), pending, queuedBefore), pending);
+	}
+
+	/* Every request in flight gets flooded at once, only back off once per pause */
+	if(now < server.blockedUntil) {
+		return;
+	}
+	const int backoff = std::min(DISPATCH_MAX_BACKOFF_MS, DISPATCH_BACKOFF_MS << std::min(server.floodStreak, 4));
+	server.floodStreak++;
+	server.blockedUntil = now + std::chrono::milliseconds(backoff);
+	server.tokens = 0;
+	server.slowStart = 0;
+	setRate(server, server.rate * 0.5);
+	traceBackoff(pending.request.batchID, backoff, server.rate);
+	printf("PLUGIN: dispatcher: flooding on %llu, pausing %d ms, rate now %.1f/s\n", (long long unsigned int)serverConnectionHandlerID, backoff, server.rate);
+}
+
+/* banadd takes a regular expression, unescaped 10.0.0.1 would also ban 10.0.0.10 and 10.0.0.100 */
+static std::string addressPattern(const std::string& address) {
+	std::string pattern = "^";
+	for(size_t i = 0; i < address.size(); i++) {
+		if(strchr(".[]()*+?{}|^$\\", address[i])) {
+			pattern += '\\';
+		}
+		pattern += address[i];
+	}
+	return pattern + "$";
+}
+
+static unsigned int sendRequest(uint64 serverConnectionHandlerID, const struct Request& request, const char* returnCode) {
+	switch(request.verb) {
+		case VERB_MOVE:
+			return ts3Functions.requestClientMove(serverConnectionHandlerID, request.clientID, request.channelID, "", returnCode);
+		case VERB_KICK_FROM_CHANNEL:
+			return ts3Functions.requestClientKickFromChannel(serverConnectionHandlerID, request.clientID, "", returnCode);
+		case VERB_KICK_FROM_SERVER:
+			return ts3Functions.requestClientKickFromServer(serverConnectionHandlerID, request.clientID, request.reason.c_str(), returnCode);
+		case VERB_SET_IS_TALKER:
+			return ts3Functions.requestClientSetIsTalker(serverConnectionHandlerID, request.clientID, request.value, returnCode);
+		case VERB_DELETE_CHANNEL:
+			return ts3Functions.requestChannelDelete(serverConnectionHandlerID, request.channelID, request.value, returnCode);
+		case VERB_REQUEST_VARIABLES:
+			return ts3Functions.requestClientVariables(serverConnectionHandlerID, request.clientID, returnCode);
+		case VERB_LIST_GROUP_MEMBERS:
+			return ts3Functions.requestServerGroupClientList(serverConnectionHandlerID, request.groupID, 0, returnCode);
+		case VERB_ADD_TO_GROUP:
+			return ts3Functions.requestServerGroupAddClient(serverConnectionHandlerID, request.groupID, request.databaseID, returnCode);
+		case VERB_REMOVE_FROM_GROUP:
+			return ts3Functions.requestServerGroupDelClient(serverConnectionHandlerID, request.groupID, request.databaseID, returnCode);
+		case VERB_SET_CHANNEL_GROUPS: {
+			const size_t size = request.entries.size() / 2;
+			std::vector<uint64> groups(size, request.groupID), channels(size), databaseIDs(size);
+			for(size_t i = 0; i < size; i++) {
+				channels[i] = request.entries[2 * i];
+				databaseIDs[i] = request.entries[2 * i + 1];
+			}
+			return ts3Functions.requestSetClientChannelGroup(serverConnectionHandlerID, groups.data(), channels.data(), databaseIDs.data(), (int)size, returnCode);
+		}
+		case VERB_LIST_CHANNEL_PERMISSIONS:
+			return ts3Functions.requestChannelPermList(serverConnectionHandlerID, request.channelID, returnCode);
+		case VERB_ADD_CHANNEL_PERMISSIONS: {
+			const size_t size = request.entries.size() / 2;
+			std::vector<unsigned int> permissions(size);
+			std::vector<int> values(size);
+			for(size_t i = 0; i < size; i++) {
+				permissions[i] = (unsigned int)request.entries[2 * i];
+				values[i] = (int)(unsigned int)request.entries[2 * i + 1];
+			}
+			return ts3Functions.requestChannelAddPerm(serverConnectionHandlerID, request.channelID, permissions.data(), values.data(), (int)size, returnCode);
+		}
+		case VERB_DELETE_CHANNEL_PERMISSIONS: {
+			const std::vector<unsigned int> permissions(request.entries.begin(), request.entries.end());
+			return ts3Functions.requestChannelDelPerm(serverConnectionHandlerID, request.channelID, permissions.data(), (int)permissions.size(), returnCode);
+		}
+		case VERB_REQUEST_CONNECTION_INFO:
+			return ts3Functions.requestConnectionInfo(serverConnectionHandlerID, request.clientID, returnCode);
+		case VERB_BAN_ADDRESS:
+			return ts3Functions.banadd(serverConnectionHandlerID, addressPattern(request.address).c_str(), "", "", request.seconds, request.reason.c_str(), returnCode);
+		case VERB_BAN_CLIENT:
+			return ts3Functions.banclient(serverConnectionHandlerID, request.clientID, request.seconds, request.reason.c_str(), returnCode);
+	}
+	return ERROR_parameter_invalid;
+}
+
+static void dispatchLoop() {
+	std::unique_lock<std::mutex> lock(dispatchMutex);
+	while(dispatchRunning) {
+		const Clock::time_point now = Clock::now();
+		Clock::time_point wakeAt = Clock::time_point::max();
+		std::vector<Batch> reports;
+		bool sent = false;
+
+		for(std::map<uint64, ServerQueue>::iterator it = servers.begin(); it != servers.end(); ++it) {
+			ServerQueue& server = it->second;
+			if(server.queue.empty()) {
+				continue;
+			}
+			if(now < server.blockedUntil) {
+				wakeAt = std::min(wakeAt, server.blockedUntil);
+				continue;
+			}
+
+			const double elapsed = std::chrono::duration<double>(now - server.lastRefill).count();
+			server.tokens = std::min(DISPATCH_BURST, server.tokens + elapsed * server.rate);
+			server.lastRefill = now;
+
+			if(server.inFlight.size() >= DISPATCH_MAX_IN_FLIGHT) {
+				continue;  /* Woken again by the next answer */
+			}
+			if(server.queue.front().request.barrier && !server.inFlight.empty()) {
+				continue;
+			}
+			if(server.tokens < 1.0) {
+				wakeAt = std::min(wakeAt, now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((1.0 - server.tokens) / server.rate)));
+				continue;
+			}
+
+			server.tokens -= 1.0;
+			Pending pending = server.queue.front();
+			server.queue.pop_front();
+			pending.sentAt = now;
+
+			char returnCode[RETURNCODE_BUFSIZE];
+			ts3Functions.createReturnCode(pluginID, returnCode, RETURNCODE_BUFSIZE);
+			server.inFlight.insert(std::make_pair(std::string(returnCode), pending));
+			traceRequestSent(returnCode, pending.request, pending.attempts, std::chrono::duration<double>(now - pending.queuedAt).count());
+			traceCounters(pending.request.batchID, server.rate, server.inFlight.size(), server.queue.size());
+
+			/* Don't hold the lock while calling into the client lib, its callbacks need it */
+			const uint64 serverConnectionHandlerID = it->first;
+			lock.unlock();
+			const unsigned int error = sendRequest(serverConnectionHandlerID, pending.request, returnCode);
+			lock.lock();
+
+			if(error != ERROR_ok) {
+				/* Rejected locally, no answer will ever come for this return code */
+				std::map<uint64, ServerQueue>::iterator again = servers.find(serverConnectionHandlerID);
+				if(again != servers.end() && again->second.inFlight.erase(returnCode)) {
+					traceRequestAnswered(returnCode, pending.request, error, 1);
+					if(error == ERROR_client_is_flooding) {
+						onFlood(serverConnectionHandlerID, again->second, pending, reports);
+					} else {
+						finishRequest(serverConnectionHandlerID, pending, error, reports);
+					}
+				}
+			}
+			sent = true;
+			break;  /* servers may have changed while unlocked */
+		}
+
+		if(!reports.empty()) {
+			lock.unlock();
+			printBatchStatuses(reports);
+			lock.lock();
+		}
+		if(!finished.answers.empty() || !finished.records.empty()) {
+			Finished taken;
+			std::swap(taken, finished);
+			lock.unlock();
+			deliverFinished(taken);
+			lock.lock();
+		}
+		if(sent) {
+			continue;
+		}
+		if(wakeAt == Clock::time_point::max()) {
+			dispatchWake.wait(lock);
+		} else {
+			dispatchWake.wait_until(lock, wakeAt);
+		}
+	}
+}
+
+void dispatcherStart() {
+	std::lock_guard<std::mutex> lock(dispatchMutex);
+	if(dispatchRunning) {
+		return;
+	}
+	dispatchRunning = true;
+	dispatchThread = std::thread(dispatchLoop);
+}
+
+void dispatcherStop() {
+	{
+		std::lock_guard<std::mutex> lock(dispatchMutex);
+		if(!dispatchRunning) {
+			return;
+		}
+		dispatchRunning = false;
+		servers.clear();
+		batches.clear();
+		finishedBatches.clear();
+		finished = Finished();
+	}
+	dispatchWake.notify_all();
+	batchDone.notify_all();
+	dispatchThread.join();
+}
+
+static uint64 beginBatch(uint64 serverConnectionHandlerID, const char* name, int quiet) {
+	std::lock_guard<std::mutex> lock(dispatchMutex);
+	const uint64 batchID = nextBatchID++;
+	Batch& batch = batches[batchID];
+	batch.id = batchID;
+	batch.serverConnectionHandlerID = serverConnectionHandlerID;
+	batch.name = name;
+	batch.total = 0;
+	batch.succeeded = 0;
+	batch.failed = 0;
+	batch.canceled = 0;
+	batch.closed = 0;
+	batch.quiet = quiet;
+	batch.started = Clock::now();
+	batch.lastProgress = batch.started;
+	batch.latencySum = 0;
+	batch.latencyMax = 0;
+	batch.roundTripSum = 0;
+	traceBegin(batchID, serverConnectionHandlerID, name);
+	return batchID;
+}
+
+uint64 dispatchBeginBatch(uint64 serverConnectionHandlerID, const char* name) {
+	return beginBatch(serverConnectionHandlerID, name, 0);
+}
+
+uint64 dispatchBeginQuietBatch(uint64 serverConnectionHandlerID, const char* name) {
+	return beginBatch(serverConnectionHandlerID, name, 1);
+}
+
+void dispatchEndBatch(uint64 batchID) {
+	std::vector<Batch> reports;
+	{
+		std::lock_guard<std::mutex> lock(dispatchMutex);
+		std::map<uint64, Batch>::iterator it = batches.find(batchID);
+		if(it == batches.end()) {
+			return;
+		}
+		it->second.closed = 1;
+		checkBatch(it, reports);
+	}
+	printBatchStatuses(reports);
+}
+
+size_t dispatchCancelBatch(uint64 batchID) {
+	std::vector<Batch> reports;
+	size_t canceled = 0;
+	{
+		std::lock_guard<std::mutex> lock(dispatchMutex);
+		std::map<uint64, Batch>::iterator it = batches.find(batchID);
+		if(it == batches.end()) {
+			return 0;
+		}
+		std::map<uint64, ServerQueue>::iterator server = servers.find(it->second.serverConnectionHandlerID);
+		if(server != servers.end()) {
+			std::deque<Pending>& queue = server->second.queue;
+			for(std::deque<Pending>::iterator pending = queue.begin(); pending != queue.end();) {
+				if(pending->request.batchID == batchID) {
+					pending = queue.erase(pending);
+					canceled++;
+				} else {
+					++pending;
+				}
+			}
+		}
+		it->second.canceled += canceled;
+		it->second.closed = 1;
+		checkBatch(it, reports);
+	}
+	printBatchStatuses(reports);
+	return canceled;
+}
+
+/* Names the target in the journal record, by the time the answer arrives a kicked client is gone */
+static void describeTarget(uint64 serverConnectionHandlerID, const struct Request& request, struct JournalRecord& record) {
+	memset(&record, 0, sizeof(record));
+	Ts3Buffer<char> uid, name;
+	if(request.verb == VERB_SET_CHANNEL_GROUPS) {
+		snprintf(record.targetName, sizeof(record.targetName), "%u clients", (unsigned int)(request.entries.size() / 2));
+		return;
+	}
+	if(request.verb == VERB_BAN_ADDRESS) {
+		journalCopy(record.targetName, sizeof(record.targetName), request.address.c_str());
+		return;
+	}
+	if(isChannelVerb(request.verb)) {
+		if(ts3Functions.getChannelVariableAsString(serverConnectionHandlerID, request.channelID, CHANNEL_NAME, name.out()) == ERROR_ok) {
+			journalCopy(record.targetName, sizeof(record.targetName), name.get());
+		}
+		return;
+	}
+	if(ts3Functions.getClientVariableAsString(serverConnectionHandlerID, request.clientID, CLIENT_UNIQUE_IDENTIFIER, uid.out()) == ERROR_ok) {
+		journalCopy(record.targetUID, sizeof(record.targetUID), uid.get());
+	}
+	if(ts3Functions.getClientVariableAsString(serverConnectionHandlerID, request.clientID, CLIENT_NICKNAME, name.out()) == ERROR_ok) {
+		journalCopy(record.targetName, sizeof(record.targetName), name.get());
+	}
+}
+
+void dispatchRequest(uint64 serverConnectionHandlerID, const struct Request& request) {
+	const Clock::time_point now = Clock::now();
+	Pending pending = { request, 0, 0, now, now, JournalRecord() };
+	const bool journaled = journalIsOpen() && !isQuery(request.verb);
+	if(journaled) {
+		describeTarget(serverConnectionHandlerID, request, pending.journal);
+	}
+	struct ServerIdentity identity;
+	bool known;
+	{
+		std::lock_guard<std::mutex> lock(dispatchMutex);
+		const std::map<uint64, ServerQueue>::const_iterator it = servers.find(serverConnectionHandlerID);
+		known = it != servers.end();
+		if(known && journaled) {
+			identity.serverUID = it->second.serverUID;
+			identity.invokerUID = it->second.invokerUID;
+			identity.invokerName = it->second.invokerName;
+		}
+	}
+	if(!known) {
+		lookupIdentity(serverConnectionHandlerID, &identity);
+	}
+	if(journaled) {
+		journalCopy(pending.journal.serverUID, sizeof(pending.journal.serverUID), identity.serverUID.c_str());
+		journalCopy(pending.journal.invokerUID, sizeof(pending.journal.invokerUID), identity.invokerUID.c_str());
+		journalCopy(pending.journal.invokerName, sizeof(pending.journal.invokerName), identity.invokerName.c_str());
+	}
+	{
+		std::lock_guard<std::mutex> lock(dispatchMutex);
+		std::map<uint64, Batch>::iterator batch = batches.find(request.batchID);
+		if(batch != batches.end()) {
+			batch->second.total++;
+		}
+		ServerQueue& server = serverQueue(serverConnectionHandlerID, identity);
+		pending.sequence = server.nextSequence++;
+		server.queue.push_back(pending);
+	}
+	dispatchWake.notify_all();
+}
+
+void dispatchClientMove(uint64 serverConnectionHandlerID, uint64 batchID, anyID clientID, uint64 newChannelID) {
+	struct Request request(batchID, VERB_MOVE);
+	request.clientID = clientID;
+	request.channelID = newChannelID;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+void dispatchKickFromChannel(uint64 serverConnectionHandlerID, uint64 batchID, anyID clientID) {
+	struct Request request(batchID, VERB_KICK_FROM_CHANNEL);
+	request.clientID = clientID;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+void dispatchKickFromServer(uint64 serverConnectionHandlerID, uint64 batchID, anyID clientID, int barrier) {
+	struct Request request(batchID, VERB_KICK_FROM_SERVER);
+	request.clientID = clientID;
+	request.barrier = barrier;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+void dispatchSetIsTalker(uint64 serverConnectionHandlerID, uint64 batchID, anyID clientID, int isTalker) {
+	struct Request request(batchID, VERB_SET_IS_TALKER);
+	request.clientID = clientID;
+	request.value = isTalker;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+void dispatchChannelDelete(uint64 serverConnectionHandlerID, uint64 batchID, uint64 channelID, int force) {
+	struct Request request(batchID, VERB_DELETE_CHANNEL);
+	request.channelID = channelID;
+	request.value = force;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+void dispatchRequestVariables(uint64 serverConnectionHandlerID, uint64 batchID, anyID clientID) {
+	struct Request request(batchID, VERB_REQUEST_VARIABLES);
+	request.clientID = clientID;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+void dispatchListGroupMembers(uint64 serverConnectionHandlerID, uint64 batchID, uint64 groupID) {
+	struct Request request(batchID, VERB_LIST_GROUP_MEMBERS);
+	request.groupID = groupID;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+void dispatchAddToGroup(uint64 serverConnectionHandlerID, uint64 batchID, uint64 groupID, uint64 databaseID, anyID clientID) {
+	struct Request request(batchID, VERB_ADD_TO_GROUP);
+	request.clientID = clientID;
+	request.groupID = groupID;
+	request.databaseID = databaseID;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+void dispatchRemoveFromGroup(uint64 serverConnectionHandlerID, uint64 batchID, uint64 groupID, uint64 databaseID, anyID clientID) {
+	struct Request request(batchID, VERB_REMOVE_FROM_GROUP);
+	request.clientID = clientID;
+	request.groupID = groupID;
+	request.databaseID = databaseID;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+void dispatchSetChannelGroups(uint64 serverConnectionHandlerID, uint64 batchID, uint64 channelGroupID, const std::vector<uint64>& entries) {
+	struct Request request(batchID, VERB_SET_CHANNEL_GROUPS);
+	request.groupID = channelGroupID;
+	request.entries = entries;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+void dispatchListChannelPermissions(uint64 serverConnectionHandlerID, uint64 batchID, uint64 channelID) {
+	struct Request request(batchID, VERB_LIST_CHANNEL_PERMISSIONS);
+	request.channelID = channelID;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+void dispatchAddChannelPermissions(uint64 serverConnectionHandlerID, uint64 batchID, uint64 channelID, const std::vector<uint64>& entries) {
+	struct Request request(batchID, VERB_ADD_CHANNEL_PERMISSIONS);
+	request.channelID = channelID;
+	request.entries = entries;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+void dispatchDeleteChannelPermissions(uint64 serverConnectionHandlerID, uint64 batchID, uint64 channelID, const std::vector<uint64>& entries) {
+	struct Request request(batchID, VERB_DELETE_CHANNEL_PERMISSIONS);
+	request.channelID = channelID;
+	request.entries = entries;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+void dispatchRequestConnectionInfo(uint64 serverConnectionHandlerID, uint64 batchID, anyID clientID) {
+	struct Request request(batchID, VERB_REQUEST_CONNECTION_INFO);
+	request.clientID = clientID;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+void dispatchBanAddress(uint64 serverConnectionHandlerID, uint64 batchID, const std::string& address, anyID clientID, uint64 seconds, const std::string& reason) {
+	struct Request request(batchID, VERB_BAN_ADDRESS);
+	request.clientID = clientID;
+	request.address = address;
+	request.seconds = seconds;
+	request.reason = reason;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+void dispatchBanClient(uint64 serverConnectionHandlerID, uint64 batchID, anyID clientID, uint64 seconds, const std::string& reason) {
+	struct Request request(batchID, VERB_BAN_CLIENT);
+	request.clientID = clientID;
+	request.seconds = seconds;
+	request.reason = reason;
+	dispatchRequest(serverConnectionHandlerID, request);
+}
+
+int dispatchWaitBatch(uint64 batchID, uint64 generation, size_t* failed) {
+	std::unique_lock<std::mutex> lock(dispatchMutex);
+	batchDone.wait(lock, [&]() { return !batches.count(batchID) || cancelGeneration != generation || !dispatchRunning; });
+	const std::map<uint64, FinishedBatch>::const_iterator it = finishedBatches.find(batchID);
+	const int dropped = it != finishedBatches.end() && it->second.dropped;
+	if(failed) {
+		*failed = (it != finishedBatches.end()) ? it->second.failed : 0;
+	}
+	return cancelGeneration == generation && dispatchRunning && !dropped;
+}
+
+int dispatcherOnServerError(uint64 serverConnectionHandlerID, unsigned int error, const char* returnCode) {
+	if(!returnCode || !*returnCode) {
+		return 0;
+	}
+
+	std::vector<Batch> reports;
+	Finished taken;
+	{
+		std::lock_guard<std::mutex> lock(dispatchMutex);
+		std::map<uint64, ServerQueue>::iterator it = servers.find(serverConnectionHandlerID);
+		if(it == servers.end()) {
+			return 0;
+		}
+		ServerQueue& server = it->second;
+		std::map<std::string, Pending>::iterator flight = server.inFlight.find(returnCode);
+		if(flight == server.inFlight.end()) {
+			return 0;
+		}
+		Pending pending = flight->second;
+		server.inFlight.erase(flight);
+		traceRequestAnswered(returnCode, pending.request, error, 0);
+
+		if(error == ERROR_client_is_flooding) {
+			onFlood(serverConnectionHandlerID, server, pending, reports);
+		} else {
+			/*
+			 * Slow start: +1 request/s per clean answer doubles the rate every second, until the first flood
+			 * error shows where the limit is. From then on additive increase, roughly +1 request/s per second.
+			 */
+			setRate(server, server.rate + (server.slowStart ? 1.0 : 1.0 / server.rate));
+			server.floodStreak = 0;
+			finishRequest(serverConnectionHandlerID, pending, error, reports);
+		}
+		traceCounters(pending.request.batchID, server.rate, server.inFlight.size(), server.queue.size());
+		std::swap(taken, finished);
+	}
+	dispatchWake.notify_all();
+	printBatchStatuses(reports);
+	deliverFinished(taken);
+	return 1;  /* Failures end up in the batch report */
+}
+
+size_t dispatcherCancelAll() {
+	std::vector<Batch> reports;
+	size_t canceled = 0;
+	{
+		std::lock_guard<std::mutex> lock(dispatchMutex);
+		for(std::map<uint64, ServerQueue>::iterator it = servers.begin(); it != servers.end(); ++it) {
+			std::deque<Pending>& queue = it->second.queue;
+			for(size_t i = 0; i < queue.size(); i++) {
+				std::map<uint64, Batch>::iterator batch = batches.find(queue[i].request.batchID);
+				if(batch != batches.end()) {
+					batch->second.canceled++;
+				}
+			}
+			canceled += queue.size();
+			queue.clear();
+		}
+		cancelGeneration++;
+		batchDone.notify_all();
+		for(std::map<uint64, Batch>::iterator it = batches.begin(); it != batches.end();) {
+			checkBatch(it++, reports);
+		}
+	}
+	printBatchStatuses(reports);
+	return canceled;
+}
+
+uint64 dispatchCancelGeneration() {
+	std::lock_guard<std::mutex> lock(dispatchMutex);
+	return cancelGeneration;
+}
+
+size_t dispatcherOutstanding() {
+	std::lock_guard<std::mutex> lock(dispatchMutex);
+	size_t outstanding = 0;
+	for(std::map<uint64, ServerQueue>::const_iterator it = servers.begin(); it != servers.end(); ++it) {
+		outstanding += it->second.queue.size() + it->second.inFlight.size();
+	}
+	return outstanding;
+}
+
+void dispatcherDrop(uint64 serverConnectionHandlerID) {
+	std::vector<uint64> dropped;
+	{
+		std::lock_guard<std::mutex> lock(dispatchMutex);
+		servers.erase(serverConnectionHandlerID);
+		for(std::map<uint64, Batch>::iterator it = batches.begin(); it != batches.end();) {
+			if(it->second.serverConnectionHandlerID == serverConnectionHandlerID) {
+				dropped.push_back(it->first);
+				rememberFinished(it->first, it->second.failed, 1);
+				batches.erase(it++);
+			} else {
+				++it;
+			}
+		}
+		batchDone.notify_all();
+	}
+
+	/* The timeline of a batch cut short by a disconnect is the interesting one */
+	for(size_t i = 0; i < dropped.size(); i++) {
+		traceFinish(dropped[i]);
+	}
+}
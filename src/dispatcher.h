@@ -0,0 +1,130 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "teamspeak/public_definitions.h"
+
+/*
+ * Paced request queue. Every server connection has its own token bucket whose rate is learned at runtime:
+ * until the first "client is flooding" error the rate doubles every second of acknowledged requests, after
+ * that each one raises it a little. A flood error halves it, pauses the connection and requeues the flooded
+ * request. Learned rates are remembered per virtual server for the
+ * rest of the session.
+ *
+ * Requests are grouped into batches. Each request carries its own return code, the answer in
+ * onServerErrorEvent is matched back to it, and once a closed batch has all its answers a summary with
+ * failures, throughput and latency is printed to the server tab.
+ */
+
+enum RequestVerb {
+	VERB_MOVE = 0,
+	VERB_KICK_FROM_CHANNEL,
+	VERB_KICK_FROM_SERVER,
+	VERB_SET_IS_TALKER,
+	VERB_DELETE_CHANNEL,
+	VERB_REQUEST_VARIABLES,  /* Asks for the properties of a client the server only sends on request, changes nothing */
+	VERB_LIST_GROUP_MEMBERS, /* Asks for the database IDs in a server group, changes nothing */
+	VERB_ADD_TO_GROUP,
+	VERB_REMOVE_FROM_GROUP,
+	VERB_SET_CHANNEL_GROUPS,  /* One command for many clients, see Request::entries */
+	VERB_LIST_CHANNEL_PERMISSIONS,  /* Asks for the permissions set on a channel, changes nothing */
+	VERB_ADD_CHANNEL_PERMISSIONS,   /* Sets many permissions of a channel in one command */
+	VERB_DELETE_CHANNEL_PERMISSIONS,
+	VERB_REQUEST_CONNECTION_INFO,   /* Asks for a client's address and connection statistics, changes nothing */
+	VERB_BAN_ADDRESS,               /* Bans Request::address for Request::seconds, nobody online is kicked by it */
+	VERB_BAN_CLIENT
+};
+
+struct Request;
+
+/* Told the final answer to a request, also a failure or a local refusal. Called without any dispatcher lock held. */
+typedef void (*RequestAnswered)(uint64 serverConnectionHandlerID, const struct Request& request, unsigned int error);
+
+/* Built with the batch and verb, everything else is zero until set by name */
+struct Request {
+	Request(uint64 batchID, enum RequestVerb verb) : batchID(batchID), verb(verb) {}
+
+	uint64 batchID;    /* 0 = not part of a batch */
+	enum RequestVerb verb;
+	anyID clientID = 0;    /* For group changes a client of the database ID, for address bans one on the address, it names the target in the journal */
+	uint64 channelID = 0;  /* Target channel for moves, the channel itself for deletes and permission changes */
+	int value = 0;         /* isTalker for VERB_SET_IS_TALKER, force for VERB_DELETE_CHANNEL */
+	int barrier = 0;       /* Only sent once everything queued before it was answered, e.g. kicking yourself */
+	uint64 groupID = 0;    /* Server group of group changes and member lists, channel group of VERB_SET_CHANNEL_GROUPS */
+	uint64 databaseID = 0; /* Target of group changes, the server addresses them by database ID */
+	std::vector<uint64> entries;  /* Array commands: channel ID, database ID pairs of VERB_SET_CHANNEL_GROUPS,
+	                                 permission ID, value pairs of VERB_ADD_CHANNEL_PERMISSIONS,
+	                                 permission IDs of VERB_DELETE_CHANNEL_PERMISSIONS */
+	std::string address;  /* IP of VERB_BAN_ADDRESS */
+	uint64 seconds = 0;   /* Duration of bans */
+	std::string reason;   /* Of bans and kicks from the server */
+	RequestAnswered onAnswered = NULL;  /* For whoever needs to know when the server has answered, e.g. sent the variables asked for */
+};
+
+void dispatcherStart();
+void dispatcherStop();
+
+/* Opens a batch, name is shown in its completion report */
+uint64 dispatchBeginBatch(uint64 serverConnectionHandlerID, const char* name);
+
+/* Like dispatchBeginBatch, but only reported if a request failed, for background work like the AFK sweeper */
+uint64 dispatchBeginQuietBatch(uint64 serverConnectionHandlerID, const char* name);
+
+/* No more requests will be added, the report is printed as soon as the last answer arrived. Empty batches are discarded. */
+void dispatchEndBatch(uint64 batchID);
+
+/* Closes a batch like dispatchEndBatch but drops what of it is still queued, for a job aborted midway. Returns the number dropped. */
+size_t dispatchCancelBatch(uint64 batchID);
+
+void dispatchRequest(uint64 serverConnectionHandlerID, const struct Request& request);
+
+/* Convenience wrappers building the matching Request */
+void dispatchClientMove(uint64 serverConnectionHandlerID, uint64 batchID, anyID clientID, uint64 newChannelID);
+void dispatchKickFromChannel(uint64 serverConnectionHandlerID, uint64 batchID, anyID clientID);
+void dispatchKickFromServer(uint64 serverConnectionHandlerID, uint64 batchID, anyID clientID, int barrier);
+void dispatchSetIsTalker(uint64 serverConnectionHandlerID, uint64 batchID, anyID clientID, int isTalker);
+void dispatchChannelDelete(uint64 serverConnectionHandlerID, uint64 batchID, uint64 channelID, int force);
+void dispatchRequestVariables(uint64 serverConnectionHandlerID, uint64 batchID, anyID clientID);
+void dispatchListGroupMembers(uint64 serverConnectionHandlerID, uint64 batchID, uint64 groupID);
+void dispatchAddToGroup(uint64 serverConnectionHandlerID, uint64 batchID, uint64 groupID, uint64 databaseID, anyID clientID);
+void dispatchRemoveFromGroup(uint64 serverConnectionHandlerID, uint64 batchID, uint64 groupID, uint64 databaseID, anyID clientID);
+void dispatchSetChannelGroups(uint64 serverConnectionHandlerID, uint64 batchID, uint64 channelGroupID, const std::vector<uint64>& entries);
+void dispatchListChannelPermissions(uint64 serverConnectionHandlerID, uint64 batchID, uint64 channelID);
+void dispatchAddChannelPermissions(uint64 serverConnectionHandlerID, uint64 batchID, uint64 channelID, const std::vector<uint64>& entries);
+void dispatchDeleteChannelPermissions(uint64 serverConnectionHandlerID, uint64 batchID, uint64 channelID, const std::vector<uint64>& entries);
+void dispatchRequestConnectionInfo(uint64 serverConnectionHandlerID, uint64 batchID, anyID clientID);
+void dispatchBanAddress(uint64 serverConnectionHandlerID, uint64 batchID, const std::string& address, anyID clientID, uint64 seconds, const std::string& reason);
+void dispatchBanClient(uint64 serverConnectionHandlerID, uint64 batchID, anyID clientID, uint64 seconds, const std::string& reason);
+
+/*
+ * Blocks until a closed batch got all its answers. Returns 0 if it was aborted instead: by a dispatcherCancelAll
+ * since generation was taken from dispatchCancelGeneration at the start of the job, because its connection was
+ * dropped or because the dispatcher stopped. failed, if not NULL, gets the number of requests that failed. Must
+ * not be called from the GUI thread or a clientlib callback.
+ */
+int dispatchWaitBatch(uint64 batchID, uint64 generation, size_t* failed);
+
+/* Returns 1 if returnCode was issued by the dispatcher, the answer is then accounted to its batch */
+int dispatcherOnServerError(uint64 serverConnectionHandlerID, unsigned int error, const char* returnCode);
+
+/* Requests queued or in flight on every connection, 0 once everything dispatched was answered */
+size_t dispatcherOutstanding();
+
+/* Abort: drops every request still queued on any connection, answers to requests in flight are still accounted. Returns the number dropped. */
+size_t dispatcherCancelAll();
+
+/* Bumped by every dispatcherCancelAll, a job that remembers it when starting learns whether it was aborted since */
+uint64 dispatchCancelGeneration();
+
+/* Discards everything queued, in flight or unfinished for a connection, called on disconnect. Waiters on its batches get 0. */
+void dispatcherDrop(uint64 serverConnectionHandlerID);
+
+#endif
@@ -0,0 +1,822 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_definitions.h"
+#include "teamspeak/public_rare_definitions.h"
+#include "ts3_functions.h"
+#include "globals.h"
+#include "ts3_buffer.h"
+#include "dispatcher.h"
+#include "client_columns.h"
+#include "filter.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FILTER_SSE2  /* Lane masks are packed with movemask */
+#endif
+
+#define FILTER_MAX_CODE 0xFFFF  /* Jump targets are 16 bit */
+
+enum TokenKind {
+	TOKEN_END = 0,
+	TOKEN_WORD,     /* Also numbers, durations and unquoted patterns */
+	TOKEN_STRING,   /* "quoted", may hold spaces */
+	TOKEN_COMPARE,
+	TOKEN_OPEN,
+	TOKEN_CLOSE,
+	TOKEN_NOT,      /* ! */
+	TOKEN_AND,      /* && */
+	TOKEN_OR        /* || */
+};
+
+struct Token {
+	enum TokenKind kind;
+	std::string text;
+	enum FilterCompare compare;
+};
+
+/************************** Compiler ***************************/
+
+/* Characters that end an unquoted word */
+static int isSeparator(char c) {
+	return isspace((unsigned char)c) || c == '(' || c == ')' || c == '<' || c == '>' || c == '=' || c == '!' || c == '~' || c == '"' || c == '&' || c == '|';
+}
+
+static int tokenize(const char* text, std::vector<struct Token>* tokens, std::string* error) {
+	for(const char* p = text; ; ) {
+		while(isspace((unsigned char)*p)) {
+			p++;
+		}
+		struct Token token;
+		token.compare = FCMP_EQ;
+		if(!*p) {
+			token.kind = TOKEN_END;
+			tokens->push_back(token);
+			return 1;
+		}
+
+		const char* start = p;
+		if(*p == '(' || *p == ')') {
+			token.kind = (*p == '(') ? TOKEN_OPEN : TOKEN_CLOSE;
+			p++;
+		} else if(p[0] == '&' && p[1] == '&') {
+			token.kind = TOKEN_AND;
+			p += 2;
+		} else if(p[0] == '|' && p[1] == '|') {
+			token.kind = TOKEN_OR;
+			p += 2;
+		} else if(*p == '<' || *p == '>' || *p == '=' || *p == '~' || (p[0] == '!' && p[1] == '=')) {
+			token.kind = TOKEN_COMPARE;
+			const char first = *p++;
+			const int orEqual = (*p == '=');
+			if(orEqual) {
+				p++;
+			}
+			switch(first) {
+				case '<': token.compare = orEqual ? FCMP_LE : FCMP_LT; break;
+				case '>': token.compare = orEqual ? FCMP_GE : FCMP_GT; break;
+				case '!': token.compare = FCMP_NE; break;
+				default:  token.compare = FCMP_EQ; break;  /* =, == and ~ */
+			}
+		} else if(*p == '!') {
+			token.kind = TOKEN_NOT;
+			p++;
+		} else if(*p == '"') {
+			const char* end = strchr(p + 1, '"');
+			if(!end) {
+				*error = "missing closing quote";
+				return 0;
+			}
+			token.kind = TOKEN_STRING;
+			token.text.assign(p + 1, end);
+			p = end + 1;
+		} else if(*p == '&' || *p == '|') {
+			*error = std::string("use && or || instead of ") + *p;
+			return 0;
+		} else {
+			while(*p && !isSeparator(*p)) {
+				p++;
+			}
+			token.kind = TOKEN_WORD;
+		}
+		if(token.kind != TOKEN_STRING) {
+			token.text.assign(start, p);  /* Operators keep their text for error messages */
+		}
+		tokens->push_back(token);
+	}
+}
+
+static std::string lower(const std::string& text) {
+	std::string result = text;
+	for(size_t i = 0; i < result.size(); i++) {
+		result[i] = (char)tolower((unsigned char)result[i]);
+	}
+	return result;
+}
+
+static int parseNumber(const std::string& text, uint64* value) {
+	if(text.empty() || !isdigit((unsigned char)text[0])) {
+		return 0;
+	}
+	char* end;
+	*value = strtoull(text.c_str(), &end, 10);
+	return *end == '\0';
+}
+
+int filterParseDuration(const std::string& text, uint64* milliseconds) {
+	*milliseconds = 0;
+	const char* p = text.c_str();
+	if(!isdigit((unsigned char)*p)) {
+		return 0;
+	}
+	while(*p) {
+		char* end;
+		const uint64 amount = strtoull(p, &end, 10);
+		if(end == p) {
+			return 0;
+		}
+		p = end;
+		uint64 unit = 1000;
+		if(!strncmp(p, "ms", 2)) {
+			unit = 1;
+			p += 2;
+		} else if(*p == 's') {
+			p++;
+		} else if(*p == 'm') {
+			unit = 60 * 1000;
+			p++;
+		} else if(*p == 'h') {
+			unit = 60 * 60 * 1000;
+			p++;
+		} else if(*p == 'd') {
+			unit = 24 * 60 * 60 * 1000;
+			p++;
+		} else if(*p) {
+			return 0;
+		}
+		*milliseconds += amount * unit;
+	}
+	return 1;
+}
+
+std::string filterFormatDuration(uint64 milliseconds) {
+	const uint64 seconds = milliseconds / 1000;
+	std::string text;
+	if(seconds >= 86400) {
+		text += std::to_string(seconds / 86400) + "d";
+	}
+	if(seconds % 86400 >= 3600) {
+		text += std::to_string(seconds % 86400 / 3600) + "h";
+	}
+	if(seconds % 3600 >= 60) {
+		text += std::to_string(seconds % 3600 / 60) + "m";
+	}
+	if(seconds % 60 || text.empty()) {
+		text += std::to_string(seconds % 60) + "s";
+	}
+	return text;
+}
+
+struct Compiler {
+	std::vector<struct Token> tokens;
+	size_t next;
+	struct ClientFilter* filter;
+	std::string error;
+
+	const struct Token& peek() const {
+		return tokens[next];
+	}
+
+	const struct Token& take() {
+		return tokens[next < tokens.size() - 1 ? next++ : next];
+	}
+
+	bool peekWord(const char* word) const {
+		return peek().kind == TOKEN_WORD && lower(peek().text) == word;
+	}
+
+	size_t emit(enum FilterOp op, enum FilterCompare compare = FCMP_EQ, unsigned short operand = 0, uint64 value = 0) {
+		struct FilterInstruction instruction;
+		instruction.op = (unsigned char)op;
+		instruction.compare = (unsigned char)compare;
+		instruction.operand = operand;
+		instruction.value = value;
+		filter->code.push_back(instruction);
+		return filter->code.size() - 1;
+	}
+
+	void patchJumps(const std::vector<size_t>& jumps) {
+		for(size_t i = 0; i < jumps.size(); i++) {
+			filter->code[jumps[i]].operand = (unsigned short)filter->code.size();
+		}
+	}
+
+	int fail(const std::string& message) {
+		if(error.empty()) {
+			error = message;
+		}
+		return 0;
+	}
+
+	/* An optional =, != or ~ before a pattern or ID. Returns 1 if the test has to be negated, -1 for other comparisons. */
+	int takeEquality(const std::string& property) {
+		if(peek().kind != TOKEN_COMPARE) {
+			return 0;
+		}
+		const enum FilterCompare compare = take().compare;
+		if(compare != FCMP_EQ && compare != FCMP_NE) {
+			fail("only = and != work for " + property);
+			return -1;
+		}
+		return compare == FCMP_NE;
+	}
+
+	int takeCompare(const std::string& property, enum FilterCompare* compare) {
+		if(peek().kind != TOKEN_COMPARE) {
+			return fail(property + " needs a comparison like " + property + " > 10");
+		}
+		*compare = take().compare;
+		return 1;
+	}
+
+	int parsePattern(enum FilterOp op, const std::string& property) {
+		const int negate = takeEquality(property);
+		if(negate < 0) {
+			return 0;
+		}
+		const struct Token& pattern = take();
+		if(pattern.kind != TOKEN_WORD && pattern.kind != TOKEN_STRING) {
+			return fail(property + " needs a pattern");
+		}
+		filter->patterns.push_back(lower(pattern.text));
+		emit(op, FCMP_EQ, (unsigned short)(filter->patterns.size() - 1));
+		if(negate) {
+			emit(FOP_NOT);
+		}
+		if(op != FOP_NAME) {
+			filter->needsRequest = 1;
+		}
+		return 1;
+	}
+
+	int parseID(enum FilterOp op, const std::string& property, const char* what) {
+		const int negate = takeEquality(property);
+		if(negate < 0) {
+			return 0;
+		}
+		uint64 id;
+		if(!parseNumber(take().text, &id) || !id) {
+			return fail(property + " needs " + what);
+		}
+		emit(op, FCMP_EQ, 0, id);
+		if(negate) {
+			emit(FOP_NOT);
+		}
+		return 1;
+	}
+
+	int parsePredicate() {
+		const struct Token& token = take();
+		if(token.kind != TOKEN_WORD) {
+			return fail(token.kind == TOKEN_END ? "the filter ends too early" : "expected a condition before " + token.text);
+		}
+		const std::string word = lower(token.text);
+		enum FilterCompare compare;
+		uint64 value;
+
+		if(word == "everyone" || word == "all") {
+			emit(FOP_TRUE);
+		} else if(word == "name" || word == "nick" || word == "nickname") {
+			return parsePattern(FOP_NAME, word);
+		} else if(word == "platform") {
+			return parsePattern(FOP_PLATFORM, word);
+		} else if(word == "version") {
+			return parsePattern(FOP_VERSION, word);
+		} else if(word == "group" || word == "servergroup") {
+			return parseID(FOP_SERVER_GROUP, word, "a group ID");
+		} else if(word == "channelgroup") {
+			return parseID(FOP_CHANNEL_GROUP, word, "a group ID");
+		} else if(word == "channel") {
+			return parseID(FOP_CHANNEL, word, "a channel ID");
+		} else if(word == "here") {
+			emit(FOP_CHANNEL);
+		} else if(word == "idle") {
+			if(!takeCompare(word, &compare) || !filterParseDuration(take().text, &value)) {
+				return fail("idle needs a duration like idle > 2h");
+			}
+			emit(FOP_IDLE, compare, 0, value);
+			filter->needsRequest = 1;
+		} else if(word == "talkpower") {
+			if(!takeCompare(word, &compare) || !parseNumber(take().text, &value)) {
+				return fail("talkpower needs a number like talkpower >= 50");
+			}
+			emit(FOP_TALK_POWER, compare, 0, value);
+		} else if(word == "dbid") {
+			if(!takeCompare(word, &compare) || !parseNumber(take().text, &value)) {
+				return fail("dbid needs a number like dbid < 100");
+			}
+			emit(FOP_DATABASE_ID, compare, 0, value);
+		} else if(word == "away") {
+			emit(FOP_AWAY);
+		} else if(word == "muted") {
+			emit(FOP_INPUT_MUTED);
+		} else if(word == "deaf") {
+			emit(FOP_OUTPUT_MUTED);
+		} else if(word == "talker") {
+			emit(FOP_TALKER);
+		} else if(word == "recording") {
+			emit(FOP_RECORDING);
+		} else {
+			return fail("unknown condition " + token.text);
+		}
+		return 1;
+	}
+
+	int parseUnary() {
+		if(peek().kind == TOKEN_NOT || peekWord("not") || peekWord("without")) {
+			take();
+			if(!parseUnary()) {
+				return 0;
+			}
+			emit(FOP_NOT);
+			return 1;
+		}
+		if(peekWord("with") || peekWord("in")) {
+			take();
+			return parseUnary();
+		}
+		if(peek().kind == TOKEN_OPEN) {
+			take();
+			if(!parseOr()) {
+				return 0;
+			}
+			if(take().kind != TOKEN_CLOSE) {
+				return fail("missing )");
+			}
+			return 1;
+		}
+		return parsePredicate();
+	}
+
+	/* The next token starts another condition of an and-chain */
+	bool continuesAnd() const {
+		const enum TokenKind kind = peek().kind;
+		return kind != TOKEN_END && kind != TOKEN_CLOSE && kind != TOKEN_OR && !peekWord("or");
+	}
+
+	int parseAnd() {
+		if(!parseUnary()) {
+			return 0;
+		}
+		std::vector<size_t> jumps;
+		while(continuesAnd()) {
+			if(peek().kind == TOKEN_AND || peekWord("and")) {
+				take();
+			}
+			jumps.push_back(emit(FOP_JUMP_IF_FALSE));
+			if(!parseUnary()) {
+				return 0;
+			}
+		}
+		patchJumps(jumps);
+		return 1;
+	}
+
+	int parseOr() {
+		if(!parseAnd()) {
+			return 0;
+		}
+		std::vector<size_t> jumps;
+		while(peek().kind == TOKEN_OR || peekWord("or")) {
+			take();
+			jumps.push_back(emit(FOP_JUMP_IF_TRUE));
+			if(!parseAnd()) {
+				return 0;
+			}
+		}
+		patchJumps(jumps);
+		return 1;
+	}
+};
+
+int filterCompile(const char* text, struct ClientFilter* filter, std::string* error) {
+	filter->text = text;
+	filter->code.clear();
+	filter->patterns.clear();
+	filter->needsRequest = 0;
+
+	struct Compiler compiler;
+	compiler.next = 0;
+	compiler.filter = filter;
+	if(!tokenize(text, &compiler.tokens, error)) {
+		return 0;
+	}
+
+	/* Mass kicking by leaving the filter out by accident is too easy, everyone has to be asked for */
+	if(compiler.peek().kind == TOKEN_END) {
+		*error = "which clients? Add a filter, or everyone for all of them";
+		return 0;
+	}
+	if(!compiler.parseOr()) {
+		*error = compiler.error;
+		return 0;
+	}
+	if(compiler.peek().kind != TOKEN_END) {
+		*error = "unexpected " + compiler.peek().text;
+		return 0;
+	}
+	if(filter->code.size() > FILTER_MAX_CODE) {
+		*error = "the filter is too long";
+		return 0;
+	}
+	return 1;
+}
+
+/************************** Preparation ***************************/
+
+/* Idle time, platform and version of clients, the answers arrive as onUpdateClientEvent */
+static int requestDetails(const struct Roster& roster, const std::vector<anyID>& clients, uint64 cancelGeneration) {
+	const std::chrono::steady_clock::time_point asked = std::chrono::steady_clock::now();
+	const uint64 batchID = dispatchBeginBatch(roster.serverConnectionHandlerID, "Ask the server for client details");
+	for(size_t i = 0; i < clients.size(); i++) {
+		dispatchRequestVariables(roster.serverConnectionHandlerID, batchID, clients[i]);
+	}
+	dispatchEndBatch(batchID);
+	size_t failed;
+	if(!dispatchWaitBatch(batchID, cancelGeneration, &failed)) {
+		return 0;
+	}
+	if(!failed) {
+		clientColumnsDetailsAsked(roster.serverConnectionHandlerID, clients, asked);
+	}
+	return 1;
+}
+
+/************************** Kernels ***************************/
+
+typedef std::vector<uint64> Bitset;  /* One bit per row of the columns */
+
+/* 64 lanes of 0 or 0xFF into one word, lane i is bit i */
+static uint64 packLanes(const unsigned char* lanes) {
+	uint64 word = 0;
+#ifdef FILTER_SSE2
+	for(int i = 0; i < 4; i++) {
+		const __m128i chunk = _mm_loadu_si128((const __m128i*)(lanes + 16 * i));
+		word |= (uint64)(unsigned int)_mm_movemask_epi8(chunk) << (16 * i);
+	}
+#else
+	for(int i = 0; i < 64; i++) {
+		word |= (uint64)(lanes[i] & 1) << i;
+	}
+#endif
+	return word;
+}
+
+/*
+ * Tests every row of a column into out. The test is inlined into a branch-free loop writing one byte per
+ * row, which the compiler turns into vector compares, and every 64 bytes are packed into one word.
+ */
+template<typename T, typename Test>
+static void scanColumn(const T* column, size_t rows, Test test, uint64* out) {
+	unsigned char lanes[64];
+	for(size_t begin = 0; begin < rows; begin += 64) {
+		const size_t count = std::min<size_t>(64, rows - begin);
+		const T* values = column + begin;
+		for(size_t i = 0; i < count; i++) {
+			lanes[i] = (unsigned char)(0 - (unsigned char)test(values[i]));
+		}
+		for(size_t i = count; i < 64; i++) {
+			lanes[i] = 0;
+		}
+		out[begin / 64] = packLanes(lanes);
+	}
+}
+
+/* The comparison is picked once per column, not once per row */
+template<typename T>
+static void compareColumn(const std::vector<T>& column, enum FilterCompare compare, T value, uint64* out) {
+	const T* data = column.data();
+	const size_t rows = column.size();
+	switch(compare) {
+		case FCMP_EQ: scanColumn(data, rows, [value](T x) { return x == value; }, out); break;
+		case FCMP_NE: scanColumn(data, rows, [value](T x) { return x != value; }, out); break;
+		case FCMP_LT: scanColumn(data, rows, [value](T x) { return x < value; }, out); break;
+		case FCMP_LE: scanColumn(data, rows, [value](T x) { return x <= value; }, out); break;
+		case FCMP_GT: scanColumn(data, rows, [value](T x) { return x > value; }, out); break;
+		case FCMP_GE: scanColumn(data, rows, [value](T x) { return x >= value; }, out); break;
+	}
+}
+
+static void flagColumn(const std::vector<unsigned char>& column, uint64* out) {
+	scanColumn(column.data(), column.size(), [](unsigned char x) { return x != 0; }, out);
+}
+
+/* Case-insensitive, pattern is lower case already. Without wildcards it matches anywhere in the text. */
+static bool globMatch(const std::string& pattern, const std::string& text) {
+	if(pattern.find_first_of("*?") == std::string::npos) {
+		return text.find(pattern) != std::string::npos;
+	}
+	size_t p = 0, t = 0;
+	size_t star = std::string::npos, resume = 0;
+	while(t < text.size()) {
+		if(p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+			p++;
+			t++;
+		} else if(p < pattern.size() && pattern[p] == '*') {
+			star = p++;
+			resume = t;
+		} else if(star != std::string::npos) {
+			p = star + 1;
+			t = ++resume;
+		} else {
+			return false;
+		}
+	}
+	while(p < pattern.size() && pattern[p] == '*') {
+		p++;
+	}
+	return p == pattern.size();
+}
+
+/* Text is not kept in columns, it costs a client lib call per row, so only the undecided rows are asked */
+static void matchText(const struct Roster& roster, size_t flag, const std::string& pattern, const Bitset& active, uint64* out) {
+	for(size_t w = 0; w < active.size(); w++) {
+		out[w] = 0;
+		for(uint64 pending = active[w]; pending; pending &= pending - 1) {
+			size_t bit = 0;
+			while(!((pending >> bit) & 1)) {
+				bit++;
+			}
+			Ts3Buffer<char> text;
+			if(ts3Functions.getClientVariableAsString(roster.serverConnectionHandlerID, roster.clients[w * 64 + bit], flag, text.out()) == ERROR_ok && globMatch(pattern, lower(text.get()))) {
+				out[w] |= (uint64)1 << bit;
+			}
+		}
+	}
+}
+
+/************************** Evaluation ***************************/
+
+/*
+ * Rows a jump took out of the program, they rejoin at target with the result they had. Undecided rows are
+ * never taken out, but the result they could have had at the jump is added to theirs at target.
+ */
+struct ParkedRows {
+	size_t target;
+	Bitset rows;
+	Bitset values;
+	Bitset couldBeFalse;  /* Undecided rows that went on past a jump if false */
+	Bitset couldBeTrue;   /* Undecided rows that went on past a jump if true */
+};
+
+static bool anySet(const Bitset& bits) {
+	for(size_t w = 0; w < bits.size(); w++) {
+		if(bits[w]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Conditions on properties the server only sends on request */
+static bool isRequestedOnly(unsigned char op) {
+	return op == FOP_IDLE || op == FOP_PLATFORM || op == FOP_VERSION;
+}
+
+/*
+ * Runs the program for the given rows at once. A row is active until a jump decides it, the jump parks it and
+ * the rows of every jump to the same target are merged back there. Once no row is active the program skips
+ * straight to the nearest target.
+ *
+ * Requested-only conditions are only evaluated for the known rows, for the others they are undecided and so
+ * is a row's result unless the rest of the filter settles it, e.g. "group 8 and idle > 1h" for a row not in
+ * group 8. Such rows end up in undecided, result holds the others. Bits of rows not given are left undefined.
+ */
+static void evaluate(const struct ClientFilter& filter, const struct Roster& roster, const struct ClientColumns& columns, const Bitset& rows, const Bitset& known, Bitset* result, Bitset* undecided) {
+	const size_t words = COLUMN_WORDS(columns.rows);
+	const uint64 tail = (columns.rows % 64) ? ((uint64)1 << (columns.rows % 64)) - 1 : ~(uint64)0;
+	Bitset& current = *result;
+	current.assign(words, 0);
+	Bitset& unknown = *undecided;
+	unknown.assign(words, 0);
+	Bitset active(rows);
+	Bitset activeKnown(words);
+	std::vector<struct ParkedRows> parked;  /* Targets descending, the nearest last */
+
+	const struct FilterInstruction* code = filter.code.data();
+	const size_t size = filter.code.size();
+	for(size_t pc = 0; ; ) {
+		while(!parked.empty() && parked.back().target == pc) {
+			const struct ParkedRows& back = parked.back();
+			for(size_t w = 0; w < words; w++) {
+				current[w] = (current[w] & ~back.rows[w]) | back.values[w];
+				unknown[w] &= ~back.rows[w];
+				active[w] |= back.rows[w];
+				/* Whatever the row came to here, it could also have been what it was at the jump */
+				const uint64 canBeTrue = unknown[w] | current[w] | back.couldBeTrue[w];
+				const uint64 canBeFalse = unknown[w] | ~current[w] | back.couldBeFalse[w];
+				unknown[w] = canBeTrue & canBeFalse;
+				current[w] = canBeTrue & ~canBeFalse;
+			}
+			parked.pop_back();
+		}
+		if(pc >= size) {
+			break;
+		}
+
+		const struct FilterInstruction& instruction = code[pc++];
+		const enum FilterCompare compare = (enum FilterCompare)instruction.compare;
+		if(isRequestedOnly(instruction.op)) {
+			for(size_t w = 0; w < words; w++) {
+				unknown[w] = ~known[w];
+				activeKnown[w] = active[w] & known[w];
+			}
+		} else if(instruction.op != FOP_NOT && instruction.op != FOP_JUMP_IF_FALSE && instruction.op != FOP_JUMP_IF_TRUE) {
+			unknown.assign(words, 0);
+		}
+		switch(instruction.op) {
+			case FOP_TRUE:
+				current.assign(words, ~(uint64)0);
+				if(words) {
+					current[words - 1] = tail;
+				}
+				break;
+			case FOP_NAME:
+				matchText(roster, CLIENT_NICKNAME, filter.patterns[instruction.operand], active, current.data());
+				break;
+			case FOP_PLATFORM:
+				matchText(roster, CLIENT_PLATFORM, filter.patterns[instruction.operand], activeKnown, current.data());
+				break;
+			case FOP_VERSION:
+				matchText(roster, CLIENT_VERSION, filter.patterns[instruction.operand], activeKnown, current.data());
+				break;
+			case FOP_SERVER_GROUP: {
+				size_t g = 0;
+				while(g < columns.groupIDs.size() && columns.groupIDs[g] != instruction.value) {
+					g++;
+				}
+				if(g < columns.groupIDs.size()) {
+					current = columns.groupRows[g];
+				} else {
+					current.assign(words, 0);
+				}
+				break;
+			}
+			case FOP_CHANNEL_GROUP:
+				compareColumn<uint64>(columns.channelGroup, FCMP_EQ, instruction.value, current.data());
+				break;
+			case FOP_CHANNEL: {
+				/* The roster is ordered by channel, so a channel is one run of rows */
+				current.assign(words, 0);
+				const int index = roster.findChannel(instruction.value ? instruction.value : roster.myChannel);
+				if(index >= 0) {
+					for(size_t i = roster.offsets[index]; i < roster.offsets[index + 1]; i++) {
+						current[i / 64] |= (uint64)1 << (i % 64);
+					}
+				}
+				break;
+			}
+			case FOP_IDLE:
+				compareColumn<uint64>(columns.idle, compare, instruction.value, current.data());
+				break;
+			case FOP_TALK_POWER:
+				compareColumn<int>(columns.talkPower, compare, (int)std::min<uint64>(instruction.value, INT_MAX), current.data());
+				break;
+			case FOP_DATABASE_ID:
+				compareColumn<uint64>(columns.databaseID, compare, instruction.value, current.data());
+				break;
+			case FOP_AWAY:
+				flagColumn(columns.away, current.data());
+				break;
+			case FOP_INPUT_MUTED:
+				flagColumn(columns.inputMuted, current.data());
+				break;
+			case FOP_OUTPUT_MUTED:
+				flagColumn(columns.outputMuted, current.data());
+				break;
+			case FOP_TALKER:
+				flagColumn(columns.talker, current.data());
+				break;
+			case FOP_RECORDING:
+				flagColumn(columns.recording, current.data());
+				break;
+			case FOP_NOT:
+				for(size_t w = 0; w < words; w++) {
+					current[w] = ~current[w];
+				}
+				if(words) {
+					current[words - 1] &= tail;
+				}
+				break;
+			case FOP_JUMP_IF_FALSE:
+			case FOP_JUMP_IF_TRUE: {
+				const uint64 decided = (instruction.op == FOP_JUMP_IF_TRUE) ? 0 : ~(uint64)0;
+				Bitset leaving(words), going(words);
+				for(size_t w = 0; w < words; w++) {
+					leaving[w] = active[w] & ~unknown[w] & (current[w] ^ decided);
+					going[w] = active[w] & unknown[w];
+				}
+				if(!anySet(leaving) && !anySet(going)) {
+					break;
+				}
+				size_t p = parked.size();
+				while(p > 0 && parked[p - 1].target < instruction.operand) {
+					p--;
+				}
+				if(p == 0 || parked[p - 1].target != instruction.operand) {
+					struct ParkedRows entry;
+					entry.target = instruction.operand;
+					entry.rows.assign(words, 0);
+					entry.values.assign(words, 0);
+					entry.couldBeFalse.assign(words, 0);
+					entry.couldBeTrue.assign(words, 0);
+					parked.insert(parked.begin() + p, entry);
+					p++;
+				}
+				struct ParkedRows& entry = parked[p - 1];
+				Bitset& could = (instruction.op == FOP_JUMP_IF_TRUE) ? entry.couldBeTrue : entry.couldBeFalse;
+				for(size_t w = 0; w < words; w++) {
+					entry.rows[w] |= leaving[w];
+					entry.values[w] |= leaving[w] & current[w];
+					could[w] |= going[w];
+					active[w] &= ~leaving[w];
+				}
+				if(!anySet(active)) {
+					pc = parked.back().target;
+				}
+				break;
+			}
+		}
+	}
+	for(size_t w = 0; w < words; w++) {
+		unknown[w] &= rows[w];
+	}
+}
+
+int filterSelect(const struct ClientFilter& filter, const struct Roster& roster, uint64 cancelGeneration, struct ClientSelection* selection) {
+	struct ClientColumns columns;
+	if(clientColumnsSnapshot(roster, &columns) != ERROR_ok) {
+		return 0;
+	}
+	const size_t words = COLUMN_WORDS(columns.rows);
+	Bitset all(words, ~(uint64)0);
+	if(words && columns.rows % 64) {
+		all[words - 1] = ((uint64)1 << (columns.rows % 64)) - 1;
+	}
+
+	/* First with what is known: your own client and details asked for lately, or everything if none are needed */
+	Bitset known(all);
+	if(filter.needsRequest) {
+		flagColumn(columns.detailsFresh, known.data());
+		for(size_t i = 0; i < columns.rows; i++) {
+			if(roster.clients[i] == roster.myID) {
+				known[i / 64] |= (uint64)1 << (i % 64);
+			}
+		}
+	}
+	Bitset matches, undecided;
+	evaluate(filter, roster, columns, all, known, &matches, &undecided);
+
+	/* Only the rows the rest of the filter did not settle are asked for and run again */
+	if(anySet(undecided)) {
+		std::vector<anyID> ask;
+		for(size_t i = 0; i < columns.rows; i++) {
+			if((undecided[i / 64] >> (i % 64)) & 1) {
+				ask.push_back(roster.clients[i]);
+			}
+		}
+		if(!requestDetails(roster, ask, cancelGeneration)) {
+			return 0;
+		}
+		struct ClientColumns updated;
+		if(clientColumnsSnapshot(roster, &updated) != ERROR_ok) {
+			return 0;
+		}
+		Bitset rerun, stillUndecided;
+		evaluate(filter, roster, updated, undecided, all, &rerun, &stillUndecided);
+		for(size_t w = 0; w < words; w++) {
+			matches[w] = (matches[w] & ~undecided[w]) | (rerun[w] & undecided[w]);
+		}
+	}
+
+	selection->bits.assign(65536 / 64, 0);
+	for(size_t i = 0; i < columns.rows; i++) {
+		if((matches[i / 64] >> (i % 64)) & 1) {
+			selection->bits[roster.clients[i] / 64] |= (uint64)1 << (roster.clients[i] % 64);
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,105 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "teamspeak/public_definitions.h"
+#include "roster.h"
+
+/*
+ * Client filters for the chat commands, e.g. "idle > 2h without group 8 and not name Admin*". A filter is
+ * compiled once into a short bytecode program. The program runs once for the whole roster, not once per
+ * client: every condition on a numeric or flag property is one loop over a column of the client column store
+ * into a bitset, "and", "or" and "not" work on whole bitsets. Short-circuit jumps park the rows they decided,
+ * so text conditions, which still need a client lib call per client, only look at the rows left undecided.
+ *
+ *   name|platform|version [=|!=|~] PATTERN   * and ? wildcards, without them the pattern matches anywhere
+ *   group|channelgroup [=|!=] ID             server group or channel group by ID
+ *   channel [=|!=] ID, here                  in a channel by ID resp. in your channel
+ *   idle OP DURATION                         e.g. "idle > 2h", units ms, s, m, h, d, seconds without one
+ *   talkpower|dbid OP NUMBER                 OP is one of < <= > >= = !=
+ *   away, muted, deaf, talker, recording     microphone muted, speakers muted
+ *   not|!|without X, with X, ( ... ), everyone
+ *
+ * Idle time, platform and version of other clients are only known after asking the server for them, see
+ * filterSelect.
+ */
+
+enum FilterOp {
+	FOP_TRUE = 0,
+	FOP_NAME,
+	FOP_PLATFORM,
+	FOP_VERSION,
+	FOP_SERVER_GROUP,
+	FOP_CHANNEL_GROUP,
+	FOP_CHANNEL,        /* value 0 = your channel */
+	FOP_IDLE,
+	FOP_TALK_POWER,
+	FOP_DATABASE_ID,
+	FOP_AWAY,
+	FOP_INPUT_MUTED,
+	FOP_OUTPUT_MUTED,
+	FOP_TALKER,
+	FOP_RECORDING,
+	FOP_NOT,
+	FOP_JUMP_IF_FALSE,  /* Leaves the result as it is, that is the value of the whole and/or chain */
+	FOP_JUMP_IF_TRUE
+};
+
+enum FilterCompare {
+	FCMP_EQ = 0,
+	FCMP_NE,
+	FCMP_LT,
+	FCMP_LE,
+	FCMP_GT,
+	FCMP_GE
+};
+
+struct FilterInstruction {
+	unsigned char op;        /* enum FilterOp */
+	unsigned char compare;   /* enum FilterCompare */
+	unsigned short operand;  /* Pattern index or jump target */
+	uint64 value;            /* Group ID, channel ID, milliseconds, talk power or database ID */
+};
+
+struct ClientFilter {
+	std::string text;                     /* As typed, for the batch report */
+	std::vector<struct FilterInstruction> code;
+	std::vector<std::string> patterns;    /* Lower case */
+	int needsRequest;                     /* Reads properties the server only sends on request */
+};
+
+/* "90", "90s", "2h", "1h30m", "500ms" into milliseconds, plain numbers are seconds. Returns 0 if it is none. */
+int filterParseDuration(const std::string& text, uint64* milliseconds);
+
+/* "2d1h30m" for messages, the way filterParseDuration reads it back */
+std::string filterFormatDuration(uint64 milliseconds);
+
+/* Returns 0 and describes the problem in error if text is not a valid filter */
+int filterCompile(const char* text, struct ClientFilter* filter, std::string* error);
+
+/* The clients a filter picked, one bit per client ID */
+struct ClientSelection {
+	std::vector<uint64> bits;
+
+	bool has(anyID clientID) const {
+		return (bits[clientID / 64] >> (clientID % 64)) & 1;
+	}
+};
+
+/*
+ * Picks the clients of roster matching filter. Filters on requested-only properties are first run with what
+ * is known, then the server is asked for the details of the clients whose result still depends on them and
+ * were not asked for lately, paced and reported like any batch. Returns 0 if that was aborted since
+ * cancelGeneration or the connection dropped, the action must not go on then. Runs on the worker thread.
+ */
+int filterSelect(const struct ClientFilter& filter, const struct Roster& roster, uint64 cancelGeneration, struct ClientSelection* selection);
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef GLOBALS_H
+#define GLOBALS_H
+
+#include "teamspeak/public_definitions.h"
+#include "ts3_functions.h"
+
+#define RETURNCODE_BUFSIZE 128
+#define PATH_BUFSIZE 512
+
+/* Shared between plugin.cpp and the helper modules, both are set up by the client before any menu can fire */
+extern struct TS3Functions ts3Functions;
+extern char* pluginID;
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <stdio.h>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_definitions.h"
+#include "ts3_functions.h"
+#include "globals.h"
+#include "ts3_buffer.h"
+#include "roster_cache.h"
+#include "dispatcher.h"
+#include "subscriptions.h"
+#include "worker.h"
+#include "hotkeys.h"
+
+struct HotkeyPlan {
+	int valid;
+	anyID myID;
+	uint64 myChannel;
+	uint64 defaultChannel;  /* 0 until looked up */
+	std::vector<anyID> others;  /* Everyone in myChannel but yourself */
+};
+
+static std::mutex planMutex;
+static std::map<uint64, HotkeyPlan> plans;
+
+static uint64 findDefaultChannel(uint64 serverConnectionHandlerID) {
+	Ts3Buffer<uint64> channelList;
+	if(ts3Functions.getChannelList(serverConnectionHandlerID, channelList.out()) != ERROR_ok) {
+		return 0;
+	}
+	for(size_t c = 0; c < channelList.size(); c++) {
+		int isDefault;
+		if(ts3Functions.getChannelVariableAsInt(serverConnectionHandlerID, channelList[c], CHANNEL_FLAG_DEFAULT, &isDefault) == ERROR_ok && isDefault) {
+			return channelList[c];
+		}
+	}
+	return 0;
+}
+
+/* Caller holds planMutex */
+static void rebuildPlan(uint64 serverConnectionHandlerID, HotkeyPlan& plan) {
+	plan.valid = 0;
+	plan.others.clear();
+	if(rosterCacheSelf(serverConnectionHandlerID, &plan.myID, &plan.myChannel) != ERROR_ok) {
+		return;
+	}
+	if(rosterCacheChannelMembers(serverConnectionHandlerID, plan.myChannel, &plan.others) != ERROR_ok) {
+		return;
+	}
+	for(size_t c = 0; c < plan.others.size(); c++) {
+		if(plan.others[c] == plan.myID) {
+			plan.others[c] = plan.others.back();
+			plan.others.pop_back();
+			break;
+		}
+	}
+	plan.valid = 1;
+}
+
+/* Caller holds planMutex */
+static HotkeyPlan& warmPlan(uint64 serverConnectionHandlerID) {
+	HotkeyPlan& plan = plans[serverConnectionHandlerID];
+	if(!plan.valid) {
+		rebuildPlan(serverConnectionHandlerID, plan);
+	}
+	if(!plan.defaultChannel) {
+		plan.defaultChannel = findDefaultChannel(serverConnectionHandlerID);
+	}
+	return plan;
+}
+
+void hotkeyEvacuateChannel(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(planMutex);
+	const HotkeyPlan& plan = warmPlan(serverConnectionHandlerID);
+	if(!plan.valid || !plan.defaultChannel || plan.myChannel == plan.defaultChannel) {
+		return;  /* Nowhere to evacuate to */
+	}
+
+	const uint64 batch = dispatchBeginBatch(serverConnectionHandlerID, "Evacuate channel");
+	for(size_t c = 0; c < plan.others.size(); c++) {
+		dispatchClientMove(serverConnectionHandlerID, batch, plan.others[c], plan.defaultChannel);
+	}
+	dispatchEndBatch(batch);
+}
+
+void hotkeyKickChannel(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(planMutex);
+	const HotkeyPlan& plan = warmPlan(serverConnectionHandlerID);
+	if(!plan.valid) {
+		return;
+	}
+
+	const uint64 batch = dispatchBeginBatch(serverConnectionHandlerID, "Kick channel");
+	for(size_t c = 0; c < plan.others.size(); c++) {
+		dispatchKickFromChannel(serverConnectionHandlerID, batch, plan.others[c]);
+	}
+	dispatchEndBatch(batch);
+}
+
+void hotkeyAbort() {
+	const size_t jobs = workerCancel();
+	const size_t requests = dispatcherCancelAll();
+	subscriptionsOnCancel();
+	printf("PLUGIN: abort: dropped %u jobs and %u requests\n", (unsigned int)jobs, (unsigned int)requests);
+}
+
+void hotkeysWarm(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(planMutex);
+	warmPlan(serverConnectionHandlerID);
+}
+
+void hotkeysOnClientMoved(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID) {
+	std::lock_guard<std::mutex> lock(planMutex);
+	std::map<uint64, HotkeyPlan>::iterator it = plans.find(serverConnectionHandlerID);
+	if(it == plans.end() || !it->second.valid) {
+		return;  /* Built on first keypress */
+	}
+
+	HotkeyPlan& plan = it->second;
+	if(clientID == plan.myID || oldChannelID == plan.myChannel || newChannelID == plan.myChannel) {
+		rebuildPlan(serverConnectionHandlerID, plan);
+	}
+}
+
+void hotkeysOnChannelsChanged(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(planMutex);
+	std::map<uint64, HotkeyPlan>::iterator it = plans.find(serverConnectionHandlerID);
+	if(it != plans.end()) {
+		it->second.defaultChannel = 0;
+	}
+}
+
+void hotkeysDrop(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(planMutex);
+	plans.erase(serverConnectionHandlerID);
+}
+
+void hotkeysClear() {
+	std::lock_guard<std::mutex> lock(planMutex);
+	plans.clear();
+}
@@ -0,0 +1,33 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef HOTKEYS_H
+#define HOTKEYS_H
+
+#include "teamspeak/public_definitions.h"
+
+/*
+ * Hotkey actions for emergencies. The targets of the channel hotkeys (everyone in your channel but you)
+ * are kept as a plan per connection which is rebuilt from the roster cache whenever a move touches your
+ * channel, so a keypress goes straight to the dispatcher.
+ */
+
+#define HOTKEY_EVACUATE_CHANNEL "evacuate_channel"
+#define HOTKEY_KICK_CHANNEL     "kick_channel"
+#define HOTKEY_ABORT            "abort"
+
+void hotkeyEvacuateChannel(uint64 serverConnectionHandlerID);
+void hotkeyKickChannel(uint64 serverConnectionHandlerID);
+void hotkeyAbort();
+
+/* Plan maintenance, called from the clientlib callbacks after the roster cache was updated */
+void hotkeysWarm(uint64 serverConnectionHandlerID);
+void hotkeysOnClientMoved(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID);
+void hotkeysOnChannelsChanged(uint64 serverConnectionHandlerID);
+void hotkeysDrop(uint64 serverConnectionHandlerID);
+void hotkeysClear();
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include "ts3_functions.h"
+#include "globals.h"
+#include "journal.h"
+
+static_assert(sizeof(struct JournalHeader) == 256, "journal header layout changed");
+static_assert(sizeof(struct JournalRecord) == 256, "journal record layout changed");
+
+#define JOURNAL_BYTES (sizeof(struct JournalHeader) + (size_t)JOURNAL_CAPACITY * sizeof(struct JournalRecord))
+
+static char* mapping = NULL;
+static std::atomic<struct JournalRecord*> records(NULL);  /* NULL while closed, writers check it first */
+static std::atomic<uint64> lastSequence(0);
+
+#ifdef _WIN32
+static HANDLE file = INVALID_HANDLE_VALUE;
+static HANDLE fileMapping = NULL;
+
+/* Opens or creates the file at its full size, a new file reads as zeros */
+static char* mapFile(const char* path) {
+	wchar_t widePath[PATH_BUFSIZE];
+	if(!MultiByteToWideChar(CP_UTF8, 0, path, -1, widePath, PATH_BUFSIZE)) {
+		return NULL;
+	}
+	file = CreateFileW(widePath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+	fileMapping = CreateFileMappingW(file, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)JOURNAL_BYTES >> 32), (DWORD)(JOURNAL_BYTES & 0xFFFFFFFF), NULL);
+	void* view = fileMapping ? MapViewOfFile(fileMapping, FILE_MAP_WRITE, 0, 0, JOURNAL_BYTES) : NULL;
+	if(!view) {
+		if(fileMapping) {
+			CloseHandle(fileMapping);
+			fileMapping = NULL;
+		}
+		CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+		return NULL;
+	}
+	return (char*)view;
+}
+
+static void unmapFile() {
+	FlushViewOfFile(mapping, 0);
+	UnmapViewOfFile(mapping);
+	CloseHandle(fileMapping);
+	CloseHandle(file);
+	fileMapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+}
+#else
+static int file = -1;
+
+/* Opens or creates the file at its full size, a new file reads as zeros */
+static char* mapFile(const char* path) {
+	file = open(path, O_RDWR | O_CREAT, 0600);
+	if(file < 0) {
+		return NULL;
+	}
+	struct stat info;
+	if(fstat(file, &info) != 0 || ((size_t)info.st_size < JOURNAL_BYTES && ftruncate(file, JOURNAL_BYTES) != 0)) {
+		close(file);
+		file = -1;
+		return NULL;
+	}
+	void* view = mmap(NULL, JOURNAL_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	if(view == MAP_FAILED) {
+		close(file);
+		file = -1;
+		return NULL;
+	}
+	return (char*)view;
+}
+
+static void unmapFile() {
+	msync(mapping, JOURNAL_BYTES, MS_ASYNC);
+	munmap(mapping, JOURNAL_BYTES);
+	close(file);
+	file = -1;
+}
+#endif
+
+static int isEmpty(const char* bytes, size_t size) {
+	for(size_t i = 0; i < size; i++) {
+		if(bytes[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int hasLayout(const struct JournalHeader& header) {
+	return !memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) && header.version == JOURNAL_VERSION && header.headerSize == sizeof(struct JournalHeader)
+		&& header.recordSize == sizeof(struct JournalRecord) && header.capacity == JOURNAL_CAPACITY;
+}
+
+int journalOpen() {
+	if(mapping) {
+		return 1;
+	}
+	char configPath[PATH_BUFSIZE];
+	ts3Functions.getConfigPath(configPath, PATH_BUFSIZE);
+	const std::string path = std::string(configPath) + JOURNAL_FILE;
+
+	mapping = mapFile(path.c_str());
+	if(!mapping) {
+		printf("PLUGIN: journal: cannot map %s, running without one\n", path.c_str());
+		return 0;
+	}
+
+	/* A journal of another layout is kept aside instead of being overwritten record by record */
+	struct JournalHeader* header = (struct JournalHeader*)mapping;
+	if(!hasLayout(*header) && !isEmpty(mapping, sizeof(struct JournalHeader))) {
+		const std::string aside = path + ".old";
+		unmapFile();
+		remove(aside.c_str());
+		rename(path.c_str(), aside.c_str());
+		printf("PLUGIN: journal: %s has another layout, moved to %s\n", path.c_str(), aside.c_str());
+		mapping = mapFile(path.c_str());
+		if(!mapping) {
+			return 0;
+		}
+		header = (struct JournalHeader*)mapping;
+	}
+	if(!hasLayout(*header)) {
+		memset(header, 0, sizeof(struct JournalHeader));
+		memcpy(header->magic, JOURNAL_MAGIC, sizeof(header->magic));
+		header->version = JOURNAL_VERSION;
+		header->headerSize = sizeof(struct JournalHeader);
+		header->recordSize = sizeof(struct JournalRecord);
+		header->capacity = JOURNAL_CAPACITY;
+	}
+
+	/* Continue after the newest record of the last session */
+	struct JournalRecord* ring = (struct JournalRecord*)(mapping + sizeof(struct JournalHeader));
+	uint64 newest = 0;
+	for(size_t i = 0; i < JOURNAL_CAPACITY; i++) {
+		if(ring[i].sequence > newest) {
+			newest = ring[i].sequence;
+		}
+	}
+	lastSequence.store(newest);
+	records.store(ring);
+	printf("PLUGIN: journal: %s, %llu records so far\n", path.c_str(), (long long unsigned int)newest);
+	return 1;
+}
+
+/* After dispatcherStop, nothing appends anymore */
+void journalClose() {
+	if(!mapping) {
+		return;
+	}
+	records.store(NULL);
+	unmapFile();
+	mapping = NULL;
+}
+
+int journalIsOpen() {
+	return records.load(std::memory_order_relaxed) != NULL;
+}
+
+void journalAppend(struct JournalRecord& record) {
+	struct JournalRecord* ring = records.load(std::memory_order_acquire);
+	if(!ring) {
+		return;
+	}
+	record.sequence = lastSequence.fetch_add(1, std::memory_order_relaxed) + 1;
+	record.timestamp = (uint64)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+	/* Cleared sequence first, so a slot caught half written is never mistaken for a complete record */
+	struct JournalRecord& slot = ring[(record.sequence - 1) % JOURNAL_CAPACITY];
+	slot.sequence = 0;
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy((char*)&slot + sizeof(slot.sequence), (const char*)&record + sizeof(record.sequence), sizeof(record) - sizeof(record.sequence));
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.sequence = record.sequence;
+}
+
+void journalCopy(char* field, size_t size, const char* text) {
+	const size_t length = text ? std::min(strlen(text), size - 1) : 0;
+	memcpy(field, text ? text : "", length);
+	field[length] = '\0';
+}
@@ -0,0 +1,63 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include "teamspeak/public_definitions.h"
+
+/*
+ * Audit journal of every request the dispatcher sent. The file is a header followed by a fixed number of
+ * fixed size records, memory-mapped and used as a ring: once full the oldest records are overwritten.
+ * Writers only claim a sequence number atomically and copy into their slot, so the dispatcher never waits
+ * for a lock or for the disk. The OS writes the pages back, a crash of the client loses nothing written.
+ *
+ * The layout is shared with the reader in tools/, keep it free of padding and bump the version on change.
+ */
+
+#define JOURNAL_FILE     "mass_actions_journal.bin"
+#define JOURNAL_MAGIC    "MAJRNL\r\n"
+#define JOURNAL_VERSION  1
+#define JOURNAL_CAPACITY 32768  /* Records, 8 MiB */
+#define JOURNAL_UID_SIZE 32     /* Base64 of a SHA-1 is 28 characters */
+#define JOURNAL_NAME_SIZE 64
+
+struct JournalHeader {
+	char magic[8];
+	unsigned int version;
+	unsigned int headerSize;
+	unsigned int recordSize;
+	unsigned int capacity;
+	char reserved[232];
+};
+
+struct JournalRecord {
+	uint64 sequence;    /* Counts from 1, 0 = empty or being written */
+	uint64 timestamp;   /* Milliseconds since 1970, UTC, when the answer arrived */
+	uint64 channelID;   /* Target channel of moves, the channel itself for deletes and permission changes, the server or channel group of group changes */
+	unsigned int result;  /* Error code of the answer, ERROR_ok on success */
+	unsigned short verb;  /* enum RequestVerb */
+	anyID clientID;       /* Target client of everything but deletes, a client on the address of address bans */
+	char serverUID[JOURNAL_UID_SIZE];
+	char targetUID[JOURNAL_UID_SIZE];
+	char targetName[JOURNAL_NAME_SIZE];
+	char invokerUID[JOURNAL_UID_SIZE];
+	char invokerName[JOURNAL_NAME_SIZE];
+};
+
+/* Maps the journal under the config path, called from ts3plugin_init. Returns 0 if the plugin runs without one. */
+int journalOpen();
+void journalClose();
+int journalIsOpen();
+
+/* Stamps sequence and timestamp and copies the record into the ring, safe from any thread */
+void journalAppend(struct JournalRecord& record);
+
+/* Copies text into a fixed size field, truncated and always terminated */
+void journalCopy(char* field, size_t size, const char* text);
+
+#endif
@@ -12,7 +12,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <assert.h>
+#include <string>
 #include "teamspeak/public_errors.h"
 #include "teamspeak/public_errors_rare.h"
 #include "teamspeak/public_definitions.h"
@@ -20,8 +22,25 @@
 #include "teamspeak/clientlib_publicdefinitions.h"
 #include "ts3_functions.h"
 #include "plugin.h"
-
-static struct TS3Functions ts3Functions;
+#include "globals.h"
+#include "roster_cache.h"
+#include "client_columns.h"
+#include "dispatcher.h"
+#include "worker.h"
+#include "hotkeys.h"
+#include "actions.h"
+#include "filter.h"
+#include "afk.h"
+#include "server_groups.h"
+#include "channel_permissions.h"
+#include "connection_info.h"
+#include "subscriptions.h"
+#include "ts3_buffer.h"
+#include "call_timing.h"
+#include "trace.h"
+#include "journal.h"
+
+struct TS3Functions ts3Functions;
 
 #ifdef _WIN32
 #define _strcpy(dest, destSize, src) strcpy_s(dest, destSize, src)
@@ -32,14 +51,13 @@ static struct TS3Functions ts3Functions;
 
 #define PLUGIN_API_VERSION 22
 
-#define PATH_BUFSIZE 512
 #define COMMAND_BUFSIZE 128
-#define INFODATA_BUFSIZE 128
+#define INFODATA_BUFSIZE 512
+#define CALLTIMING_LINE_BUFSIZE 192
 #define SERVERINFO_BUFSIZE 256
 #define CHANNELINFO_BUFSIZE 512
-#define RETURNCODE_BUFSIZE 128
 
-static char* pluginID = NULL;
+char* pluginID = NULL;
 
 #ifdef _WIN32
 /* Helper function to convert wchar_T to Utf-8 encoded strings on Windows */
@@ -101,6 +119,7 @@ const char* ts3plugin_description() {
 /* Set TeamSpeak 3 callback functions */
 void ts3plugin_setFunctionPointers(const struct TS3Functions funcs) {
     ts3Functions = funcs;
+	callTimingInstall(&ts3Functions);
 }
 
 /*
@@ -125,6 +144,22 @@ int ts3plugin_init() {
 
 	printf("PLUGIN: App path: %s\nResources path: %s\nConfig path: %s\nPlugin path: %s\n", appPath, resourcesPath, configPath, pluginPath);
 
+	journalOpen();
+	dispatcherStart();
+	workerStart();
+	afkStart();
+
+	/* Connections established before the plugin was loaded never report it */
+	Ts3Buffer<uint64> handlerList;
+	if(ts3Functions.getServerConnectionHandlerList(handlerList.out()) == ERROR_ok) {
+		for(size_t i = 0; i < handlerList.size(); i++) {
+			int status;
+			if(ts3Functions.getConnectionStatus(handlerList[i], &status) == ERROR_ok && status == STATUS_CONNECTION_ESTABLISHED) {
+				clientColumnsOpen(handlerList[i]);
+			}
+		}
+	}
+
     return 0;  /* 0 = success, 1 = failure, -2 = failure but client will not show a "failed to load" warning */
 	/* -2 is a very special case and should only be used if a plugin displays a dialog (e.g. overlay) asking the user to disable
 	 * the plugin again, avoiding the show another dialog by the client telling the user the plugin failed to load.
@@ -136,6 +171,17 @@ void ts3plugin_shutdown() {
     /* Your plugin cleanup code here */
     printf("PLUGIN: shutdown\n");
 
+	dispatcherCancelAll();  /* Wakes a command job waiting for client details or subscriptions, so the worker can be joined */
+	subscriptionsOnCancel();
+	afkStop();
+	workerStop();
+	dispatcherStop();
+	journalClose();
+	hotkeysClear();
+	rosterCacheClear();
+	clientColumnsClear();
+	traceClear();
+
 	/*
 	 * Note:
 	 * If your plugin implements a settings dialog, it must be closed and deleted here, else the
@@ -183,6 +229,178 @@ void ts3plugin_registerPluginID(const char* id) {
 	printf("PLUGIN: registerPluginID: %s\n", pluginID);
 }
 
+/* Plugin command keyword. Return NULL or "" if not used. */
+const char* ts3plugin_commandKeyword() {
+	return "mass";
+}
+
+static void printCommandHelp(uint64 serverConnectionHandlerID) {
+	std::string verbs;
+	size_t count;
+	const struct ActionDescriptor* commands = actionCommands(&count);
+	for(size_t i = 0; i < count; i++) {
+		verbs += std::string(i ? ", " : "") + commands[i].text;
+	}
+	const std::string help = "[b]Mass actions:[/b] /mass <" + verbs + "> <filter>, e.g. /mass kick idle > 2h without group 8\n"
+		"groupadd and groupdel take a server group ID first, e.g. /mass groupadd 9 here, chgroup a channel group ID\n"
+		"ban takes a duration and an optional quoted reason first, e.g. /mass ban 1d \"raid\" name ~ bot*, it bans every address once and kicks its clients "
+		"and needs the plugin activated for this session\n"
+		"Filters: name, platform, version [=|!=|~] PATTERN; group, channelgroup, channel [=|!=] ID; here; idle OP DURATION; talkpower, dbid OP NUMBER; "
+		"away, muted, deaf, talker, recording; not, and, or, ( ), everyone\n"
+		"/mass afk DURATION moves clients idle that long into your channel, /mass afk off stops it, /mass afk shows the state";
+	ts3Functions.printMessage(serverConnectionHandlerID, help.c_str(), PLUGIN_MESSAGE_TARGET_SERVER);
+}
+
+/* "/mass afk 30m", "/mass afk off" or just "/mass afk" for the state */
+static void processAfkCommand(uint64 serverConnectionHandlerID, const char* argument) {
+	std::string value = argument;
+	value.erase(0, value.find_first_not_of(' '));
+	value.erase(value.find_last_not_of(' ') + 1);
+
+	uint64 threshold;
+	if(value.empty()) {
+		afkPrintStatus(serverConnectionHandlerID);
+	} else if(value == "off") {
+		afkDisable(serverConnectionHandlerID);
+	} else if(filterParseDuration(value, &threshold) && threshold >= 1000) {
+		workerPost([=]() { afkEnable(serverConnectionHandlerID, threshold); });
+	} else {
+		ts3Functions.printMessage(serverConnectionHandlerID, "[b]Mass actions:[/b] /mass afk needs a duration of at least a second like 30m, or off", PLUGIN_MESSAGE_TARGET_SERVER);
+	}
+}
+
+/*
+ * "/mass <verb> <filter>" runs a mass action on the clients of the server matching the filter. The filter is
+ * compiled here so mistakes are reported right away, the action itself goes to the worker like a menu action.
+ * Returns 0 if the command was handled, 1 if not.
+ */
+int ts3plugin_processCommand(uint64 serverConnectionHandlerID, const char* command) {
+	printf("PLUGIN: process command: '%s'\n", command);
+
+	while(*command == ' ') {
+		command++;
+	}
+	const char* verbEnd = strchr(command, ' ');
+	const std::string verb = verbEnd ? std::string(command, verbEnd) : std::string(command);
+	if(verb.empty() || verb == "help") {
+		printCommandHelp(serverConnectionHandlerID);
+		return 0;
+	}
+
+	if(verb == "afk") {
+		processAfkCommand(serverConnectionHandlerID, verbEnd ? verbEnd + 1 : "");
+		return 0;
+	}
+
+	const struct ActionDescriptor* action = actionFindCommand(verb.c_str());
+	if(!action) {
+		const std::string message = "[b]Mass actions:[/b] Unknown command " + verb + ", try /mass help";
+		ts3Functions.printMessage(serverConnectionHandlerID, message.c_str(), PLUGIN_MESSAGE_TARGET_SERVER);
+		return 0;
+	}
+	if(action->guard == GUARD_ARMED && !actionsArmed()) {
+		const std::string message = "[b]Mass actions:[/b] " + verb + " only runs once the plugin is activated for this session";
+		ts3Functions.printMessage(serverConnectionHandlerID, message.c_str(), PLUGIN_MESSAGE_TARGET_SERVER);
+		return 0;
+	}
+
+	/* "/mass groupadd 9 <filter>", the group comes before the filter */
+	const char* filterText = verbEnd ? verbEnd + 1 : "";
+	struct CommandArguments arguments = CommandArguments();
+	if(actionTakesGroup(action)) {
+		filterText += strspn(filterText, " ");
+		char* end = (char*)filterText;
+		if(isdigit((unsigned char)*filterText)) {
+			arguments.groupID = strtoull(filterText, &end, 10);
+		}
+		if(!arguments.groupID || (*end && *end != ' ')) {
+			const std::string message = "[b]Mass actions:[/b] " + verb + " needs a group ID first, e.g. /mass " + verb + " 9 here";
+			ts3Functions.printMessage(serverConnectionHandlerID, message.c_str(), PLUGIN_MESSAGE_TARGET_SERVER);
+			return 0;
+		}
+		filterText = end + strspn(end, " ");
+	}
+
+	/* "/mass ban 1d "raid" <filter>", the duration and an optional quoted reason come before the filter */
+	if(actionTakesBanTerms(action)) {
+		filterText += strspn(filterText, " ");
+		const char* end = filterText + strcspn(filterText, " ");
+		uint64 milliseconds;
+		if(!filterParseDuration(std::string(filterText, end), &milliseconds) || milliseconds < 1000) {
+			const std::string message = "[b]Mass actions:[/b] " + verb + " needs a duration of at least a second first, e.g. /mass " + verb + " 1d \"raid\" name ~ bot*";
+			ts3Functions.printMessage(serverConnectionHandlerID, message.c_str(), PLUGIN_MESSAGE_TARGET_SERVER);
+			return 0;
+		}
+		arguments.banSeconds = milliseconds / 1000;
+		filterText = end + strspn(end, " ");
+		if(*filterText == '"') {
+			const char* close = strchr(filterText + 1, '"');
+			if(!close) {
+				ts3Functions.printMessage(serverConnectionHandlerID, "[b]Mass actions:[/b] The ban reason misses its closing quote", PLUGIN_MESSAGE_TARGET_SERVER);
+				return 0;
+			}
+			arguments.banReason.assign(filterText + 1, close);
+			filterText = close + 1 + strspn(close + 1, " ");
+		}
+	}
+
+	struct ClientFilter filter;
+	std::string error;
+	if(!filterCompile(filterText, &filter, &error)) {
+		const std::string message = "[b]Mass actions:[/b] " + error;
+		ts3Functions.printMessage(serverConnectionHandlerID, message.c_str(), PLUGIN_MESSAGE_TARGET_SERVER);
+		return 0;
+	}
+
+	if(actionsOnAllConnections()) {
+		workerPost([=]() { actionRunFilteredOnAllConnections(action, filter, arguments); });
+	} else {
+		workerPost([=]() { actionRunFiltered(action, serverConnectionHandlerID, filter, arguments); });
+	}
+	return 0;
+}
+
+/* Static title shown in the left column in the info frame */
+const char* ts3plugin_infoTitle() {
+	return "Keyinator's Mass Actions";
+}
+
+/*
+ * Dynamic content shown in the right column in the info frame. Shows the client lib buffers the plugin
+ * currently owns, so leaks and the memory peak of the last mass action can be read off the server info.
+ */
+void ts3plugin_infoData(uint64 serverConnectionHandlerID, uint64 id, enum PluginItemType type, char** data) {
+	if(type != PLUGIN_SERVER) {
+		*data = NULL;  /* Nothing to show for channels and clients */
+		return;
+	}
+
+	const struct Ts3BufferStats stats = ts3BufferStats();
+	std::vector<struct CallTiming> timings;
+	callTimingSnapshot(&timings);
+
+	const size_t size = INFODATA_BUFSIZE + timings.size() * CALLTIMING_LINE_BUFSIZE;
+	*data = (char*)malloc(size * sizeof(char));  /* Must be allocated in the plugin! */
+	size_t length = snprintf(*data, size,
+		"Client lib buffers alive: %u (%u bytes)\n"
+		"Peak: %u bytes, last action: %u bytes\n"
+		"Buffers taken since load: %u",
+		(unsigned int)stats.liveBuffers, (unsigned int)stats.liveBytes,
+		(unsigned int)stats.peakBytes, (unsigned int)stats.actionPeakBytes,
+		(unsigned int)stats.totalBuffers);
+
+	/* Client lib calls by total time, kept after timing was stopped until it is started again */
+	if(!timings.empty() && length < size) {
+		length += snprintf(*data + length, size - length, "\n\nClient lib calls%s:", callTimingEnabled() ? "" : " (timing stopped)");
+	}
+	for(size_t i = 0; i < timings.size() && length < size; i++) {
+		const struct CallTiming& timing = timings[i];
+		length += snprintf(*data + length, size - length, "\n%s: %llu calls, %.1f ms, avg %.1f us, p50 < %.0f us, p99 < %.0f us, max %.0f us",
+			timing.name, (long long unsigned int)timing.calls, 1e3 * timing.totalSeconds, 1e6 * timing.totalSeconds / timing.calls,
+			1e6 * timing.p50Seconds, 1e6 * timing.p99Seconds, 1e6 * timing.maxSeconds);
+	}
+}
+
 /* Required to release the memory for parameter "data" allocated in ts3plugin_infoData and ts3plugin_initMenus */
 void ts3plugin_freeMemory(void* data) {
 	free(data);
@@ -212,58 +430,6 @@ static struct PluginMenuItem* createMenuItem(enum PluginMenuType type, int id, c
 #define CREATE_MENU_ITEM(a, b, c, d) (*menuItems)[n++] = createMenuItem(a, b, c, d);
 #define END_CREATE_MENUS (*menuItems)[n++] = NULL; assert(n == sz);
 
-/*
- * Menu IDs for this plugin. Pass these IDs when creating a menuitem to the TS3 client. When the menu item is triggered,
- * ts3plugin_onMenuItemEvent will be called passing the menu ID of the triggered menu item.
- * These IDs are freely choosable by the plugin author. It's not really needed to use an enum, it just looks prettier.
- */
-enum {
-	MENU_ID_GLOBAL_1,
-	MENU_ID_GLOBAL_2,
-	MENU_ID_GLOBAL_3,
-	MENU_ID_GLOBAL_4,
-	MENU_ID_GLOBAL_5,
-	MENU_ID_GLOBAL_6,
-	MENU_ID_GLOBAL_7,
-	MENU_ID_GLOBAL_8,
-	MENU_ID_GLOBAL_9,
-	MENU_ID_GLOBAL_10,
-	MENU_ID_GLOBAL_11,
-	MENU_ID_GLOBAL_12,
-	MENU_ID_GLOBAL_13,
-	MENU_ID_GLOBAL_14,
-	MENU_ID_GLOBAL_15,
-	MENU_ID_GLOBAL_16,
-	MENU_ID_GLOBAL_17,
-	MENU_ID_GLOBAL_18,
-	MENU_ID_GLOBAL_19,
-	MENU_ID_GLOBAL_20,
-	MENU_ID_GLOBAL_21,
-	MENU_ID_GLOBAL_22,
-	MENU_ID_GLOBAL_23,
-	MENU_ID_GLOBAL_24,
-	MENU_ID_GLOBAL_25,
-	MENU_ID_GLOBAL_26,
-	MENU_ID_GLOBAL_27,
-	MENU_ID_GLOBAL_28,
-	MENU_ID_CHANNEL_1,
-	MENU_ID_CHANNEL_2,
-	MENU_ID_CHANNEL_3,
-	MENU_ID_CHANNEL_4,
-	MENU_ID_CHANNEL_5,
-	MENU_ID_CHANNEL_6,
-	MENU_ID_CHANNEL_7,
-	MENU_ID_CHANNEL_8,
-	MENU_ID_CHANNEL_9,
-	MENU_ID_CHANNEL_10,
-	MENU_ID_CHANNEL_11,
-	MENU_ID_CHANNEL_12,
-	MENU_ID_CHANNEL_13,
-	MENU_ID_CHANNEL_14,
-	MENU_ID_CLIENT_1,
-	MENU_ID_CLIENT_2
-};
-
 /*
  * Initialize plugin menus.
  * This function is called after ts3plugin_init and ts3plugin_registerPluginID. A pluginID is required for plugin menus to work.
@@ -288,62 +454,14 @@ void ts3plugin_initMenus(struct PluginMenuItem*** menuItems, char** menuIcon) {
 	 * e.g. for "test_plugin.dll", icon "1.png" is loaded from <TeamSpeak 3 Client install dir>\plugins\test_plugin\1.png
 	 */
 
-	BEGIN_CREATE_MENUS(7);  /* IMPORTANT: Number of menu items must be correct! */
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_1, "[MOVING]","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_2, "Move all clients into own channel","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_25,"","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_3, "[KICKING]","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_4, "=[clients in channel]","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_5, "==[from channel]","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_6, "everyone (but you)","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_7, "everyone","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_8, "==[from server]","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_9, "everyone (but you)","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_10, "everyone","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_11, "=[clients in server]","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_12, "==[from channel]","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_13, "everyone (but you)","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_14, "everyone","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_15, "==[from server]","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_16, "everyone (but you)","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_16, "everyone","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_26,"","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_28, "[TALKPOWER]","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_18, "Give everyone talkpower","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_19, "Take everyones talkpower","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_27,"","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_20, "[MISC]","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_21, "ACTIVATE FOR THIS SESSION","");
-	ts3Functions.setPluginMenuEnabled(pluginID, 20, 1);
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_22, "DEACTIVATE FOR THIS SESSION","");
-	ts3Functions.setPluginMenuEnabled(pluginID, 21, 0);
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_23, "Delete every channel","");
-	ts3Functions.setPluginMenuEnabled(pluginID, 22, 0);
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_GLOBAL, MENU_ID_GLOBAL_24, "Delete every empty channel","");
-	ts3Functions.setPluginMenuEnabled(pluginID, 23, 0);
-
-	/* CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL - CHANNEL */
-
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_1, "[MOVING]","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_11, "=[from this channel]", "");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_2, "to your channel", "");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_12, "=[to this channel]", "");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_13, "your channel","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_14, "whole server", "");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_3, "","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_4, "[KICKING]", "");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_5, "=[from channel]", "");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_6, "everyone (but you)", "");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_7, "everyone", "");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_8, "=[from server]", "");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_9, "everyone (but you)", "");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CHANNEL, MENU_ID_CHANNEL_10, "everyone", "");
-
-	/* CLIENT - CLIENT - CLIENT - CLIENT - CLIENT - CLIENT - CLIENT - CLIENT - CLIENT - CLIENT - CLIENT - CLIENT - CLIENT */
-
-	/*CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CLIENT, MENU_ID_CLIENT_1, "Client item 1","");
-	CREATE_MENU_ITEM(PLUGIN_MENU_TYPE_CLIENT, MENU_ID_CLIENT_2, "Client item 2",""); */
+	/* Menus come from the action table, see actions.cpp */
+	size_t count;
+	const struct ActionDescriptor* actions = actionTable(&count);
 
+	BEGIN_CREATE_MENUS(count);  /* IMPORTANT: Number of menu items must be correct! */
+	for(size_t i = 0; i < count; i++) {
+		CREATE_MENU_ITEM(actions[i].type, actions[i].menuID, actions[i].text, "");
+	}
 	END_CREATE_MENUS;  /* Includes an assert checking if the number of menu items matched */
 
 	/*
@@ -360,12 +478,42 @@ void ts3plugin_initMenus(struct PluginMenuItem*** menuItems, char** menuIcon) {
 	 * ensure Qt menus are not modified by any thread other the UI thread. The enabled or disable state will change the next time a
 	 * menu is displayed.
 	 */
-	/* For example, this would disable MENU_ID_GLOBAL_2: */
-	/* ts3Functions.setPluginMenuEnabled(pluginID, MENU_ID_GLOBAL_2, 0); */
+	/* Destructive actions start disabled until they are activated for the session */
+	actionsSetArmed(0);
+	actionsSetAllConnections(0);
+	actionsSetCallTiming(callTimingEnabled());
+	actionsSetTracing(traceEnabled());
 
 	/* All memory allocated in this function will be automatically released by the TeamSpeak client later by calling ts3plugin_freeMemory */
 }
 
+/* Helper function to create a hotkey */
+static struct PluginHotkey* createHotkey(const char* keyword, const char* description) {
+	struct PluginHotkey* hotkey = (struct PluginHotkey*)malloc(sizeof(struct PluginHotkey));
+	_strcpy(hotkey->keyword, PLUGIN_HOTKEY_BUFSZ, keyword);
+	_strcpy(hotkey->description, PLUGIN_HOTKEY_BUFSZ, description);
+	return hotkey;
+}
+
+/* Some makros to make the code to create hotkeys a bit more readable */
+#define BEGIN_CREATE_HOTKEYS(x) const size_t sz = x + 1; size_t n = 0; *hotkeys = (struct PluginHotkey**)malloc(sizeof(struct PluginHotkey*) * sz);
+#define CREATE_HOTKEY(a, b) (*hotkeys)[n++] = createHotkey(a, b);
+#define END_CREATE_HOTKEYS (*hotkeys)[n++] = NULL; assert(n == sz);
+
+/*
+ * Initialize plugin hotkeys.
+ * The keyword is passed to ts3plugin_onHotkeyEvent, the description is shown in the clients hotkey dialog.
+ */
+void ts3plugin_initHotkeys(struct PluginHotkey*** hotkeys) {
+	BEGIN_CREATE_HOTKEYS(3);  /* IMPORTANT: Number of hotkeys must be correct! */
+	CREATE_HOTKEY(HOTKEY_EVACUATE_CHANNEL, "Move everyone but you from your channel to the default channel");
+	CREATE_HOTKEY(HOTKEY_KICK_CHANNEL, "Kick everyone but you from your channel");
+	CREATE_HOTKEY(HOTKEY_ABORT, "Abort all running mass actions");
+	END_CREATE_HOTKEYS;
+
+	/* The client will call ts3plugin_freeMemory to release all allocated memory */
+}
+
 /************************** TeamSpeak callbacks ***************************/
 /*
  * Following functions are optional, feel free to remove unused callbacks.
@@ -374,434 +522,200 @@ void ts3plugin_initMenus(struct PluginMenuItem*** menuItems, char** menuIcon) {
 
 /* Clientlib */
 
-void ts3plugin_onMenuItemEvent(uint64 serverConnectionHandlerID, enum PluginMenuType type, int menuItemID, uint64 selectedItemID) {
-	printf("PLUGIN: onMenuItemEvent: serverConnectionHandlerID=%llu, type=%d, menuItemID=%d, selectedItemID=%llu\n", (long long unsigned int)serverConnectionHandlerID, type, menuItemID, (long long unsigned int)selectedItemID);
-	switch(type) {
-		case PLUGIN_MENU_TYPE_GLOBAL:
-			/* Global menu item was triggered. selectedItemID is unused and set to zero. */
-			switch(menuItemID) {
-				case MENU_ID_GLOBAL_2: {
-					/* Menu global 1 was triggered */
-					anyID *ClientList;
-					ts3Functions.getClientList(serverConnectionHandlerID, &ClientList);
-
-					anyID myID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &myID);
-
-					uint64 myChannel;
-					ts3Functions.getChannelOfClient(serverConnectionHandlerID, myID, &myChannel);
-
-					for (int c = 0; ClientList[c]; c++)
-					{
-						uint64 clientChannel;
-						ts3Functions.getChannelOfClient(serverConnectionHandlerID, ClientList[c], &clientChannel);
-
-						if (clientChannel != myChannel)
-						{
-							ts3Functions.requestClientMove(serverConnectionHandlerID, ClientList[c], myChannel, "", 0);
-						}
-					}
-				}
-				break;
-				case MENU_ID_GLOBAL_6: {
-					/* Menu global 2 was triggered */
-					anyID *ClientList;
-					ts3Functions.getClientList(serverConnectionHandlerID, &ClientList);
-
-					anyID myID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &myID);
-
-					uint64 myChannel;
-					ts3Functions.getChannelOfClient(serverConnectionHandlerID, myID, &myChannel);
-
-					for (int c = 0; ClientList[c]; c++)
-					{
-						uint64 clientChannel;
-						ts3Functions.getChannelOfClient(serverConnectionHandlerID, ClientList[c], &clientChannel);
-
-						if ((clientChannel == myChannel) && (ClientList[c] != myID))
-						{
-							ts3Functions.requestClientKickFromChannel(serverConnectionHandlerID, ClientList[c], "", NULL);
-							
-						}
-					}
-				}
-				break;
-				case MENU_ID_GLOBAL_7: {
-					/* Menu global 3 was triggered */
-					anyID *ClientList;
-					ts3Functions.getClientList(serverConnectionHandlerID, &ClientList);
-
-					anyID myID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &myID);
-
-					uint64 myChannel;
-					ts3Functions.getChannelOfClient(serverConnectionHandlerID, myID, &myChannel);
-
-					for (int c = 0; ClientList[c]; c++)
-					{
-						uint64 clientChannel;
-						ts3Functions.getChannelOfClient(serverConnectionHandlerID, ClientList[c], &clientChannel);
-
-						if (clientChannel == myChannel)
-						{
-							ts3Functions.requestClientKickFromChannel(serverConnectionHandlerID, ClientList[c], "", NULL);
-						}
-					}
-				}
-				break;
-				case MENU_ID_GLOBAL_9: {
-					/* Menu global 4 was triggered */
-					anyID *ClientList;
-					ts3Functions.getClientList(serverConnectionHandlerID, &ClientList);
-
-					anyID myID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &myID);
-
-					uint64 myChannel;
-					ts3Functions.getChannelOfClient(serverConnectionHandlerID, myID, &myChannel);
-
-					for (int c = 0; ClientList[c]; c++)
-					{
-						uint64 clientChannel;
-						ts3Functions.getChannelOfClient(serverConnectionHandlerID, ClientList[c], &clientChannel);
-
-						if ((clientChannel == myChannel) && (ClientList[c] != myID))
-						{
-							ts3Functions.requestClientKickFromServer(serverConnectionHandlerID, ClientList[c], "", NULL);
-
-						}
-					}
-				}
-				break;
-				case MENU_ID_GLOBAL_10: {
-					/* Menu global 5 was triggered */
-					anyID *ClientList;
-					ts3Functions.getClientList(serverConnectionHandlerID, &ClientList);
-
-					anyID myID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &myID);
-
-					uint64 myChannel;
-					ts3Functions.getChannelOfClient(serverConnectionHandlerID, myID, &myChannel);
-
-					for (int c = 0; ClientList[c]; c++)
-					{
-						uint64 clientChannel;
-						ts3Functions.getChannelOfClient(serverConnectionHandlerID, ClientList[c], &clientChannel);
-
-						if ((clientChannel == myChannel) && (ClientList[c] != myID))
-						{
-							ts3Functions.requestClientKickFromServer(serverConnectionHandlerID, ClientList[c], "", NULL);
-
-						}
-					}
-					ts3Functions.requestClientKickFromServer(serverConnectionHandlerID, myID, "", NULL);
-				}
-				break;
-										
-				case MENU_ID_GLOBAL_13: {
-					/* Menu global 2 was triggered */
-					anyID *ClientList;
-					ts3Functions.getClientList(serverConnectionHandlerID, &ClientList);
-
-					anyID myID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &myID);
-
-					uint64 myChannel;
-					ts3Functions.getChannelOfClient(serverConnectionHandlerID, myID, &myChannel);
-
-					for (int c = 0; ClientList[c]; c++)
-					{
-						uint64 clientChannel;
-						ts3Functions.getChannelOfClient(serverConnectionHandlerID, ClientList[c], &clientChannel);
-
-						if (ClientList[c] != myID) {
-							ts3Functions.requestClientKickFromChannel(serverConnectionHandlerID, ClientList[c], "", NULL);
-						}
-
-					}
-				}
-				break;
-				case MENU_ID_GLOBAL_14: {
-					/* Menu global 3 was triggered */
-					anyID *ClientList;
-					ts3Functions.getClientList(serverConnectionHandlerID, &ClientList);
-
-					anyID myID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &myID);
-
-					uint64 myChannel;
-					ts3Functions.getChannelOfClient(serverConnectionHandlerID, myID, &myChannel);
-
-					for (int c = 0; ClientList[c]; c++)
-					{
-						uint64 clientChannel;
-						ts3Functions.getChannelOfClient(serverConnectionHandlerID, ClientList[c], &clientChannel);
-
-						ts3Functions.requestClientKickFromChannel(serverConnectionHandlerID, ClientList[c], "", NULL);
-					}
-				}
-				break;
-				case MENU_ID_GLOBAL_16: {
-					/* Menu global 4 was triggered */
-					anyID *ClientList;
-					ts3Functions.getClientList(serverConnectionHandlerID, &ClientList);
-
-					anyID myID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &myID);
-
-					uint64 myChannel;
-					ts3Functions.getChannelOfClient(serverConnectionHandlerID, myID, &myChannel);
-
-					for (int c = 0; ClientList[c]; c++)
-					{
-						uint64 clientChannel;
-						ts3Functions.getChannelOfClient(serverConnectionHandlerID, ClientList[c], &clientChannel);
-
-						if (ClientList[c] != myID) {
-							ts3Functions.requestClientKickFromServer(serverConnectionHandlerID, ClientList[c], "", NULL);
-						}
-					}
-				}
-				break;
-				case MENU_ID_GLOBAL_17: {
-					/* Menu global 5 was triggered */
-					anyID *ClientList;
-					ts3Functions.getClientList(serverConnectionHandlerID, &ClientList);
-
-					anyID myID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &myID);
-
-					uint64 myChannel;
-					ts3Functions.getChannelOfClient(serverConnectionHandlerID, myID, &myChannel);
-
-					for (int c = 0; ClientList[c]; c++)
-					{
-						uint64 clientChannel;
-						ts3Functions.getChannelOfClient(serverConnectionHandlerID, ClientList[c], &clientChannel);
-
-						if (ClientList[c] != myID) {
-							ts3Functions.requestClientKickFromServer(serverConnectionHandlerID, ClientList[c], "", NULL);
-						}
-					}
-					ts3Functions.requestClientKickFromServer(serverConnectionHandlerID, myID, "", NULL);
-				}
-				break;
-				case MENU_ID_GLOBAL_18: {
-					anyID *ClientList;
-					ts3Functions.getClientList(serverConnectionHandlerID, &ClientList);
-
-					anyID myID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &myID);
-
-					uint64 myChannel;
-					ts3Functions.getChannelOfClient(serverConnectionHandlerID, myID, &myChannel);
-
-					for (int c = 0; ClientList[c]; c++)
-					{
-						uint64 clientChannel;
-						ts3Functions.getChannelOfClient(serverConnectionHandlerID, ClientList[c], &clientChannel);
-
-						if (clientChannel == myChannel)
-						{
-							ts3Functions.requestClientSetIsTalker(serverConnectionHandlerID, ClientList[c], 1, NULL);
-						}
-					}
-				}
-				break;
-				case MENU_ID_GLOBAL_19: {
-					anyID *ClientList;
-					ts3Functions.getClientList(serverConnectionHandlerID, &ClientList);
-
-					anyID myID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &myID);
-
-					uint64 myChannel;
-					ts3Functions.getChannelOfClient(serverConnectionHandlerID, myID, &myChannel);
-
-					for (int c = 0; ClientList[c]; c++)
-					{
-						uint64 clientChannel;
-						ts3Functions.getChannelOfClient(serverConnectionHandlerID, ClientList[c], &clientChannel);
-
-						if (clientChannel == myChannel)
-						{
-							ts3Functions.requestClientSetIsTalker(serverConnectionHandlerID, ClientList[c], 0, NULL);
-						}
-					}
-				}
-				break;
-				case MENU_ID_GLOBAL_21: {
-					/* Activate */
-					for (int c = 21; c <= 23; c++)
-					{
-						ts3Functions.setPluginMenuEnabled(pluginID, c, 1);
-					}
-					ts3Functions.setPluginMenuEnabled(pluginID, 20, 0);
-				}
-				break;
-				case MENU_ID_GLOBAL_22: {
-					/* Deactivate */
-					for (int c = 21; c <= 23; c++)
-					{
-						ts3Functions.setPluginMenuEnabled(pluginID, c, 0);
-					}
-					ts3Functions.setPluginMenuEnabled(pluginID, 20, 1);
-				}
-				break;
-				case MENU_ID_GLOBAL_23: {
-					uint64 *ChannelList;
-					ts3Functions.getChannelList(serverConnectionHandlerID, &ChannelList);
-
-					for (int c = 0; ChannelList[c]; c++)
-					{
-						ts3Functions.requestChannelDelete(serverConnectionHandlerID, ChannelList[c], 1, NULL);
-					}
-				}
-				break;
-				case MENU_ID_GLOBAL_24: {
-					uint64 *ChannelList;
-					ts3Functions.getChannelList(serverConnectionHandlerID, &ChannelList);
-
-					for (int c = 0; ChannelList[c]; c++)
-					{
-						ts3Functions.requestChannelDelete(serverConnectionHandlerID, ChannelList[c], 0, NULL);
-					}
-				}
-				break;
-				default:
-					break;
-			}
+void ts3plugin_onConnectStatusChangeEvent(uint64 serverConnectionHandlerID, int newStatus, unsigned int errorNumber) {
+	switch(newStatus) {
+		case STATUS_CONNECTION_ESTABLISHED:
+			/* Channels and clients are all known now, take the initial roster */
+			rosterCacheSeed(serverConnectionHandlerID);
+			clientColumnsOpen(serverConnectionHandlerID);
+			hotkeysWarm(serverConnectionHandlerID);
 			break;
-		case PLUGIN_MENU_TYPE_CHANNEL:
-			/* Channel contextmenu item was triggered. selectedItemID is the channelID of the selected channel */
-			switch (menuItemID) {
-				case MENU_ID_CHANNEL_2: {
-					anyID ClientID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &ClientID);
-
-					uint64 ClientChannel;
-					ts3Functions.getChannelOfClient(serverConnectionHandlerID, ClientID, &ClientChannel);
-
-					anyID *ChannelClients;
-					ts3Functions.getChannelClientList(serverConnectionHandlerID, selectedItemID, &ChannelClients);
-
-					for (int c = 0; ChannelClients[c]; c++) {
-						ts3Functions.requestClientMove(serverConnectionHandlerID, ChannelClients[c], ClientChannel, "", NULL);
-					}
-				}
-				break;
-				case MENU_ID_CHANNEL_6: {
-					anyID ClientID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &ClientID);
-
-					anyID *ChannelClients;
-					ts3Functions.getChannelClientList(serverConnectionHandlerID, selectedItemID, &ChannelClients);
-
-					for (int c = 0; ChannelClients[c]; c++) {
-						if (ChannelClients[c] != ClientID) {
-							ts3Functions.requestClientKickFromChannel(serverConnectionHandlerID, ChannelClients[c], "", NULL);
-						}
-					}
-				}
-				break;
-				case MENU_ID_CHANNEL_7: {
-
-					anyID *ChannelClients;
-					ts3Functions.getChannelClientList(serverConnectionHandlerID, selectedItemID, &ChannelClients);
-
-					for (int c = 0; ChannelClients[c]; c++) {
-							ts3Functions.requestClientKickFromChannel(serverConnectionHandlerID, ChannelClients[c], "", NULL);
-					}
-				}
-				break;
-				case MENU_ID_CHANNEL_9: {
-					anyID ClientID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &ClientID);
-
-					uint64 ClientChannel;
-					ts3Functions.getChannelOfClient(serverConnectionHandlerID, ClientID, &ClientChannel);
-
-					anyID *ChannelClients;
-					ts3Functions.getChannelClientList(serverConnectionHandlerID, selectedItemID, &ChannelClients);
-
-					for (int c = 0; ChannelClients[c]; c++) {
-						if (ChannelClients[c] != ClientID) {
-							ts3Functions.requestClientKickFromServer(serverConnectionHandlerID, ChannelClients[c], "", NULL);
-						}
-					}
-				}
-				break;
-				case MENU_ID_CHANNEL_10: {
-					anyID ClientID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &ClientID);
-
-					uint64 ClientChannel;
-					ts3Functions.getChannelOfClient(serverConnectionHandlerID, ClientID, &ClientChannel);
-
-					anyID *ChannelClients;
-					ts3Functions.getChannelClientList(serverConnectionHandlerID, selectedItemID, &ChannelClients);
-
-					for (int c = 0; ChannelClients[c]; c++) {
-						if (ChannelClients[c] != ClientID) {
-							ts3Functions.requestClientKickFromServer(serverConnectionHandlerID, ChannelClients[c], "", NULL);
-						}
-					}
-
-					ts3Functions.requestClientKickFromServer(serverConnectionHandlerID, ClientID, "", NULL);
-
-				}
-				break;
-				case MENU_ID_CHANNEL_13: {
-					anyID ClientID;
-					ts3Functions.getClientID(serverConnectionHandlerID, &ClientID);
-
-					uint64 ClientChannel;
-					ts3Functions.getChannelOfClient(serverConnectionHandlerID, ClientID, &ClientChannel);
-
-					anyID *ChannelClients;
-					ts3Functions.getChannelClientList(serverConnectionHandlerID, ClientChannel, &ChannelClients);
-
-					for (int c = 0; ChannelClients[c]; c++) {
-						ts3Functions.requestClientMove(serverConnectionHandlerID, ChannelClients[c], selectedItemID, "", NULL);
-					}
-				}
-				break;
-				case MENU_ID_CHANNEL_14: {
-
-					anyID *ServerClients;
-					ts3Functions.getClientList(serverConnectionHandlerID, &ServerClients);
-
-					for (int c = 0; ServerClients[c]; c++) {
-						uint64 ClientChannel;
-						ts3Functions.getChannelOfClient(serverConnectionHandlerID, ServerClients[c], &ClientChannel);
-
-						if (ClientChannel != selectedItemID) {
-							ts3Functions.requestClientMove(serverConnectionHandlerID, ServerClients[c], selectedItemID, "", NULL);
-						}
-					}
-				}
-				break;
-				default:
-					break;
-			}
+		case STATUS_DISCONNECTED:
+			dispatcherDrop(serverConnectionHandlerID);
+			hotkeysDrop(serverConnectionHandlerID);
+			rosterCacheDrop(serverConnectionHandlerID);
+			clientColumnsDrop(serverConnectionHandlerID);
+			afkDrop(serverConnectionHandlerID);
 			break;
-		case PLUGIN_MENU_TYPE_CLIENT:
-			/* Client contextmenu item was triggered. selectedItemID is the clientID of the selected client */
-			//switch (menuItemID) {
-			//case MENU_ID_CLIENT_1:
-			//	/* Menu client 1 was triggered */
-			//	break;
-			//case MENU_ID_CLIENT_2:
-			//	/* Menu client 2 was triggered */
-			//	break;
-			//default:
-			//	break;
-			//}
-			//break;
 		default:
 			break;
-		break;
 	}
-}
\ No newline at end of file
+}
+
+void ts3plugin_onNewChannelEvent(uint64 serverConnectionHandlerID, uint64 channelID, uint64 channelParentID) {
+	rosterCacheChannelAdded(serverConnectionHandlerID, channelID);
+	hotkeysOnChannelsChanged(serverConnectionHandlerID);
+}
+
+void ts3plugin_onNewChannelCreatedEvent(uint64 serverConnectionHandlerID, uint64 channelID, uint64 channelParentID, anyID invokerID, const char* invokerName, const char* invokerUniqueIdentifier) {
+	rosterCacheChannelAdded(serverConnectionHandlerID, channelID);
+	hotkeysOnChannelsChanged(serverConnectionHandlerID);
+}
+
+void ts3plugin_onDelChannelEvent(uint64 serverConnectionHandlerID, uint64 channelID, anyID invokerID, const char* invokerName, const char* invokerUniqueIdentifier) {
+	rosterCacheChannelDeleted(serverConnectionHandlerID, channelID);
+	afkChannelDeleted(serverConnectionHandlerID, channelID);
+	hotkeysOnChannelsChanged(serverConnectionHandlerID);
+}
+
+void ts3plugin_onUpdateChannelEditedEvent(uint64 serverConnectionHandlerID, uint64 channelID, anyID invokerID, const char* invokerName, const char* invokerUniqueIdentifier) {
+	/* Might have been made the default channel */
+	hotkeysOnChannelsChanged(serverConnectionHandlerID);
+}
+
+/* Properties of a client changed, also the answer to requestClientVariables */
+void ts3plugin_onUpdateClientEvent(uint64 serverConnectionHandlerID, anyID clientID, anyID invokerID, const char* invokerName, const char* invokerUniqueIdentifier) {
+	clientColumnsClientUpdated(serverConnectionHandlerID, clientID);
+}
+
+void ts3plugin_onClientMoveEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, const char* moveMessage) {
+	rosterCacheClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	clientColumnsClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	afkClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	hotkeysOnClientMoved(serverConnectionHandlerID, clientID, oldChannelID, newChannelID);
+}
+
+void ts3plugin_onClientMoveSubscriptionEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility) {
+	rosterCacheClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	clientColumnsClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	afkClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	hotkeysOnClientMoved(serverConnectionHandlerID, clientID, oldChannelID, newChannelID);
+}
+
+/* Talking is the one activity the client lib reports without asking, it restarts the AFK countdown */
+void ts3plugin_onTalkStatusChangeEvent(uint64 serverConnectionHandlerID, int status, int isReceivedWhisper, anyID clientID) {
+	if(status == STATUS_TALKING) {
+		afkClientTalked(serverConnectionHandlerID, clientID);
+	}
+}
+
+void ts3plugin_onChannelSubscribeFinishedEvent(uint64 serverConnectionHandlerID) {
+	subscriptionsOnFinished(serverConnectionHandlerID);
+}
+
+void ts3plugin_onClientMoveTimeoutEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, const char* timeoutMessage) {
+	rosterCacheClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	clientColumnsClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	afkClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	hotkeysOnClientMoved(serverConnectionHandlerID, clientID, oldChannelID, newChannelID);
+}
+
+void ts3plugin_onClientMoveMovedEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID moverID, const char* moverName, const char* moverUniqueIdentifier, const char* moveMessage) {
+	rosterCacheClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	clientColumnsClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	afkClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	hotkeysOnClientMoved(serverConnectionHandlerID, clientID, oldChannelID, newChannelID);
+}
+
+void ts3plugin_onClientKickFromChannelEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID kickerID, const char* kickerName, const char* kickerUniqueIdentifier, const char* kickMessage) {
+	rosterCacheClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	clientColumnsClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	afkClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	hotkeysOnClientMoved(serverConnectionHandlerID, clientID, oldChannelID, newChannelID);
+}
+
+void ts3plugin_onClientKickFromServerEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID kickerID, const char* kickerName, const char* kickerUniqueIdentifier, const char* kickMessage) {
+	rosterCacheClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	clientColumnsClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	afkClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	hotkeysOnClientMoved(serverConnectionHandlerID, clientID, oldChannelID, newChannelID);
+}
+
+int ts3plugin_onServerErrorEvent(uint64 serverConnectionHandlerID, const char* errorMessage, unsigned int error, const char* returnCode, const char* extraMessage) {
+	/* Answers to our own paced requests, return 1 so the client doesn't print them */
+	if(dispatcherOnServerError(serverConnectionHandlerID, error, returnCode)) {
+		return 1;
+	}
+	return 0;  /* Client will handle the error */
+}
+
+/* Clientlib rare */
+
+void ts3plugin_onClientBanFromServerEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID kickerID, const char* kickerName, const char* kickerUniqueIdentifier, uint64 time, const char* kickMessage) {
+	rosterCacheClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	clientColumnsClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	afkClientMoved(serverConnectionHandlerID, clientID, newChannelID, visibility);
+	hotkeysOnClientMoved(serverConnectionHandlerID, clientID, oldChannelID, newChannelID);
+}
+
+/* One member of a server group list asked for by serverGroupMembers, they all arrive before the answer */
+void ts3plugin_onServerGroupClientListEvent(uint64 serverConnectionHandlerID, uint64 serverGroupID, uint64 clientDatabaseID, const char* clientNameIdentifier, const char* clientUniqueID) {
+	serverGroupsOnClientListEntry(serverConnectionHandlerID, serverGroupID, clientDatabaseID);
+}
+
+/* The server groups of a client in view changed */
+void ts3plugin_onServerGroupClientAddedEvent(uint64 serverConnectionHandlerID, anyID clientID, const char* clientName, const char* clientUniqueIdentity, uint64 serverGroupID, anyID invokerClientID, const char* invokerName, const char* invokerUniqueIdentity) {
+	clientColumnsClientUpdated(serverConnectionHandlerID, clientID);
+}
+
+void ts3plugin_onServerGroupClientDeletedEvent(uint64 serverConnectionHandlerID, anyID clientID, const char* clientName, const char* clientUniqueIdentity, uint64 serverGroupID, anyID invokerClientID, const char* invokerName, const char* invokerUniqueIdentity) {
+	clientColumnsClientUpdated(serverConnectionHandlerID, clientID);
+}
+
+void ts3plugin_onClientChannelGroupChangedEvent(uint64 serverConnectionHandlerID, uint64 channelGroupID, uint64 channelID, anyID clientID, anyID invokerClientID, const char* invokerName, const char* invokerUniqueIdentity) {
+	clientColumnsClientUpdated(serverConnectionHandlerID, clientID);
+}
+
+/* The address of a client asked for by connectionAddresses arrived */
+void ts3plugin_onConnectionInfoEvent(uint64 serverConnectionHandlerID, anyID clientID) {
+	connectionInfoOnEvent(serverConnectionHandlerID, clientID);
+}
+
+/* One permission of a channel asked for by channelPermissionsFetch, they all arrive before the answer */
+void ts3plugin_onChannelPermListEvent(uint64 serverConnectionHandlerID, uint64 channelID, unsigned int permissionID, int permissionValue, int permissionNegated, int permissionSkip) {
+	channelPermissionsOnListEntry(serverConnectionHandlerID, channelID, permissionID, permissionValue);
+}
+
+/* Client UI callbacks */
+
+void ts3plugin_onMenuItemEvent(uint64 serverConnectionHandlerID, enum PluginMenuType type, int menuItemID, uint64 selectedItemID) {
+	printf("PLUGIN: onMenuItemEvent: serverConnectionHandlerID=%llu, type=%d, menuItemID=%d, selectedItemID=%llu\n", (long long unsigned int)serverConnectionHandlerID, type, menuItemID, (long long unsigned int)selectedItemID);
+
+	const struct ActionDescriptor* action = actionFind(type, menuItemID);
+	if(!action) {
+		return;
+	}
+
+	/* The session toggles only touch menus, handle them right here */
+	if(action->guard == GUARD_ARM || action->guard == GUARD_DISARM) {
+		actionsSetArmed(action->guard == GUARD_ARM);
+		return;
+	}
+	if(action->guard == GUARD_ALL_CONNECTIONS_ON || action->guard == GUARD_ALL_CONNECTIONS_OFF) {
+		actionsSetAllConnections(action->guard == GUARD_ALL_CONNECTIONS_ON);
+		return;
+	}
+	if(action->guard == GUARD_CALL_TIMING_ON || action->guard == GUARD_CALL_TIMING_OFF) {
+		actionsSetCallTiming(action->guard == GUARD_CALL_TIMING_ON);
+		return;
+	}
+	if(action->guard == GUARD_TRACE_ON || action->guard == GUARD_TRACE_OFF) {
+		actionsSetTracing(action->guard == GUARD_TRACE_ON);
+		return;
+	}
+	if(!action->run) {
+		return;  /* Header or separator */
+	}
+
+	/* Everything else is a mass action, queue it so the GUI thread returns immediately */
+	if(type == PLUGIN_MENU_TYPE_GLOBAL && actionsOnAllConnections()) {
+		/* Channel menus stay on their own server, the selected channel only exists there */
+		workerPost([=]() { actionRunOnAllConnections(action); });
+	} else {
+		workerPost([=]() { actionRun(action, serverConnectionHandlerID, selectedItemID); });
+	}
+}
+
+/* Hotkeys act on the current server tab and skip the worker, their targets are already planned */
+void ts3plugin_onHotkeyEvent(const char* keyword) {
+	printf("PLUGIN: Hotkey event: %s\n", keyword);
+
+	const uint64 serverConnectionHandlerID = ts3Functions.getCurrentServerConnectionHandlerID();
+	if(!strcmp(keyword, HOTKEY_EVACUATE_CHANNEL)) {
+		hotkeyEvacuateChannel(serverConnectionHandlerID);
+	} else if(!strcmp(keyword, HOTKEY_KICK_CHANNEL)) {
+		hotkeyKickChannel(serverConnectionHandlerID);
+	} else if(!strcmp(keyword, HOTKEY_ABORT)) {
+		hotkeyAbort();
+	}
+}
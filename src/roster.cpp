@@ -0,0 +1,69 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <algorithm>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_definitions.h"
+#include "ts3_functions.h"
+#include "globals.h"
+#include "ts3_buffer.h"
+#include "roster.h"
+
+int Roster::findChannel(uint64 channelID) const {
+	std::vector<uint64>::const_iterator it = std::lower_bound(channels.begin(), channels.end(), channelID);
+	if(it == channels.end() || *it != channelID) {
+		return -1;
+	}
+	return (int)(it - channels.begin());
+}
+
+const anyID* Roster::channelBegin(uint64 channelID) const {
+	int idx = findChannel(channelID);
+	return idx < 0 ? clients.data() : clients.data() + offsets[idx];
+}
+
+const anyID* Roster::channelEnd(uint64 channelID) const {
+	int idx = findChannel(channelID);
+	return idx < 0 ? clients.data() : clients.data() + offsets[idx + 1];
+}
+
+unsigned int buildRoster(uint64 serverConnectionHandlerID, struct Roster* roster) {
+	unsigned int error;
+
+	roster->serverConnectionHandlerID = serverConnectionHandlerID;
+	roster->myChannel = 0;
+	roster->channels.clear();
+	roster->offsets.clear();
+	roster->clients.clear();
+
+	if((error = ts3Functions.getClientID(serverConnectionHandlerID, &roster->myID)) != ERROR_ok) {
+		return error;
+	}
+	if((error = ts3Functions.getChannelOfClient(serverConnectionHandlerID, roster->myID, &roster->myChannel)) != ERROR_ok) {
+		return error;
+	}
+
+	Ts3Buffer<uint64> channelList;
+	if((error = ts3Functions.getChannelList(serverConnectionHandlerID, channelList.out())) != ERROR_ok) {
+		return error;
+	}
+	roster->channels.assign(channelList.get(), channelList.get() + channelList.size());
+	std::sort(roster->channels.begin(), roster->channels.end());
+
+	roster->offsets.reserve(roster->channels.size() + 1);
+	Ts3Buffer<anyID> channelClients;
+	for(size_t i = 0; i < roster->channels.size(); i++) {
+		roster->offsets.push_back(roster->clients.size());
+
+		if(ts3Functions.getChannelClientList(serverConnectionHandlerID, roster->channels[i], channelClients.out()) != ERROR_ok) {
+			continue;  /* Channel vanished in between, treat it as empty */
+		}
+		roster->clients.insert(roster->clients.end(), channelClients.get(), channelClients.get() + channelClients.size());
+	}
+	roster->offsets.push_back(roster->clients.size());
+
+	return ERROR_ok;
+}
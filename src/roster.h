@@ -0,0 +1,38 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef ROSTER_H
+#define ROSTER_H
+
+#include <stddef.h>
+#include <vector>
+#include "teamspeak/public_definitions.h"
+
+/*
+ * Snapshot of every visible client, grouped by channel.
+ * The clients of channels[i] are clients[offsets[i]] .. clients[offsets[i + 1] - 1], so a channel is one
+ * contiguous range and the whole server is a single walk over clients.
+ */
+struct Roster {
+	uint64 serverConnectionHandlerID;
+	anyID myID;
+	uint64 myChannel;
+	std::vector<uint64> channels;  /* Sorted ascending */
+	std::vector<size_t> offsets;   /* channels.size() + 1 entries */
+	std::vector<anyID> clients;
+
+	/* Index of channelID in channels, -1 if the channel is not part of the snapshot */
+	int findChannel(uint64 channelID) const;
+
+	/* Client range of a channel; both pointers are equal for unknown or empty channels */
+	const anyID* channelBegin(uint64 channelID) const;
+	const anyID* channelEnd(uint64 channelID) const;
+};
+
+/* Builds the snapshot with one getChannelClientList call per channel instead of one getChannelOfClient call per client */
+unsigned int buildRoster(uint64 serverConnectionHandlerID, struct Roster* roster);
+
+#endif
@@ -0,0 +1,306 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_definitions.h"
+#include "teamspeak/clientlib_publicdefinitions.h"
+#include "ts3_functions.h"
+#include "globals.h"
+#include "roster_cache.h"
+
+/* Where a client sits: its channel and its position inside that channel's member list */
+struct ClientSlot {
+	uint64 channelID;
+	size_t index;
+};
+
+struct ServerCache {
+	anyID myID;
+	std::unordered_map<anyID, ClientSlot> clients;
+	std::unordered_map<uint64, std::vector<anyID> > channels;
+};
+
+/* A clientlib event, kept while a connection is being seeded */
+enum CacheEventKind {
+	CACHE_CLIENT_MOVED,
+	CACHE_CHANNEL_ADDED,
+	CACHE_CHANNEL_DELETED
+};
+
+struct CacheEvent {
+	enum CacheEventKind kind;
+	anyID clientID;
+	uint64 channelID;  /* New channel of a move */
+	int visibility;
+};
+
+/* A seed in progress reads the client lib unlocked, the events arriving meanwhile are replayed onto its result */
+struct Seeding {
+	uint64 id;  /* Tells a seeder whether its connection was dropped and seeded anew meanwhile */
+	int seeders;
+	std::vector<struct CacheEvent> events;
+};
+
+static std::mutex cacheMutex;
+static std::map<uint64, ServerCache> caches;
+static std::map<uint64, Seeding> seedings;
+static uint64 nextSeedingID = 1;
+
+/* Swap-remove a client from its channel so removal stays O(1). Caller holds cacheMutex. */
+static void unlinkClient(ServerCache& cache, anyID clientID) {
+	std::unordered_map<anyID, ClientSlot>::iterator it = cache.clients.find(clientID);
+	if(it == cache.clients.end()) {
+		return;
+	}
+
+	std::unordered_map<uint64, std::vector<anyID> >::iterator ch = cache.channels.find(it->second.channelID);
+	if(ch != cache.channels.end()) {
+		std::vector<anyID>& members = ch->second;
+		const size_t index = it->second.index;
+		if(index + 1 != members.size()) {
+			members[index] = members.back();
+			cache.clients[members[index]].index = index;
+		}
+		members.pop_back();
+	}
+	cache.clients.erase(it);
+}
+
+static void linkClient(ServerCache& cache, anyID clientID, uint64 channelID) {
+	std::vector<anyID>& members = cache.channels[channelID];
+	ClientSlot slot = { channelID, members.size() };
+	members.push_back(clientID);
+	cache.clients[clientID] = slot;
+}
+
+/* Caller holds cacheMutex. Unlinks first, so an event the seed already reflected is applied idempotently. */
+static void applyEvent(ServerCache& cache, const struct CacheEvent& event) {
+	switch(event.kind) {
+		case CACHE_CLIENT_MOVED:
+			unlinkClient(cache, event.clientID);
+			if(event.channelID != 0 && event.visibility != LEAVE_VISIBILITY) {
+				linkClient(cache, event.clientID, event.channelID);
+			}
+			break;
+		case CACHE_CHANNEL_ADDED:
+			cache.channels[event.channelID];
+			break;
+		case CACHE_CHANNEL_DELETED: {
+			std::unordered_map<uint64, std::vector<anyID> >::iterator ch = cache.channels.find(event.channelID);
+			if(ch == cache.channels.end()) {
+				break;
+			}
+			/* The server moves clients out before deleting, anything left over is stale */
+			for(size_t c = 0; c < ch->second.size(); c++) {
+				cache.clients.erase(ch->second[c]);
+			}
+			cache.channels.erase(ch);
+			break;
+		}
+	}
+}
+
+/* Applies an event to the cache of a connection and to the seeds in progress. Caller holds cacheMutex. */
+static void recordEvent(uint64 serverConnectionHandlerID, const struct CacheEvent& event) {
+	std::map<uint64, Seeding>::iterator seeding = seedings.find(serverConnectionHandlerID);
+	if(seeding != seedings.end()) {
+		seeding->second.events.push_back(event);
+	}
+	std::map<uint64, ServerCache>::iterator it = caches.find(serverConnectionHandlerID);
+	if(it != caches.end()) {
+		applyEvent(it->second, event);
+	}
+}
+
+/*
+ * Reads the connection from the client lib without holding cacheMutex, so clientlib callbacks are never
+ * blocked behind N getter calls, then installs the result and replays what happened meanwhile.
+ */
+static unsigned int seed(uint64 serverConnectionHandlerID) {
+	uint64 seedingID;
+	size_t replayFrom;
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		std::map<uint64, Seeding>::iterator it = seedings.find(serverConnectionHandlerID);
+		if(it == seedings.end()) {
+			Seeding& started = seedings[serverConnectionHandlerID];
+			started.id = nextSeedingID++;
+			started.seeders = 0;
+			it = seedings.find(serverConnectionHandlerID);
+		}
+		it->second.seeders++;
+		seedingID = it->second.id;
+		replayFrom = it->second.events.size();
+	}
+
+	struct Roster roster;
+	unsigned int error = buildRoster(serverConnectionHandlerID, &roster);
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	std::map<uint64, Seeding>::iterator seeding = seedings.find(serverConnectionHandlerID);
+	if(seeding == seedings.end() || seeding->second.id != seedingID) {
+		return ERROR_not_connected;  /* Dropped meanwhile */
+	}
+	if(error == ERROR_ok) {
+		ServerCache& cache = caches[serverConnectionHandlerID];
+		cache.myID = roster.myID;
+		cache.clients.clear();
+		cache.channels.clear();
+		cache.clients.reserve(roster.clients.size());
+		for(size_t i = 0; i < roster.channels.size(); i++) {
+			std::vector<anyID>& members = cache.channels[roster.channels[i]];
+			members.assign(roster.clients.begin() + roster.offsets[i], roster.clients.begin() + roster.offsets[i + 1]);
+			for(size_t c = 0; c < members.size(); c++) {
+				ClientSlot slot = { roster.channels[i], c };
+				cache.clients[members[c]] = slot;
+			}
+		}
+		for(size_t i = replayFrom; i < seeding->second.events.size(); i++) {
+			applyEvent(cache, seeding->second.events[i]);
+		}
+	} else {
+		caches.erase(serverConnectionHandlerID);
+	}
+	if(--seeding->second.seeders == 0) {
+		seedings.erase(seeding);
+	}
+	return error;
+}
+
+/* Seeds a connection on first use. Called without cacheMutex, which the caller takes afterwards. */
+static unsigned int ensureSeeded(uint64 serverConnectionHandlerID) {
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if(caches.count(serverConnectionHandlerID)) {
+			return ERROR_ok;
+		}
+	}
+	return seed(serverConnectionHandlerID);
+}
+
+void rosterCacheSeed(uint64 serverConnectionHandlerID) {
+	seed(serverConnectionHandlerID);
+}
+
+void rosterCacheDrop(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	caches.erase(serverConnectionHandlerID);
+	seedings.erase(serverConnectionHandlerID);
+}
+
+void rosterCacheClear() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	caches.clear();
+	seedings.clear();
+}
+
+void rosterCacheClientMoved(uint64 serverConnectionHandlerID, anyID clientID, uint64 newChannelID, int visibility) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	const struct CacheEvent event = { CACHE_CLIENT_MOVED, clientID, newChannelID, visibility };
+	recordEvent(serverConnectionHandlerID, event);
+}
+
+void rosterCacheChannelAdded(uint64 serverConnectionHandlerID, uint64 channelID) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	const struct CacheEvent event = { CACHE_CHANNEL_ADDED, 0, channelID, 0 };
+	recordEvent(serverConnectionHandlerID, event);
+}
+
+void rosterCacheChannelDeleted(uint64 serverConnectionHandlerID, uint64 channelID) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	const struct CacheEvent event = { CACHE_CHANNEL_DELETED, 0, channelID, 0 };
+	recordEvent(serverConnectionHandlerID, event);
+}
+
+/* Caller holds cacheMutex and called ensureSeeded before taking it. Returns NULL if the connection was dropped since. */
+static ServerCache* seededCache(uint64 serverConnectionHandlerID, unsigned int* error) {
+	std::map<uint64, ServerCache>::iterator it = caches.find(serverConnectionHandlerID);
+	if(it == caches.end()) {
+		*error = ERROR_not_connected;
+		return NULL;
+	}
+	return &it->second;
+}
+
+unsigned int rosterCacheSelf(uint64 serverConnectionHandlerID, anyID* myID, uint64* myChannel) {
+	unsigned int error = ensureSeeded(serverConnectionHandlerID);
+	if(error != ERROR_ok) {
+		return error;
+	}
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	const ServerCache* cache = seededCache(serverConnectionHandlerID, &error);
+	if(!cache) {
+		return error;
+	}
+
+	*myID = cache->myID;
+	std::unordered_map<anyID, ClientSlot>::const_iterator self = cache->clients.find(cache->myID);
+	*myChannel = (self != cache->clients.end()) ? self->second.channelID : 0;
+	return ERROR_ok;
+}
+
+unsigned int rosterCacheChannelMembers(uint64 serverConnectionHandlerID, uint64 channelID, std::vector<anyID>* members) {
+	unsigned int error = ensureSeeded(serverConnectionHandlerID);
+	if(error != ERROR_ok) {
+		return error;
+	}
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	const ServerCache* cache = seededCache(serverConnectionHandlerID, &error);
+	if(!cache) {
+		return error;
+	}
+
+	std::unordered_map<uint64, std::vector<anyID> >::const_iterator ch = cache->channels.find(channelID);
+	if(ch != cache->channels.end()) {
+		*members = ch->second;
+	} else {
+		members->clear();
+	}
+	return ERROR_ok;
+}
+
+unsigned int rosterCacheSnapshot(uint64 serverConnectionHandlerID, struct Roster* roster) {
+	unsigned int error = ensureSeeded(serverConnectionHandlerID);
+	if(error != ERROR_ok) {
+		return error;
+	}
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	const ServerCache* seeded = seededCache(serverConnectionHandlerID, &error);
+	if(!seeded) {
+		return error;
+	}
+	const ServerCache& cache = *seeded;
+
+	roster->serverConnectionHandlerID = serverConnectionHandlerID;
+	roster->myID = cache.myID;
+	std::unordered_map<anyID, ClientSlot>::const_iterator self = cache.clients.find(cache.myID);
+	roster->myChannel = (self != cache.clients.end()) ? self->second.channelID : 0;
+
+	roster->channels.clear();
+	roster->channels.reserve(cache.channels.size());
+	for(std::unordered_map<uint64, std::vector<anyID> >::const_iterator ch = cache.channels.begin(); ch != cache.channels.end(); ++ch) {
+		roster->channels.push_back(ch->first);
+	}
+	std::sort(roster->channels.begin(), roster->channels.end());
+
+	roster->offsets.clear();
+	roster->offsets.reserve(roster->channels.size() + 1);
+	roster->clients.clear();
+	roster->clients.reserve(cache.clients.size());
+	for(size_t i = 0; i < roster->channels.size(); i++) {
+		const std::vector<anyID>& members = cache.channels.find(roster->channels[i])->second;
+		roster->offsets.push_back(roster->clients.size());
+		roster->clients.insert(roster->clients.end(), members.begin(), members.end());
+	}
+	roster->offsets.push_back(roster->clients.size());
+
+	return ERROR_ok;
+}
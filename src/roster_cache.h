@@ -0,0 +1,42 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef ROSTER_CACHE_H
+#define ROSTER_CACHE_H
+
+#include <vector>
+#include "teamspeak/public_definitions.h"
+#include "roster.h"
+
+/*
+ * Per server connection client/channel cache, kept up to date by the clientlib callbacks so mass actions
+ * never have to walk the client lib. A connection is seeded from the client lib once, either when it is
+ * established or on the first snapshot, without blocking the callbacks, and every event after that costs O(1).
+ */
+
+/* Seeds the cache of a freshly established connection */
+void rosterCacheSeed(uint64 serverConnectionHandlerID);
+
+/* Forgets everything about a connection, called on disconnect */
+void rosterCacheDrop(uint64 serverConnectionHandlerID);
+
+/* Forgets every connection, called on shutdown */
+void rosterCacheClear();
+
+/* A client entered, moved within or left our view. newChannelID 0 or LEAVE_VISIBILITY removes it. */
+void rosterCacheClientMoved(uint64 serverConnectionHandlerID, anyID clientID, uint64 newChannelID, int visibility);
+
+void rosterCacheChannelAdded(uint64 serverConnectionHandlerID, uint64 channelID);
+void rosterCacheChannelDeleted(uint64 serverConnectionHandlerID, uint64 channelID);
+
+/* Fills roster from the cache of a connection, seeding it first if needed */
+unsigned int rosterCacheSnapshot(uint64 serverConnectionHandlerID, struct Roster* roster);
+
+/* Point lookups for callers that only need one channel, both seed the cache if needed */
+unsigned int rosterCacheSelf(uint64 serverConnectionHandlerID, anyID* myID, uint64* myChannel);
+unsigned int rosterCacheChannelMembers(uint64 serverConnectionHandlerID, uint64 channelID, std::vector<anyID>* members);
+
+#endif
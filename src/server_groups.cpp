@@ -0,0 +1,35 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "teamspeak/public_definitions.h"
+#include "dispatcher.h"
+#include "collector.h"
+#include "server_groups.h"
+
+static ReplyCollector<uint64, std::vector<uint64> > memberLists;  /* Per server group */
+
+int serverGroupMembers(uint64 serverConnectionHandlerID, uint64 groupID, uint64 cancelGeneration, std::vector<uint64>* members) {
+	char name[64];
+	snprintf(name, sizeof(name), "Ask the server for the members of server group %llu", (long long unsigned int)groupID);
+	size_t failed = 0;
+	const int answered = memberLists.ask(serverConnectionHandlerID, std::vector<uint64>(1, groupID), name, cancelGeneration, [&](uint64 batchID, uint64 group) {
+		dispatchListGroupMembers(serverConnectionHandlerID, batchID, group);
+	}, &failed);
+
+	memberLists.take(serverConnectionHandlerID, groupID, members);
+	std::sort(members->begin(), members->end());
+	members->erase(std::unique(members->begin(), members->end()), members->end());
+	return answered && !failed;
+}
+
+void serverGroupsOnClientListEntry(uint64 serverConnectionHandlerID, uint64 groupID, uint64 clientDatabaseID) {
+	memberLists.update(serverConnectionHandlerID, groupID, [&](std::vector<uint64>& members) {
+		members.push_back(clientDatabaseID);
+	});
+}
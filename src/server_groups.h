@@ -0,0 +1,29 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef SERVER_GROUPS_H
+#define SERVER_GROUPS_H
+
+#include <vector>
+#include "teamspeak/public_definitions.h"
+
+/*
+ * Server group membership as the server has it. The client lib only knows the groups of clients online and
+ * in view, the full member list of a group is asked for with one request and arrives as one
+ * onServerGroupClientListEvent per member before the answer to it.
+ */
+
+/*
+ * Fills members with the sorted database IDs in a server group, including users offline. Returns 0 if the server
+ * refused the listing, e.g. for lack of permission, it was aborted since cancelGeneration or the connection
+ * dropped. Runs on the worker thread.
+ */
+int serverGroupMembers(uint64 serverConnectionHandlerID, uint64 groupID, uint64 cancelGeneration, std::vector<uint64>* members);
+
+/* onServerGroupClientListEvent, adds the member to a list serverGroupMembers is waiting for */
+void serverGroupsOnClientListEntry(uint64 serverConnectionHandlerID, uint64 groupID, uint64 clientDatabaseID);
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <stdio.h>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_definitions.h"
+#include "teamspeak/public_rare_definitions.h"
+#include "ts3_functions.h"
+#include "globals.h"
+#include "ts3_buffer.h"
+#include "dispatcher.h"
+#include "subscriptions.h"
+
+#define SUBSCRIBE_TIMEOUT_MS 10000
+
+static std::mutex subscribeMutex;
+static std::condition_variable subscribeFinished;
+static std::map<uint64, unsigned int> finishedCount;  /* Subscribe finished events seen per connection */
+
+/* Asks for the channels in ticket->added, clearing it if the request could not be sent */
+static unsigned int requestSubscribe(struct SubscribeTicket* ticket) {
+	if(ticket->added.empty()) {
+		return ERROR_ok;
+	}
+
+	/* Counted before asking, so an answer that beats us to the wait is not missed */
+	{
+		std::lock_guard<std::mutex> lock(subscribeMutex);
+		ticket->seen = finishedCount[ticket->serverConnectionHandlerID];
+	}
+	ticket->deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SUBSCRIBE_TIMEOUT_MS);
+
+	ticket->added.push_back(0);  /* Zero-terminated for the client lib */
+	unsigned int error = ts3Functions.requestChannelSubscribe(ticket->serverConnectionHandlerID, ticket->added.data(), NULL);
+	ticket->added.pop_back();
+	if(error != ERROR_ok) {
+		ticket->added.clear();
+	}
+	return error;
+}
+
+unsigned int subscribeMissingChannels(uint64 serverConnectionHandlerID, struct SubscribeTicket* ticket) {
+	ticket->serverConnectionHandlerID = serverConnectionHandlerID;
+	ticket->added.clear();
+
+	Ts3Buffer<uint64> channelList;
+	unsigned int error;
+	if((error = ts3Functions.getChannelList(serverConnectionHandlerID, channelList.out())) != ERROR_ok) {
+		return error;
+	}
+	for(size_t c = 0; c < channelList.size(); c++) {
+		int subscribed;
+		if(ts3Functions.getChannelVariableAsInt(serverConnectionHandlerID, channelList[c], CHANNEL_FLAG_ARE_SUBSCRIBED, &subscribed) == ERROR_ok && !subscribed) {
+			ticket->added.push_back(channelList[c]);
+		}
+	}
+	return requestSubscribe(ticket);
+}
+
+unsigned int subscribeChannel(uint64 serverConnectionHandlerID, uint64 channelID, struct SubscribeTicket* ticket) {
+	ticket->serverConnectionHandlerID = serverConnectionHandlerID;
+	ticket->added.clear();
+
+	int subscribed;
+	unsigned int error;
+	if((error = ts3Functions.getChannelVariableAsInt(serverConnectionHandlerID, channelID, CHANNEL_FLAG_ARE_SUBSCRIBED, &subscribed)) != ERROR_ok) {
+		return error;
+	}
+	if(!subscribed) {
+		ticket->added.push_back(channelID);
+	}
+	return requestSubscribe(ticket);
+}
+
+/* Asks the client lib, not the events: a subscribe finished event may as well answer someone else's request */
+static int allSubscribed(const struct SubscribeTicket& ticket) {
+	for(size_t c = 0; c < ticket.added.size(); c++) {
+		int subscribed;
+		if(ts3Functions.getChannelVariableAsInt(ticket.serverConnectionHandlerID, ticket.added[c], CHANNEL_FLAG_ARE_SUBSCRIBED, &subscribed) == ERROR_ok && !subscribed) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int waitForSubscriptions(const struct SubscribeTicket& ticket, uint64 cancelGeneration) {
+	if(ticket.added.empty()) {
+		return 1;
+	}
+
+	unsigned int seen = ticket.seen;
+	for(;;) {
+		/* The client lib is asked unlocked, an event arriving meanwhile is counted and wakes the wait at once */
+		if(allSubscribed(ticket)) {
+			return 1;
+		}
+		std::unique_lock<std::mutex> lock(subscribeMutex);
+		if(!subscribeFinished.wait_until(lock, ticket.deadline, [&]() { return finishedCount[ticket.serverConnectionHandlerID] != seen || dispatchCancelGeneration() != cancelGeneration; })) {
+			printf("PLUGIN: subscriptions: %llu did not finish subscribing %u channels in time\n", (long long unsigned int)ticket.serverConnectionHandlerID, (unsigned int)ticket.added.size());
+			return 0;
+		}
+		if(dispatchCancelGeneration() != cancelGeneration) {
+			return 0;
+		}
+		seen = finishedCount[ticket.serverConnectionHandlerID];
+	}
+}
+
+void restoreSubscriptions(const struct SubscribeTicket& ticket) {
+	if(ticket.added.empty()) {
+		return;
+	}
+
+	std::vector<uint64> channels(ticket.added);
+	channels.push_back(0);
+	ts3Functions.requestChannelUnsubscribe(ticket.serverConnectionHandlerID, channels.data(), NULL);
+}
+
+void subscriptionsOnFinished(uint64 serverConnectionHandlerID) {
+	{
+		std::lock_guard<std::mutex> lock(subscribeMutex);
+		finishedCount[serverConnectionHandlerID]++;
+	}
+	subscribeFinished.notify_all();
+}
+
+void subscriptionsOnCancel() {
+	/* Notified under the lock, so a wait that just found the generation unchanged cannot miss it */
+	std::lock_guard<std::mutex> lock(subscribeMutex);
+	subscribeFinished.notify_all();
+}
@@ -0,0 +1,49 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef SUBSCRIPTIONS_H
+#define SUBSCRIPTIONS_H
+
+#include <chrono>
+#include <vector>
+#include "teamspeak/public_definitions.h"
+
+/*
+ * The client lib only knows the clients of channels we are subscribed to. Server-wide actions subscribe to
+ * every missing channel with one request, wait until the server sent their clients and unsubscribe again
+ * afterwards, so the rest of the time we only pay for the channels the user chose.
+ */
+
+struct SubscribeTicket {
+	uint64 serverConnectionHandlerID;
+	std::vector<uint64> added;  /* Channels we subscribed to, empty if nothing had to be done */
+	unsigned int seen;          /* Subscribe finished events counted before asking */
+	std::chrono::steady_clock::time_point deadline;
+};
+
+/* Subscribes to every channel we are not subscribed to. Does not wait, so several servers can be asked at once. */
+unsigned int subscribeMissingChannels(uint64 serverConnectionHandlerID, struct SubscribeTicket* ticket);
+
+/* Subscribes to one channel if we are not already, for actions on the channel a menu was opened on */
+unsigned int subscribeChannel(uint64 serverConnectionHandlerID, uint64 channelID, struct SubscribeTicket* ticket);
+
+/*
+ * Blocks until every added channel is subscribed, so the server sent its clients. Returns 0 if that did not
+ * happen in time, the clients known are then only part of the server, or if dispatcherCancelAll was called
+ * since dispatchCancelGeneration returned cancelGeneration. Must not be called from the GUI thread.
+ */
+int waitForSubscriptions(const struct SubscribeTicket& ticket, uint64 cancelGeneration);
+
+/* Unsubscribes the channels added by subscribeMissingChannels or subscribeChannel */
+void restoreSubscriptions(const struct SubscribeTicket& ticket);
+
+/* Wakes the waits after dispatcherCancelAll, so they return at once instead of at their deadline */
+void subscriptionsOnCancel();
+
+/* Called from ts3plugin_onChannelSubscribeFinishedEvent */
+void subscriptionsOnFinished(uint64 serverConnectionHandlerID);
+
+#endif
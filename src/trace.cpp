@@ -0,0 +1,258 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_definitions.h"
+#include "ts3_functions.h"
+#include "globals.h"
+#include "trace.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define TRACE_EVENT_BUFSIZE 512
+#define TRACE_TID_WORKER     1  /* Rows of the timeline, the process is the server connection */
+#define TRACE_TID_DISPATCHER 2
+
+struct Timeline {
+	uint64 serverConnectionHandlerID;
+	std::string name;
+	time_t startedAt;
+	std::vector<std::string> events;  /* Formatted JSON objects */
+};
+
+static std::mutex traceMutex;
+static std::atomic<int> enabled(0);
+static std::atomic<int> recording(0);  /* Open timelines, untraced calls return without locking while 0 */
+static std::map<uint64, Timeline> timelines;
+static Clock::time_point epoch;  /* Timestamps of all timelines count from when recording was enabled */
+
+static double micros(Clock::time_point at) {
+	return std::chrono::duration<double, std::micro>(at - epoch).count();
+}
+
+static std::string jsonEscape(const char* text) {
+	std::string escaped;
+	for(const char* c = text; *c; c++) {
+		if(*c == '"' || *c == '\\') {
+			escaped += '\\';
+		}
+		if((unsigned char)*c >= 0x20) {
+			escaped += *c;
+		}
+	}
+	return escaped;
+}
+
+static void append(Timeline& timeline, const char* format, ...) {
+	char event[TRACE_EVENT_BUFSIZE];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(event, sizeof(event), format, args);
+	va_end(args);
+	timeline.events.push_back(event);
+}
+
+/* Caller holds traceMutex */
+static Timeline* findTimeline(uint64 batchID) {
+	std::map<uint64, Timeline>::iterator it = timelines.find(batchID);
+	return it != timelines.end() ? &it->second : NULL;
+}
+
+static const char* verbName(enum RequestVerb verb) {
+	switch(verb) {
+		case VERB_MOVE:
+			return "move";
+		case VERB_KICK_FROM_CHANNEL:
+			return "kick from channel";
+		case VERB_KICK_FROM_SERVER:
+			return "kick from server";
+		case VERB_SET_IS_TALKER:
+			return "set talker";
+		case VERB_DELETE_CHANNEL:
+			return "delete channel";
+		case VERB_REQUEST_VARIABLES:
+			return "request variables";
+		case VERB_LIST_GROUP_MEMBERS:
+			return "list group members";
+		case VERB_ADD_TO_GROUP:
+			return "add to group";
+		case VERB_REMOVE_FROM_GROUP:
+			return "remove from group";
+		case VERB_SET_CHANNEL_GROUPS:
+			return "set channel groups";
+		case VERB_LIST_CHANNEL_PERMISSIONS:
+			return "list channel permissions";
+		case VERB_ADD_CHANNEL_PERMISSIONS:
+			return "add channel permissions";
+		case VERB_DELETE_CHANNEL_PERMISSIONS:
+			return "delete channel permissions";
+		case VERB_REQUEST_CONNECTION_INFO:
+			return "request connection info";
+		case VERB_BAN_ADDRESS:
+			return "ban address";
+		case VERB_BAN_CLIENT:
+			return "ban client";
+	}
+	return "request";
+}
+
+void traceSetEnabled(int enable) {
+	std::lock_guard<std::mutex> lock(traceMutex);
+	if(enable && !enabled.load() && timelines.empty()) {
+		epoch = Clock::now();
+	}
+	enabled.store(enable ? 1 : 0);
+}
+
+int traceEnabled() {
+	return enabled.load();
+}
+
+void traceBegin(uint64 batchID, uint64 serverConnectionHandlerID, const char* name) {
+	if(!enabled.load()) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(traceMutex);
+	Timeline& timeline = timelines[batchID];
+	timeline.serverConnectionHandlerID = serverConnectionHandlerID;
+	timeline.name = name;
+	timeline.startedAt = time(NULL);
+	recording.store((int)timelines.size());
+
+	const long long unsigned int pid = (long long unsigned int)serverConnectionHandlerID;
+	append(timeline, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%llu,\"args\":{\"name\":\"%s (server %llu)\"}}", pid, jsonEscape(name).c_str(), pid);
+	append(timeline, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%llu,\"tid\":%d,\"args\":{\"name\":\"worker\"}}", pid, TRACE_TID_WORKER);
+	append(timeline, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%llu,\"tid\":%d,\"args\":{\"name\":\"dispatcher\"}}", pid, TRACE_TID_DISPATCHER);
+}
+
+void tracePhase(uint64 batchID, const char* name, Clock::time_point started, Clock::time_point ended) {
+	if(!recording.load()) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(traceMutex);
+	Timeline* timeline = findTimeline(batchID);
+	if(!timeline) {
+		return;
+	}
+	append(*timeline, "{\"name\":\"%s\",\"cat\":\"action\",\"ph\":\"X\",\"ts\":%.1f,\"dur\":%.1f,\"pid\":%llu,\"tid\":%d}",
+		name, micros(started), std::chrono::duration<double, std::micro>(ended - started).count(),
+		(long long unsigned int)timeline->serverConnectionHandlerID, TRACE_TID_WORKER);
+}
+
+void traceRequestSent(const char* returnCode, const struct Request& request, int attempt, double queuedSeconds) {
+	if(!recording.load()) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(traceMutex);
+	Timeline* timeline = findTimeline(request.batchID);
+	if(!timeline) {
+		return;
+	}
+	append(*timeline, "{\"name\":\"%s\",\"cat\":\"request\",\"ph\":\"b\",\"id\":\"%s\",\"ts\":%.1f,\"pid\":%llu,\"tid\":%d,"
+		"\"args\":{\"client\":%u,\"channel\":%llu,\"attempt\":%d,\"queued ms\":%.1f}}",
+		verbName(request.verb), jsonEscape(returnCode).c_str(), micros(Clock::now()), (long long unsigned int)timeline->serverConnectionHandlerID, TRACE_TID_DISPATCHER,
+		(unsigned int)request.clientID, (long long unsigned int)request.channelID, attempt, 1e3 * queuedSeconds);
+}
+
+void traceRequestAnswered(const char* returnCode, const struct Request& request, unsigned int error, int local) {
+	if(!recording.load()) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(traceMutex);
+	Timeline* timeline = findTimeline(request.batchID);
+	if(!timeline) {
+		return;
+	}
+	const char* result = (error == ERROR_ok) ? "ok" : (error == ERROR_client_is_flooding ? "flooded" : "failed");
+	append(*timeline, "{\"name\":\"%s\",\"cat\":\"request\",\"ph\":\"e\",\"id\":\"%s\",\"ts\":%.1f,\"pid\":%llu,\"tid\":%d,"
+		"\"args\":{\"result\":\"%s%s\",\"error\":%u}}",
+		verbName(request.verb), jsonEscape(returnCode).c_str(), micros(Clock::now()), (long long unsigned int)timeline->serverConnectionHandlerID, TRACE_TID_DISPATCHER,
+		result, local ? " locally" : "", error);
+}
+
+void traceBackoff(uint64 batchID, int pauseMs, double newRate) {
+	if(!recording.load()) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(traceMutex);
+	Timeline* timeline = findTimeline(batchID);
+	if(!timeline) {
+		return;
+	}
+	append(*timeline, "{\"name\":\"flood pause\",\"cat\":\"dispatch\",\"ph\":\"X\",\"ts\":%.1f,\"dur\":%d,\"pid\":%llu,\"tid\":%d,\"args\":{\"rate now\":%.1f}}",
+		micros(Clock::now()), pauseMs * 1000, (long long unsigned int)timeline->serverConnectionHandlerID, TRACE_TID_DISPATCHER, newRate);
+}
+
+void traceCounters(uint64 batchID, double rate, size_t inFlight, size_t queued) {
+	if(!recording.load()) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(traceMutex);
+	Timeline* timeline = findTimeline(batchID);
+	if(!timeline) {
+		return;
+	}
+	const double ts = micros(Clock::now());
+	const long long unsigned int pid = (long long unsigned int)timeline->serverConnectionHandlerID;
+	append(*timeline, "{\"name\":\"dispatch rate\",\"ph\":\"C\",\"ts\":%.1f,\"pid\":%llu,\"args\":{\"requests/s\":%.2f}}", ts, pid, rate);
+	append(*timeline, "{\"name\":\"requests\",\"ph\":\"C\",\"ts\":%.1f,\"pid\":%llu,\"args\":{\"in flight\":%u,\"queued\":%u}}", ts, pid, (unsigned int)inFlight, (unsigned int)queued);
+}
+
+void traceFinish(uint64 batchID) {
+	Timeline timeline;
+	{
+		std::lock_guard<std::mutex> lock(traceMutex);
+		std::map<uint64, Timeline>::iterator it = timelines.find(batchID);
+		if(it == timelines.end()) {
+			return;
+		}
+		timeline.serverConnectionHandlerID = it->second.serverConnectionHandlerID;
+		timeline.name.swap(it->second.name);
+		timeline.startedAt = it->second.startedAt;
+		timeline.events.swap(it->second.events);
+		timelines.erase(it);
+		recording.store((int)timelines.size());
+	}
+
+	char configPath[PATH_BUFSIZE];
+	ts3Functions.getConfigPath(configPath, PATH_BUFSIZE);
+	char stamp[32];
+	strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&timeline.startedAt));
+	char path[PATH_BUFSIZE + 64];
+	snprintf(path, sizeof(path), "%smass_actions_trace_%s_%llu.json", configPath, stamp, (long long unsigned int)batchID);
+
+	char message[PATH_BUFSIZE + 128];
+	FILE* file = fopen(path, "w");
+	if(!file) {
+		snprintf(message, sizeof(message), "[b]Mass actions:[/b] could not write the timeline of %s to %s", timeline.name.c_str(), path);
+		ts3Functions.printMessage(timeline.serverConnectionHandlerID, message, PLUGIN_MESSAGE_TARGET_SERVER);
+		return;
+	}
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+	for(size_t i = 0; i < timeline.events.size(); i++) {
+		fputs(timeline.events[i].c_str(), file);
+		fputs(i + 1 < timeline.events.size() ? ",\n" : "\n", file);
+	}
+	fputs("]}\n", file);
+	fclose(file);
+
+	snprintf(message, sizeof(message), "[b]Mass actions:[/b] timeline of %s written to %s", timeline.name.c_str(), path);
+	ts3Functions.printMessage(timeline.serverConnectionHandlerID, message, PLUGIN_MESSAGE_TARGET_SERVER);
+}
+
+void traceClear() {
+	std::lock_guard<std::mutex> lock(traceMutex);
+	timelines.clear();
+	recording.store(0);
+}
@@ -0,0 +1,47 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include "teamspeak/public_definitions.h"
+#include "dispatcher.h"
+
+/*
+ * Timelines of mass actions in Chrome's trace event format, for chrome://tracing or Perfetto. While recording
+ * is enabled every new batch gets a timeline: the phases of the action on the worker row, every request from
+ * send to answer as its own span, flood pauses, and counters for the dispatch rate and the queue. When the
+ * batch is done the timeline is written to the config path and its file name printed to the server tab.
+ *
+ * Everything here is a no-op for batches without a timeline, so the calls can stay in the hot paths.
+ */
+
+void traceSetEnabled(int enabled);
+int traceEnabled();
+
+/* Starts a timeline for the batch if recording is enabled */
+void traceBegin(uint64 batchID, uint64 serverConnectionHandlerID, const char* name);
+
+/* A phase of the action on the worker thread */
+void tracePhase(uint64 batchID, const char* name, std::chrono::steady_clock::time_point started, std::chrono::steady_clock::time_point ended);
+
+/* attempt counts from 0, queuedSeconds is the wait since the request was first queued */
+void traceRequestSent(const char* returnCode, const struct Request& request, int attempt, double queuedSeconds);
+void traceRequestAnswered(const char* returnCode, const struct Request& request, unsigned int error, int local);
+
+/* The dispatcher paused the connection after a flood error */
+void traceBackoff(uint64 batchID, int pauseMs, double newRate);
+
+void traceCounters(uint64 batchID, double rate, size_t inFlight, size_t queued);
+
+/* Writes and drops the timeline of a finished or dropped batch */
+void traceFinish(uint64 batchID);
+
+/* Drops every timeline without writing it, on shutdown */
+void traceClear();
+
+#endif
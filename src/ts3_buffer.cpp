@@ -0,0 +1,47 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <atomic>
+#include "ts3_buffer.h"
+
+static std::atomic<size_t> liveBuffers(0);
+static std::atomic<size_t> liveBytes(0);
+static std::atomic<size_t> peakBytes(0);
+static std::atomic<size_t> actionPeakBytes(0);
+static std::atomic<size_t> totalBuffers(0);
+
+static void raisePeak(std::atomic<size_t>& peak, size_t bytes) {
+	size_t current = peak.load();
+	while(bytes > current && !peak.compare_exchange_weak(current, bytes)) {
+	}
+}
+
+void ts3BufferAcquired(size_t bytes) {
+	const size_t live = liveBytes.fetch_add(bytes) + bytes;
+	liveBuffers++;
+	totalBuffers++;
+	raisePeak(peakBytes, live);
+	raisePeak(actionPeakBytes, live);
+}
+
+void ts3BufferReleased(size_t bytes) {
+	liveBytes.fetch_sub(bytes);
+	liveBuffers--;
+}
+
+void ts3BufferResetActionPeak() {
+	actionPeakBytes.store(liveBytes.load());
+}
+
+struct Ts3BufferStats ts3BufferStats() {
+	struct Ts3BufferStats stats;
+	stats.liveBuffers = liveBuffers.load();
+	stats.liveBytes = liveBytes.load();
+	stats.peakBytes = peakBytes.load();
+	stats.actionPeakBytes = actionPeakBytes.load();
+	stats.totalBuffers = totalBuffers.load();
+	return stats;
+}
@@ -0,0 +1,87 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef TS3_BUFFER_H
+#define TS3_BUFFER_H
+
+#include <stddef.h>
+#include "globals.h"
+
+/*
+ * Ownership of buffers the client lib allocates for us (client/channel lists, strings). Every buffer is
+ * released with ts3Functions.freeMemory when its owner goes out of scope, and counted while it is alive so
+ * the info panel can show live and peak usage.
+ */
+
+struct Ts3BufferStats {
+	size_t liveBuffers;
+	size_t liveBytes;
+	size_t peakBytes;        /* Since the plugin was loaded */
+	size_t actionPeakBytes;  /* Since the last call to ts3BufferResetActionPeak */
+	size_t totalBuffers;
+};
+
+void ts3BufferAcquired(size_t bytes);
+void ts3BufferReleased(size_t bytes);
+void ts3BufferResetActionPeak();
+struct Ts3BufferStats ts3BufferStats();
+
+/* Zero-terminated client lib buffer: anyID and uint64 lists, or char for strings */
+template<typename T>
+class Ts3Buffer {
+public:
+	/* Out parameter for the client lib call. Ownership is taken once the call has returned. */
+	class OutParam {
+	public:
+		explicit OutParam(Ts3Buffer* owner) : owner(owner) {}
+		OutParam(OutParam&& other) : owner(other.owner) { other.owner = NULL; }
+		~OutParam() { if(owner) owner->adopt(); }
+		operator T**() const { return &owner->data; }
+	private:
+		OutParam(const OutParam&);
+		OutParam& operator=(const OutParam&);
+		Ts3Buffer* owner;
+	};
+
+	Ts3Buffer() : data(NULL), count(0) {}
+	~Ts3Buffer() { reset(); }
+
+	OutParam out() {
+		reset();
+		return OutParam(this);
+	}
+
+	void reset() {
+		if(data) {
+			ts3Functions.freeMemory(data);
+			ts3BufferReleased((count + 1) * sizeof(T));
+		}
+		data = NULL;
+		count = 0;
+	}
+
+	T* get() const { return data; }
+	T& operator[](size_t i) const { return data[i]; }
+	size_t size() const { return count; }  /* Without the terminator */
+
+private:
+	Ts3Buffer(const Ts3Buffer&);
+	Ts3Buffer& operator=(const Ts3Buffer&);
+
+	void adopt() {
+		if(!data) {
+			return;  /* Call failed and left the pointer alone */
+		}
+		for(count = 0; data[count]; count++) {
+		}
+		ts3BufferAcquired((count + 1) * sizeof(T));
+	}
+
+	T* data;
+	size_t count;
+};
+
+#endif
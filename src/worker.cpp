@@ -0,0 +1,74 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "worker.h"
+
+static std::mutex workerMutex;
+static std::condition_variable workerWake;
+static std::deque<WorkerJob> workerJobs;
+static std::thread workerThread;
+static bool workerRunning = false;
+
+static void workerLoop() {
+	std::unique_lock<std::mutex> lock(workerMutex);
+	while(true) {
+		workerWake.wait(lock, []() { return !workerRunning || !workerJobs.empty(); });
+		if(!workerRunning) {
+			return;
+		}
+
+		WorkerJob job = workerJobs.front();
+		workerJobs.pop_front();
+
+		lock.unlock();
+		job();
+		lock.lock();
+	}
+}
+
+void workerStart() {
+	std::lock_guard<std::mutex> lock(workerMutex);
+	if(workerRunning) {
+		return;
+	}
+	workerRunning = true;
+	workerThread = std::thread(workerLoop);
+}
+
+void workerStop() {
+	{
+		std::lock_guard<std::mutex> lock(workerMutex);
+		if(!workerRunning) {
+			return;
+		}
+		workerRunning = false;
+		workerJobs.clear();
+	}
+	workerWake.notify_all();
+	workerThread.join();
+}
+
+void workerPost(const WorkerJob& job) {
+	{
+		std::lock_guard<std::mutex> lock(workerMutex);
+		if(!workerRunning) {
+			return;
+		}
+		workerJobs.push_back(job);
+	}
+	workerWake.notify_one();
+}
+
+size_t workerCancel() {
+	std::lock_guard<std::mutex> lock(workerMutex);
+	const size_t canceled = workerJobs.size();
+	workerJobs.clear();
+	return canceled;
+}
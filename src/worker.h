@@ -0,0 +1,30 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <stddef.h>
+#include <functional>
+
+/*
+ * Single background thread running mass-action jobs in the order they were posted, so the Qt GUI thread
+ * only has to enqueue a job and can return immediately.
+ */
+
+typedef std::function<void()> WorkerJob;
+
+void workerStart();
+
+/* Finishes the running job, drops everything still queued and joins the thread */
+void workerStop();
+
+void workerPost(const WorkerJob& job);
+
+/* Drops all jobs that have not started yet, returns how many */
+size_t workerCancel();
+
+#endif
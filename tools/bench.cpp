@@ -0,0 +1,301 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+/*
+ * Runs every menu action against the mock client lib for a matrix of server sizes and channel tree depths
+ * and writes one CSV row per run. The plugin is linked in directly, so the phases of each run can be read
+ * back from actionLastTimings and the dispatcher.
+ *
+ *   mass_actions_bench [--clients 10,100,1000,5000,20000] [--depths 1,5,10] [--out mass_actions_bench.csv] ...
+ *
+ * Dispatch is paced like on a real server, so large runs are cut off after --budget seconds: whatever is
+ * still queued then is canceled and the row says "capped", its request rate is still meaningful.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_definitions.h"
+#include "plugin_definitions.h"
+#include "ts3_functions.h"
+#include "plugin.h"
+#include "actions.h"
+#include "dispatcher.h"
+#include "mock_ts3.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct BenchRun {
+	double seedSeconds;     /* Connect until the roster cache is seeded */
+	double wallSeconds;     /* Menu event until everything dispatched was answered */
+	double dispatchSeconds;
+	struct ActionTimings timings;
+	struct MockStats stats;
+	const char* result;
+};
+
+static double secondsSince(Clock::time_point started) {
+	return std::chrono::duration<double>(Clock::now() - started).count();
+}
+
+/* The plugin's messages would drown the progress output */
+static void onMessage(uint64 serverConnectionHandlerID, const char* message) {
+}
+
+static std::vector<unsigned int> parseList(const char* text) {
+	std::vector<unsigned int> values;
+	for(const char* p = text; *p; ) {
+		values.push_back((unsigned int)strtoul(p, (char**)&p, 10));
+		if(*p == ',') {
+			p++;
+		} else if(*p) {
+			break;
+		}
+	}
+	return values;
+}
+
+/* Section headers, spacers and the session toggles are not actions */
+static bool isAction(const struct ActionDescriptor& action) {
+	return action.run != NULL;
+}
+
+static const struct ActionDescriptor* findGuard(enum ActionGuard guard) {
+	size_t count;
+	const struct ActionDescriptor* actions = actionTable(&count);
+	for(size_t i = 0; i < count; i++) {
+		if(actions[i].guard == guard) {
+			return &actions[i];
+		}
+	}
+	return NULL;
+}
+
+static const char* menuTypeName(enum PluginMenuType type) {
+	switch(type) {
+		case PLUGIN_MENU_TYPE_GLOBAL:
+			return "global";
+		case PLUGIN_MENU_TYPE_CHANNEL:
+			return "channel";
+		case PLUGIN_MENU_TYPE_CLIENT:
+			return "client";
+	}
+	return "?";
+}
+
+/* Quotes a CSV field */
+static std::string csv(const char* text) {
+	std::string quoted = "\"";
+	for(const char* c = text; *c; c++) {
+		if(*c == '"') {
+			quoted += '"';
+		}
+		quoted += *c;
+	}
+	return quoted + "\"";
+}
+
+static struct BenchRun runAction(const struct MockConfig& config, const struct ActionDescriptor& action, double budget) {
+	struct BenchRun run;
+	mockDisconnect();
+	mockStart(config);
+
+	Clock::time_point started = Clock::now();
+	mockConnect();
+	run.seedSeconds = secondsSince(started);
+
+	const struct ActionDescriptor* arm = findGuard(GUARD_ARM);
+	if(arm) {
+		ts3plugin_onMenuItemEvent(1, arm->type, arm->menuID, 0);
+	}
+	const uint64 selected = (action.type == PLUGIN_MENU_TYPE_CHANNEL) ? mockBusyChannel(1) : 0;
+
+	struct ActionTimings before;
+	actionLastTimings(&before);
+	mockResetStats();
+	run.result = "done";
+	started = Clock::now();
+	ts3plugin_onMenuItemEvent(1, action.type, action.menuID, selected);
+
+	bool capped = false;
+	for(;;) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		actionLastTimings(&run.timings);
+		const double elapsed = secondsSince(started);
+		if(run.timings.runs != before.runs && !dispatcherOutstanding() && !mockStats().pending) {
+			break;
+		}
+		if(!capped && elapsed >= budget) {
+			dispatcherCancelAll();
+			capped = true;
+			run.result = "capped";
+		}
+		/* Answers in flight arrive within a round trip of the cut, anything longer is stuck */
+		if(elapsed >= 2 * budget + 10) {
+			run.result = "timeout";
+			break;
+		}
+	}
+
+	run.wallSeconds = secondsSince(started);
+	run.stats = mockStats();
+	run.dispatchSeconds = std::max(0.0, run.wallSeconds - run.timings.subscribeSeconds - run.timings.snapshotSeconds - run.timings.planSeconds);
+	return run;
+}
+
+static void usage(const char* self) {
+	printf("usage: %s [options]\n"
+		"  --clients LIST        server sizes, clients including yourself (10,100,1000,5000,20000)\n"
+		"  --depths LIST         channel tree depths (1,5,10)\n"
+		"  --clients-per-channel N  sets the channel count from the size, at least the depth (10)\n"
+		"  --unsubscribed PCT    channels not subscribed at start (0)\n"
+		"  --latency-us N        cost of every getter call (0)\n"
+		"  --rtt-ms N            round trip of server requests (20)\n"
+		"  --flood-rate R        requests/s the server accepts, 0 = unlimited (0)\n"
+		"  --flood-burst N       anti-flood burst (10)\n"
+		"  --menu TYPE:ID        run only this item, repeatable (every action)\n"
+		"  --budget S            dispatch time per run before the rest is canceled (10)\n"
+		"  --out PATH            CSV output (mass_actions_bench.csv)\n", self);
+}
+
+int main(int argc, char** argv) {
+	struct MockConfig config;
+	mockDefaultConfig(&config);
+	config.freshServerUIDs = 1;  /* Every row starts from the initial rate, not from what the row before it learned */
+	std::vector<unsigned int> sizes = parseList("10,100,1000,5000,20000");
+	std::vector<unsigned int> depths = parseList("1,5,10");
+	unsigned int clientsPerChannel = 10;
+	double budget = 10;
+	std::string outPath = "mass_actions_bench.csv";
+	std::vector<std::string> only;
+
+	for(int i = 1; i < argc; i++) {
+		const std::string option = argv[i];
+		const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+		if(option == "--help" || !value) {
+			usage(argv[0]);
+			return option == "--help" ? 0 : 2;
+		}
+		i++;
+		if(option == "--clients") sizes = parseList(value);
+		else if(option == "--depths") depths = parseList(value);
+		else if(option == "--clients-per-channel") clientsPerChannel = std::max(1, atoi(value));
+		else if(option == "--unsubscribed") config.unsubscribedPercent = (unsigned int)atoi(value);
+		else if(option == "--latency-us") config.callLatencyUs = (unsigned int)atoi(value);
+		else if(option == "--rtt-ms") config.roundTripMs = (unsigned int)atoi(value);
+		else if(option == "--flood-rate") config.floodRate = atof(value);
+		else if(option == "--flood-burst") config.floodBurst = atof(value);
+		else if(option == "--menu") only.push_back(value);
+		else if(option == "--budget") budget = atof(value);
+		else if(option == "--out") outPath = value;
+		else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+
+	FILE* out = fopen(outPath.c_str(), "w");
+	if(!out) {
+		fprintf(stderr, "Cannot write %s\n", outPath.c_str());
+		return 1;
+	}
+	fprintf(out, "clients,channels,depth,menu,action,result,seed_ms,subscribe_ms,snapshot_ms,plan_ms,dispatch_ms,wall_ms,"
+		"ts3_calls,getter_calls,requests,succeeded,failed,flooded,local_calls,requests_per_s\n");
+
+	struct TS3Functions functions;
+	struct MockPluginCallbacks callbacks;
+	callbacks.onConnectStatusChangeEvent = ts3plugin_onConnectStatusChangeEvent;
+	callbacks.onDelChannelEvent = ts3plugin_onDelChannelEvent;
+	callbacks.onClientMoveEvent = ts3plugin_onClientMoveEvent;
+	callbacks.onClientMoveSubscriptionEvent = ts3plugin_onClientMoveSubscriptionEvent;
+	callbacks.onClientMoveMovedEvent = ts3plugin_onClientMoveMovedEvent;
+	callbacks.onClientKickFromChannelEvent = ts3plugin_onClientKickFromChannelEvent;
+	callbacks.onClientKickFromServerEvent = ts3plugin_onClientKickFromServerEvent;
+	callbacks.onServerErrorEvent = ts3plugin_onServerErrorEvent;
+	callbacks.onChannelSubscribeFinishedEvent = ts3plugin_onChannelSubscribeFinishedEvent;
+	callbacks.onUpdateClientEvent = ts3plugin_onUpdateClientEvent;
+	callbacks.onServerGroupClientListEvent = ts3plugin_onServerGroupClientListEvent;
+	callbacks.onServerGroupClientAddedEvent = ts3plugin_onServerGroupClientAddedEvent;
+	callbacks.onServerGroupClientDeletedEvent = ts3plugin_onServerGroupClientDeletedEvent;
+	callbacks.onClientChannelGroupChangedEvent = ts3plugin_onClientChannelGroupChangedEvent;
+	callbacks.onChannelPermListEvent = ts3plugin_onChannelPermListEvent;
+	callbacks.onConnectionInfoEvent = ts3plugin_onConnectionInfoEvent;
+	callbacks.onClientBanFromServerEvent = ts3plugin_onClientBanFromServerEvent;
+	mockInstall(&functions, callbacks, onMessage);
+	mockStart(config);
+	ts3plugin_setFunctionPointers(functions);
+	ts3plugin_registerPluginID("mass_actions_bench");
+	if(ts3plugin_init() != 0) {
+		fprintf(stderr, "Plugin failed to initialize\n");
+		return 1;
+	}
+
+	/* The menus come from the plugin like in the client, the actions behind them from the table */
+	std::vector<const struct ActionDescriptor*> actions;
+	struct PluginMenuItem** menuItems = NULL;
+	char* menuIcon = NULL;
+	ts3plugin_initMenus(&menuItems, &menuIcon);
+	for(size_t i = 0; menuItems && menuItems[i]; i++) {
+		const struct ActionDescriptor* action = actionFind(menuItems[i]->type, menuItems[i]->id);
+		const std::string name = std::string(menuTypeName(menuItems[i]->type)) + ":" + std::to_string(menuItems[i]->id);
+		if(action && isAction(*action) && (only.empty() || std::find(only.begin(), only.end(), name) != only.end())) {
+			actions.push_back(action);
+		}
+		ts3plugin_freeMemory(menuItems[i]);
+	}
+	ts3plugin_freeMemory(menuItems);
+	if(menuIcon) {
+		ts3plugin_freeMemory(menuIcon);
+	}
+
+	int failures = 0;
+	for(size_t s = 0; s < sizes.size(); s++) {
+		for(size_t d = 0; d < depths.size(); d++) {
+			config.clients = sizes[s];
+			config.depth = std::max(1u, depths[d]);
+			config.channels = std::max(config.depth, config.clients / clientsPerChannel);
+			fprintf(stderr, "%u clients, %u channels, depth %u\n", config.clients, config.channels, config.depth);
+
+			for(size_t a = 0; a < actions.size(); a++) {
+				const struct ActionDescriptor& action = *actions[a];
+				const struct BenchRun run = runAction(config, action, budget);
+				const size_t answered = run.stats.succeeded + run.stats.failed + run.stats.flooded;
+				if(!strcmp(run.result, "timeout")) {
+					failures++;
+				}
+
+				fprintf(out, "%u,%u,%u,%s:%d,%s,%s,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%.1f\n",
+					config.clients, config.channels, config.depth, menuTypeName(action.type), action.menuID, csv(action.name).c_str(), run.result,
+					1000 * run.seedSeconds, 1000 * run.timings.subscribeSeconds, 1000 * run.timings.snapshotSeconds, 1000 * run.timings.planSeconds,
+					1000 * run.dispatchSeconds, 1000 * run.wallSeconds,
+					run.stats.getterCalls + run.stats.requests + run.stats.localCalls, run.stats.getterCalls, run.stats.requests,
+					run.stats.succeeded, run.stats.failed, run.stats.flooded, run.stats.localCalls,
+					run.dispatchSeconds > 0 ? answered / run.dispatchSeconds : 0.0);
+				fflush(out);
+				fprintf(stderr, "  %-8s %-50s %10.1f ms  %6zu requests  %s\n", (std::string(menuTypeName(action.type)) + ":" + std::to_string(action.menuID)).c_str(),
+					action.name, 1000 * run.wallSeconds, run.stats.requests, run.result);
+			}
+		}
+	}
+
+	mockDisconnect();
+	ts3plugin_shutdown();
+	mockStop();
+	fclose(out);
+
+	const size_t leaked = mockStats().liveAllocations;
+	if(leaked) {
+		fprintf(stderr, "%zu client lib buffers were never freed\n", leaked);
+		failures++;
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,412 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+/*
+ * Loads the plugin like the TeamSpeak client does, hands it the mock client lib and fires its menu items one
+ * after another against freshly built servers. Prints one line per action with what reached the server and
+ * how long it took until the plugin reported the action done. Chat commands can be run the same way.
+ *
+ *   mass_actions_driver [--plugin ./test_plugin.so] [--clients 500] [--channels 50] [--depth 3] ...
+ */
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_definitions.h"
+#include "plugin_definitions.h"
+#include "ts3_functions.h"
+#include "mock_ts3.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct MenuEntry {
+	enum PluginMenuType type;
+	int id;
+	std::string text;
+	bool isCommand;  /* text is typed as "/mass <text>" instead of clicking a menu item */
+};
+
+struct PluginExports {
+	void (*setFunctionPointers)(const struct TS3Functions funcs);
+	void (*registerPluginID)(const char* id);
+	int (*init)();
+	void (*shutdown)();
+	void (*initMenus)(struct PluginMenuItem*** menuItems, char** menuIcon);
+	void (*freeMemory)(void* data);
+	void (*onMenuItemEvent)(uint64 serverConnectionHandlerID, enum PluginMenuType type, int menuItemID, uint64 selectedItemID);
+	void (*infoData)(uint64 serverConnectionHandlerID, uint64 id, enum PluginItemType type, char** data);
+	int (*processCommand)(uint64 serverConnectionHandlerID, const char* command);
+};
+
+static std::mutex outputMutex;
+static std::atomic<size_t> finalReports(0);
+static bool verbose = false;
+
+/* The dispatcher prints "<action> finished, ..." or "<action> aborted, ..." once a batch is answered completely */
+static void onMessage(uint64 serverConnectionHandlerID, const char* message) {
+	if(strstr(message, " finished, ") || strstr(message, " aborted, ")) {
+		finalReports++;
+	}
+	if(verbose) {
+		std::lock_guard<std::mutex> lock(outputMutex);
+		printf("  [%llu] %s\n", (long long unsigned int)serverConnectionHandlerID, message);
+	}
+}
+
+template<typename T>
+static bool resolve(void* library, const char* name, T* function) {
+	*function = (T)dlsym(library, name);
+	return *function != NULL;
+}
+
+static const char* menuTypeName(enum PluginMenuType type) {
+	switch(type) {
+		case PLUGIN_MENU_TYPE_GLOBAL:
+			return "global";
+		case PLUGIN_MENU_TYPE_CHANNEL:
+			return "channel";
+		case PLUGIN_MENU_TYPE_CLIENT:
+			return "client";
+	}
+	return "?";
+}
+
+/* "global:12", "channel:3" or "client:1" */
+static bool parseMenu(const char* text, struct MenuEntry* entry) {
+	const char* colon = strchr(text, ':');
+	if(!colon) {
+		return false;
+	}
+	const std::string type(text, colon - text);
+	if(type == "global") {
+		entry->type = PLUGIN_MENU_TYPE_GLOBAL;
+	} else if(type == "channel") {
+		entry->type = PLUGIN_MENU_TYPE_CHANNEL;
+	} else if(type == "client") {
+		entry->type = PLUGIN_MENU_TYPE_CLIENT;
+	} else {
+		return false;
+	}
+	entry->id = atoi(colon + 1);
+	entry->isCommand = false;
+	return true;
+}
+
+/* Section headers and spacers do nothing, the toggles are fired on request before every action */
+static bool isAction(const struct MenuEntry& entry) {
+	return !entry.text.empty() && entry.text[0] != '[' && entry.text[0] != '=' &&
+		entry.text != "ACTIVATE FOR THIS SESSION" && entry.text != "DEACTIVATE FOR THIS SESSION" &&
+		entry.text != "Run on all connections" && entry.text != "Run on this connection only" &&
+		entry.text != "Time client lib calls" && entry.text != "Stop timing client lib calls" &&
+		entry.text != "Record timelines" && entry.text != "Stop recording timelines";
+}
+
+static const struct MenuEntry* findMenu(const std::vector<struct MenuEntry>& menus, const char* text) {
+	for(size_t i = 0; i < menus.size(); i++) {
+		if(menus[i].text == text) {
+			return &menus[i];
+		}
+	}
+	return NULL;
+}
+
+static void usage(const char* self) {
+	printf("usage: %s [options]\n"
+		"  --plugin PATH         plugin to load (./test_plugin.so)\n"
+		"  --connections N       server tabs (1)\n"
+		"  --clients N           clients per server, including yourself (100)\n"
+		"  --channels N          channels per server (20)\n"
+		"  --depth N             levels of the channel tree (1)\n"
+		"  --unsubscribed PCT    channels not subscribed at start (0)\n"
+		"  --latency-us N        cost of every getter call (0)\n"
+		"  --rtt-ms N            round trip of server requests (20)\n"
+		"  --flood-rate R        requests/s the server accepts, 0 = unlimited (0)\n"
+		"  --flood-burst N       anti-flood burst (10)\n"
+		"  --fresh-servers       new server unique IDs per action, so no learned request rate carries over\n"
+		"  --channel ID          selected channel for channel menu items (busiest other channel)\n"
+		"  --client ID           selected client for client menu items (2)\n"
+		"  --menu TYPE:ID        run only this item, repeatable (every action)\n"
+		"  --command TEXT        run the chat command /mass TEXT, repeatable\n"
+		"  --arm                 activate the destructive items first\n"
+		"  --all-connections     run global items on every connection\n"
+		"  --time-calls          time client lib calls, needs --info to see them\n"
+		"  --trace               record a timeline of every action in the current directory\n"
+		"  --info                print the server info panel after every action\n"
+		"  --timeout S           per action (60)\n"
+		"  --linger S            stay connected S more seconds after an action, for timers like the AFK sweeper (0)\n"
+		"  --verbose             echo the plugin's messages\n", self);
+}
+
+int main(int argc, char** argv) {
+	struct MockConfig config;
+	mockDefaultConfig(&config);
+	std::string pluginPath = "./test_plugin.so";
+	std::vector<struct MenuEntry> only;
+	uint64 selectedChannel = 0;
+	anyID selectedClient = 2;
+	bool arm = false;
+	bool allConnections = false;
+	bool timeCalls = false;
+	bool info = false;
+	bool trace = false;
+	double timeout = 60;
+	double linger = 0;
+
+	for(int i = 1; i < argc; i++) {
+		const std::string option = argv[i];
+		const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+		if(option == "--arm") {
+			arm = true;
+		} else if(option == "--all-connections") {
+			allConnections = true;
+		} else if(option == "--time-calls") {
+			timeCalls = true;
+		} else if(option == "--trace") {
+			trace = true;
+		} else if(option == "--info") {
+			info = true;
+		} else if(option == "--verbose") {
+			verbose = true;
+		} else if(option == "--fresh-servers") {
+			config.freshServerUIDs = 1;
+		} else if(option == "--help" || !value) {
+			usage(argv[0]);
+			return option == "--help" ? 0 : 2;
+		} else {
+			i++;
+			if(option == "--plugin") pluginPath = value;
+			else if(option == "--connections") config.connections = (unsigned int)atoi(value);
+			else if(option == "--clients") config.clients = (unsigned int)atoi(value);
+			else if(option == "--channels") config.channels = (unsigned int)atoi(value);
+			else if(option == "--depth") config.depth = (unsigned int)atoi(value);
+			else if(option == "--unsubscribed") config.unsubscribedPercent = (unsigned int)atoi(value);
+			else if(option == "--latency-us") config.callLatencyUs = (unsigned int)atoi(value);
+			else if(option == "--rtt-ms") config.roundTripMs = (unsigned int)atoi(value);
+			else if(option == "--flood-rate") config.floodRate = atof(value);
+			else if(option == "--flood-burst") config.floodBurst = atof(value);
+			else if(option == "--channel") selectedChannel = strtoull(value, NULL, 10);
+			else if(option == "--client") selectedClient = (anyID)atoi(value);
+			else if(option == "--timeout") timeout = atof(value);
+			else if(option == "--linger") linger = atof(value);
+			else if(option == "--command") {
+				struct MenuEntry entry;
+				entry.type = PLUGIN_MENU_TYPE_GLOBAL;
+				entry.id = -1;
+				entry.text = value;
+				entry.isCommand = true;
+				only.push_back(entry);
+			}
+			else if(option == "--menu") {
+				struct MenuEntry entry;
+				if(!parseMenu(value, &entry)) {
+					usage(argv[0]);
+					return 2;
+				}
+				only.push_back(entry);
+			} else {
+				usage(argv[0]);
+				return 2;
+			}
+		}
+	}
+
+	void* library = dlopen(pluginPath.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if(!library) {
+		fprintf(stderr, "Failed to load %s: %s\n", pluginPath.c_str(), dlerror());
+		return 1;
+	}
+	struct PluginExports exports;
+	if(!resolve(library, "ts3plugin_setFunctionPointers", &exports.setFunctionPointers) ||
+	   !resolve(library, "ts3plugin_registerPluginID", &exports.registerPluginID) ||
+	   !resolve(library, "ts3plugin_init", &exports.init) ||
+	   !resolve(library, "ts3plugin_shutdown", &exports.shutdown) ||
+	   !resolve(library, "ts3plugin_initMenus", &exports.initMenus) ||
+	   !resolve(library, "ts3plugin_freeMemory", &exports.freeMemory) ||
+	   !resolve(library, "ts3plugin_onMenuItemEvent", &exports.onMenuItemEvent)) {
+		fprintf(stderr, "%s is missing plugin exports: %s\n", pluginPath.c_str(), dlerror());
+		return 1;
+	}
+	resolve(library, "ts3plugin_infoData", &exports.infoData);
+	resolve(library, "ts3plugin_processCommand", &exports.processCommand);
+	struct MockPluginCallbacks callbacks;
+	resolve(library, "ts3plugin_onConnectStatusChangeEvent", &callbacks.onConnectStatusChangeEvent);
+	resolve(library, "ts3plugin_onDelChannelEvent", &callbacks.onDelChannelEvent);
+	resolve(library, "ts3plugin_onClientMoveEvent", &callbacks.onClientMoveEvent);
+	resolve(library, "ts3plugin_onClientMoveSubscriptionEvent", &callbacks.onClientMoveSubscriptionEvent);
+	resolve(library, "ts3plugin_onClientMoveMovedEvent", &callbacks.onClientMoveMovedEvent);
+	resolve(library, "ts3plugin_onClientKickFromChannelEvent", &callbacks.onClientKickFromChannelEvent);
+	resolve(library, "ts3plugin_onClientKickFromServerEvent", &callbacks.onClientKickFromServerEvent);
+	resolve(library, "ts3plugin_onServerErrorEvent", &callbacks.onServerErrorEvent);
+	resolve(library, "ts3plugin_onChannelSubscribeFinishedEvent", &callbacks.onChannelSubscribeFinishedEvent);
+	resolve(library, "ts3plugin_onUpdateClientEvent", &callbacks.onUpdateClientEvent);
+	resolve(library, "ts3plugin_onServerGroupClientListEvent", &callbacks.onServerGroupClientListEvent);
+	resolve(library, "ts3plugin_onServerGroupClientAddedEvent", &callbacks.onServerGroupClientAddedEvent);
+	resolve(library, "ts3plugin_onServerGroupClientDeletedEvent", &callbacks.onServerGroupClientDeletedEvent);
+	resolve(library, "ts3plugin_onClientChannelGroupChangedEvent", &callbacks.onClientChannelGroupChangedEvent);
+	resolve(library, "ts3plugin_onChannelPermListEvent", &callbacks.onChannelPermListEvent);
+	resolve(library, "ts3plugin_onConnectionInfoEvent", &callbacks.onConnectionInfoEvent);
+	resolve(library, "ts3plugin_onClientBanFromServerEvent", &callbacks.onClientBanFromServerEvent);
+
+	struct TS3Functions functions;
+	mockInstall(&functions, callbacks, onMessage);
+	mockStart(config);
+	exports.setFunctionPointers(functions);
+	exports.registerPluginID("mass_actions_driver");
+	if(exports.init() != 0) {
+		fprintf(stderr, "Plugin failed to initialize\n");
+		return 1;
+	}
+
+	std::vector<struct MenuEntry> menus;
+	struct PluginMenuItem** menuItems = NULL;
+	char* menuIcon = NULL;
+	exports.initMenus(&menuItems, &menuIcon);
+	for(size_t i = 0; menuItems && menuItems[i]; i++) {
+		struct MenuEntry entry;
+		entry.type = menuItems[i]->type;
+		entry.id = menuItems[i]->id;
+		entry.text = menuItems[i]->text;
+		entry.isCommand = false;
+		menus.push_back(entry);
+		exports.freeMemory(menuItems[i]);
+	}
+	exports.freeMemory(menuItems);
+	if(menuIcon) {
+		exports.freeMemory(menuIcon);
+	}
+
+	std::vector<struct MenuEntry> actions;
+	if(only.empty()) {
+		for(size_t i = 0; i < menus.size(); i++) {
+			if(isAction(menus[i])) {
+				actions.push_back(menus[i]);
+			}
+		}
+	}
+	for(size_t i = 0; i < only.size(); i++) {
+		if(only[i].isCommand) {
+			actions.push_back(only[i]);
+			continue;
+		}
+		for(size_t m = 0; m < menus.size(); m++) {
+			if(menus[m].type == only[i].type && menus[m].id == only[i].id) {
+				actions.push_back(menus[m]);
+			}
+		}
+	}
+	const struct MenuEntry* armItem = findMenu(menus, "ACTIVATE FOR THIS SESSION");
+	const struct MenuEntry* allConnectionsItem = findMenu(menus, "Run on all connections");
+	const struct MenuEntry* timeCallsItem = findMenu(menus, "Time client lib calls");
+	const struct MenuEntry* traceItem = findMenu(menus, "Record timelines");
+
+	printf("%u connections, %u clients, %u channels, depth %u, %u%% unsubscribed, %u us per call, %u ms round trip, flood %.0f/s burst %.0f\n",
+		config.connections, config.clients, config.channels, config.depth, config.unsubscribedPercent, config.callLatencyUs, config.roundTripMs, config.floodRate, config.floodBurst);
+	printf("%-12s %-46s %8s %8s %8s %8s %8s %9s %10s %10s  %s\n", "menu", "action", "requests", "ok", "flooded", "failed", "local", "getters", "wall ms", "req/s", "result");
+
+	/* Done once nothing happened for a while and the plugin reported back, unless nothing was sent or we got kicked ourselves */
+	const double quiet = std::max(0.5, 5 * config.roundTripMs / 1000.0);
+	int failures = 0;
+	for(size_t a = 0; a < actions.size(); a++) {
+		const struct MenuEntry& action = actions[a];
+		mockDisconnect();
+		mockStart(config);
+		mockConnect();
+		if(arm && armItem) {
+			exports.onMenuItemEvent(1, armItem->type, armItem->id, 0);
+		}
+		if(allConnections && allConnectionsItem) {
+			exports.onMenuItemEvent(1, allConnectionsItem->type, allConnectionsItem->id, 0);
+		}
+		if(timeCalls && timeCallsItem) {
+			exports.onMenuItemEvent(1, timeCallsItem->type, timeCallsItem->id, 0);
+		}
+		if(trace && traceItem) {
+			exports.onMenuItemEvent(1, traceItem->type, traceItem->id, 0);
+		}
+
+		uint64 selected = 0;
+		if(action.type == PLUGIN_MENU_TYPE_CHANNEL) {
+			selected = selectedChannel ? selectedChannel : mockBusyChannel(1);
+		} else if(action.type == PLUGIN_MENU_TYPE_CLIENT) {
+			selected = selectedClient;
+		}
+
+		if(verbose) {
+			printf("%s:%d %s\n", menuTypeName(action.type), action.id, action.text.c_str());
+		}
+		mockResetStats();
+		const double offset = mockStats().lastActivity;  /* Reset marks the activity clock, which counts from mockStart */
+		finalReports = 0;
+		const Clock::time_point started = Clock::now();
+		if(!action.isCommand) {
+			exports.onMenuItemEvent(1, action.type, action.id, selected);
+		} else if(!exports.processCommand || exports.processCommand(1, action.text.c_str()) != 0) {
+			fprintf(stderr, "The plugin did not take the command %s\n", action.text.c_str());
+			failures++;
+			continue;
+		}
+
+		const char* result = "timeout";
+		struct MockStats stats;
+		double finishedAt;
+		for(;;) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			stats = mockStats();
+			const double elapsed = std::chrono::duration<double>(Clock::now() - started).count();
+			finishedAt = stats.lastActivity - offset;
+			if(!stats.pending && elapsed - finishedAt >= quiet && (!stats.reported || finalReports || stats.connectionsLost)) {
+				result = "done";
+				break;
+			}
+			if(elapsed >= timeout) {
+				finishedAt = elapsed;
+				failures++;
+				break;
+			}
+		}
+
+		if(linger > 0) {
+			std::this_thread::sleep_for(std::chrono::duration<double>(linger));
+			stats = mockStats();
+		}
+
+		const double wall = std::max(0.0, finishedAt);
+		const std::string name = action.isCommand ? "command" : std::string(menuTypeName(action.type)) + ":" + std::to_string(action.id);
+		printf("%-12s %-46.46s %8zu %8zu %8zu %8zu %8zu %9zu %10.1f %10.1f  %s\n", name.c_str(), action.text.c_str(),
+			stats.requests, stats.succeeded, stats.flooded, stats.failed, stats.localCalls, stats.getterCalls,
+			1000.0 * wall, wall > 0 ? stats.requests / wall : 0.0, result);
+		if(info && exports.infoData) {
+			char* data = NULL;
+			exports.infoData(1, 1, PLUGIN_SERVER, &data);
+			if(data) {
+				printf("%s\n\n", data);
+				exports.freeMemory(data);
+			}
+		}
+		fflush(stdout);
+	}
+
+	mockDisconnect();
+	exports.shutdown();
+	mockStop();
+
+	const size_t leaked = mockStats().liveAllocations;
+	if(leaked) {
+		printf("%zu client lib buffers were never freed\n", leaked);
+		failures++;
+	}
+	dlclose(library);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+/*
+ * Dumps the audit journal the plugin keeps in its config path, oldest record first.
+ *
+ *   mass_actions_journal [--verb kick] [--target TEXT] [--failed] [--since "2018-06-01 20:00"] [--csv] [PATH]
+ *
+ * The file is read, not mapped, so this works while the client has it open.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_definitions.h"
+#include "dispatcher.h"
+#include "journal.h"
+
+struct Filter {
+	std::string server;   /* Substring of the server UID */
+	std::string verb;     /* Prefix of the verb name */
+	std::string target;   /* Substring of the target's name or UID */
+	std::string invoker;  /* Substring of the invoker's name or UID */
+	int failedOnly;
+	uint64 since;         /* Milliseconds since 1970 */
+	size_t last;          /* Only the newest records, 0 = all */
+};
+
+static const char* verbName(unsigned short verb) {
+	switch(verb) {
+		case VERB_MOVE:
+			return "move";
+		case VERB_KICK_FROM_CHANNEL:
+			return "kick from channel";
+		case VERB_KICK_FROM_SERVER:
+			return "kick from server";
+		case VERB_SET_IS_TALKER:
+			return "set talker";
+		case VERB_DELETE_CHANNEL:
+			return "delete channel";
+		case VERB_REQUEST_VARIABLES:
+			return "request variables";
+		case VERB_LIST_GROUP_MEMBERS:
+			return "list group members";
+		case VERB_ADD_TO_GROUP:
+			return "add to group";
+		case VERB_REMOVE_FROM_GROUP:
+			return "remove from group";
+		case VERB_SET_CHANNEL_GROUPS:
+			return "set channel groups";
+		case VERB_LIST_CHANNEL_PERMISSIONS:
+			return "list channel permissions";
+		case VERB_ADD_CHANNEL_PERMISSIONS:
+			return "add channel permissions";
+		case VERB_DELETE_CHANNEL_PERMISSIONS:
+			return "delete channel permissions";
+		case VERB_REQUEST_CONNECTION_INFO:
+			return "request connection info";
+		case VERB_BAN_ADDRESS:
+			return "ban address";
+		case VERB_BAN_CLIENT:
+			return "ban client";
+	}
+	return "unknown";
+}
+
+/* Fields are terminated by the writer, a torn record must not run past its field though */
+static std::string field(const char* text, size_t size) {
+	return std::string(text, strnlen(text, size));
+}
+
+#define FIELD(record, name) field((record).name, sizeof((record).name))
+
+static bool contains(const std::string& text, const std::string& part) {
+	return text.find(part) != std::string::npos;
+}
+
+static bool matches(const struct JournalRecord& record, const struct Filter& filter) {
+	if(record.timestamp < filter.since) {
+		return false;
+	}
+	if(filter.failedOnly && record.result == ERROR_ok) {
+		return false;
+	}
+	if(!filter.server.empty() && !contains(FIELD(record, serverUID), filter.server)) {
+		return false;
+	}
+	if(!filter.verb.empty() && strncmp(verbName(record.verb), filter.verb.c_str(), filter.verb.size()) != 0) {
+		return false;
+	}
+	if(!filter.target.empty() && !contains(FIELD(record, targetName), filter.target) && !contains(FIELD(record, targetUID), filter.target)) {
+		return false;
+	}
+	if(!filter.invoker.empty() && !contains(FIELD(record, invokerName), filter.invoker) && !contains(FIELD(record, invokerUID), filter.invoker)) {
+		return false;
+	}
+	return true;
+}
+
+/* "YYYY-MM-DD", optionally followed by " HH:MM" or " HH:MM:SS", local time */
+static bool parseTime(const char* text, uint64* milliseconds) {
+	struct tm local;
+	memset(&local, 0, sizeof(local));
+	const int fields = sscanf(text, "%d-%d-%d %d:%d:%d", &local.tm_year, &local.tm_mon, &local.tm_mday, &local.tm_hour, &local.tm_min, &local.tm_sec);
+	if(fields < 3) {
+		return false;
+	}
+	local.tm_year -= 1900;
+	local.tm_mon -= 1;
+	local.tm_isdst = -1;
+	const time_t seconds = mktime(&local);
+	if(seconds == (time_t)-1) {
+		return false;
+	}
+	*milliseconds = (uint64)seconds * 1000;
+	return true;
+}
+
+static std::string formatTime(uint64 milliseconds) {
+	const time_t seconds = (time_t)(milliseconds / 1000);
+	char text[32];
+	strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", localtime(&seconds));
+	snprintf(text + strlen(text), sizeof(text) - strlen(text), ".%03u", (unsigned int)(milliseconds % 1000));
+	return text;
+}
+
+/* Quotes a CSV field */
+static std::string csv(const std::string& text) {
+	std::string quoted = "\"";
+	for(size_t i = 0; i < text.size(); i++) {
+		if(text[i] == '"') {
+			quoted += '"';
+		}
+		quoted += text[i];
+	}
+	return quoted + "\"";
+}
+
+static std::string describeTarget(const struct JournalRecord& record) {
+	char text[160];
+	if(record.verb == VERB_DELETE_CHANNEL || record.verb == VERB_ADD_CHANNEL_PERMISSIONS || record.verb == VERB_DELETE_CHANNEL_PERMISSIONS) {
+		snprintf(text, sizeof(text), "channel %llu \"%s\"", (long long unsigned int)record.channelID, FIELD(record, targetName).c_str());
+	} else if(record.verb == VERB_MOVE) {
+		snprintf(text, sizeof(text), "client %u \"%s\" (%s) to channel %llu", (unsigned int)record.clientID, FIELD(record, targetName).c_str(), FIELD(record, targetUID).c_str(),
+			(long long unsigned int)record.channelID);
+	} else if(record.verb == VERB_BAN_ADDRESS) {
+		snprintf(text, sizeof(text), "address %s", FIELD(record, targetName).c_str());
+	} else if(record.verb == VERB_SET_CHANNEL_GROUPS) {
+		snprintf(text, sizeof(text), "%s to channel group %llu", FIELD(record, targetName).c_str(), (long long unsigned int)record.channelID);
+	} else if(record.verb == VERB_ADD_TO_GROUP || record.verb == VERB_REMOVE_FROM_GROUP) {
+		snprintf(text, sizeof(text), "client %u \"%s\" (%s) %s server group %llu", (unsigned int)record.clientID, FIELD(record, targetName).c_str(), FIELD(record, targetUID).c_str(),
+			record.verb == VERB_ADD_TO_GROUP ? "to" : "from", (long long unsigned int)record.channelID);
+	} else {
+		snprintf(text, sizeof(text), "client %u \"%s\" (%s)", (unsigned int)record.clientID, FIELD(record, targetName).c_str(), FIELD(record, targetUID).c_str());
+	}
+	return text;
+}
+
+static void usage(const char* self) {
+	printf("usage: %s [options] [PATH]\n"
+		"  PATH               the journal (./" JOURNAL_FILE ")\n"
+		"  --server TEXT      server unique identifier contains TEXT\n"
+		"  --verb NAME        move, kick, kick from server, set talker, delete, ... (prefix)\n"
+		"  --target TEXT      target nickname, unique identifier or channel name contains TEXT\n"
+		"  --invoker TEXT     invoker nickname or unique identifier contains TEXT\n"
+		"  --failed           only requests that failed\n"
+		"  --since TIME       \"YYYY-MM-DD[ HH:MM[:SS]]\", local time\n"
+		"  --last N           only the newest N matching records\n"
+		"  --csv              CSV instead of a table\n", self);
+}
+
+int main(int argc, char** argv) {
+	struct Filter filter;
+	filter.failedOnly = 0;
+	filter.since = 0;
+	filter.last = 0;
+	std::string path = "./" JOURNAL_FILE;
+	bool asCSV = false;
+
+	for(int i = 1; i < argc; i++) {
+		const std::string option = argv[i];
+		if(option == "--help") {
+			usage(argv[0]);
+			return 0;
+		} else if(option == "--failed") {
+			filter.failedOnly = 1;
+			continue;
+		} else if(option == "--csv") {
+			asCSV = true;
+			continue;
+		} else if(option.compare(0, 2, "--") != 0) {
+			path = option;
+			continue;
+		}
+
+		const char* value = (i + 1 < argc) ? argv[++i] : NULL;
+		if(!value) {
+			usage(argv[0]);
+			return 2;
+		}
+		if(option == "--server") filter.server = value;
+		else if(option == "--verb") filter.verb = value;
+		else if(option == "--target") filter.target = value;
+		else if(option == "--invoker") filter.invoker = value;
+		else if(option == "--last") filter.last = (size_t)strtoul(value, NULL, 10);
+		else if(option == "--since") {
+			if(!parseTime(value, &filter.since)) {
+				fprintf(stderr, "Cannot read the time %s\n", value);
+				return 2;
+			}
+		} else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+
+	FILE* file = fopen(path.c_str(), "rb");
+	if(!file) {
+		fprintf(stderr, "Cannot open %s\n", path.c_str());
+		return 1;
+	}
+	struct JournalHeader header;
+	if(fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0) {
+		fprintf(stderr, "%s is not a journal\n", path.c_str());
+		fclose(file);
+		return 1;
+	}
+	if(header.version != JOURNAL_VERSION || header.headerSize != sizeof(struct JournalHeader) || header.recordSize != sizeof(struct JournalRecord)) {
+		fprintf(stderr, "%s has journal version %u, this reader knows version %u\n", path.c_str(), header.version, JOURNAL_VERSION);
+		fclose(file);
+		return 1;
+	}
+
+	/* The ring starts anywhere, the sequence numbers give the order */
+	std::vector<struct JournalRecord> records(header.capacity);
+	const size_t read = fread(records.data(), sizeof(struct JournalRecord), records.size(), file);
+	fclose(file);
+	records.resize(read);
+	records.erase(std::remove_if(records.begin(), records.end(), [&](const struct JournalRecord& record) {
+		return !record.sequence || !matches(record, filter);
+	}), records.end());
+	std::sort(records.begin(), records.end(), [](const struct JournalRecord& a, const struct JournalRecord& b) {
+		return a.sequence < b.sequence;
+	});
+	if(filter.last && records.size() > filter.last) {
+		records.erase(records.begin(), records.end() - filter.last);
+	}
+
+	if(asCSV) {
+		printf("sequence,time,server,verb,client,channel,target_name,target_uid,invoker_name,invoker_uid,result\n");
+	}
+	for(size_t i = 0; i < records.size(); i++) {
+		const struct JournalRecord& record = records[i];
+		if(asCSV) {
+			printf("%llu,%s,%s,%s,%u,%llu,%s,%s,%s,%s,%u\n", (long long unsigned int)record.sequence, formatTime(record.timestamp).c_str(), csv(FIELD(record, serverUID)).c_str(),
+				verbName(record.verb), (unsigned int)record.clientID, (long long unsigned int)record.channelID, csv(FIELD(record, targetName)).c_str(),
+				csv(FIELD(record, targetUID)).c_str(), csv(FIELD(record, invokerName)).c_str(), csv(FIELD(record, invokerUID)).c_str(), record.result);
+		} else {
+			char result[32] = "ok";
+			if(record.result != ERROR_ok) {
+				snprintf(result, sizeof(result), "error %u", record.result);
+			}
+			printf("%8llu  %s  %-17s  %-60s  by %s  on %s  %s\n", (long long unsigned int)record.sequence, formatTime(record.timestamp).c_str(), verbName(record.verb),
+				describeTarget(record).c_str(), FIELD(record, invokerName).c_str(), FIELD(record, serverUID).c_str(), result);
+		}
+	}
+	if(!asCSV) {
+		fprintf(stderr, "%zu records\n", records.size());
+	}
+	return 0;
+}
@@ -0,0 +1,1272 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_errors_rare.h"
+#include "teamspeak/public_definitions.h"
+#include "teamspeak/public_rare_definitions.h"
+#include "teamspeak/clientlib_publicdefinitions.h"
+#include "ts3_functions.h"
+#include "mock_ts3.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct MockChannel {
+	uint64 parent;
+	int subscribed;
+	std::vector<anyID> members;
+};
+
+struct MockServer {
+	std::string uid;
+	int status;
+	anyID myID;
+	uint64 defaultChannel;
+	std::map<uint64, MockChannel> channels;
+	std::map<anyID, uint64> clients;  /* Channel of every client */
+	std::map<anyID, uint64> detailed; /* Idle time in ms when the requested-only variables were last asked for */
+	std::set<anyID> talkers;
+	std::map<uint64, std::set<uint64> > serverGroups;  /* Database IDs in every server group */
+	std::map<std::pair<uint64, uint64>, uint64> channelGroups;  /* Channel, database ID -> channel group, once it was set */
+	std::map<uint64, std::map<unsigned int, int> > channelPermissions;  /* Permission ID -> value of every channel */
+	std::set<anyID> connectionInfo;   /* Clients whose connection info was asked for and not cleaned up */
+	std::vector<std::string> bans;    /* Address patterns and unique identifiers */
+	double tokens;                    /* Anti-flood bucket */
+	Clock::time_point refilledAt;
+};
+
+/* Runs on the server thread with mockMutex held, returns the error to answer with */
+typedef std::function<unsigned int(uint64 serverConnectionHandlerID, MockServer& server, std::vector<std::function<void()> >& notify)> MockApply;
+
+enum MoveKind {
+	MOVE_BY_REQUEST = 0,
+	MOVE_BY_KICK,
+	MOVE_BY_DELETE
+};
+
+static std::mutex mockMutex;
+static std::condition_variable mockWake;
+static std::map<uint64, MockServer> servers;
+static std::multimap<Clock::time_point, std::function<void()> > events;
+static std::thread serverThread;
+static bool running = false;
+static unsigned int generation = 0;  /* Bumped by mockStart, answers of older servers are dropped */
+static struct MockConfig config;
+static struct MockPluginCallbacks plugin;
+static MockMessageHook messageHook = NULL;
+static struct MockStats stats;
+static Clock::time_point startedAt;
+
+static std::atomic<size_t> liveAllocations(0);
+static std::atomic<size_t> getterCalls(0);
+static std::atomic<unsigned int> returnCodes(0);
+
+/************************** Helpers ***************************/
+
+/* Every getter costs callLatencyUs, spun instead of slept so small latencies stay accurate */
+static void simulateCall() {
+	getterCalls++;
+	if(!config.callLatencyUs) {
+		return;
+	}
+	const Clock::time_point until = Clock::now() + std::chrono::microseconds(config.callLatencyUs);
+	while(Clock::now() < until) {
+	}
+}
+
+static void* mockAlloc(size_t bytes) {
+	liveAllocations++;
+	return malloc(bytes);
+}
+
+/* Caller holds mockMutex */
+static void touch() {
+	stats.lastActivity = std::chrono::duration<double>(Clock::now() - startedAt).count();
+}
+
+/* Every tenth client is a second connection of the one before it and shares its database ID */
+static uint64 databaseID(anyID clientID) {
+	return (uint64)(clientID % 10 ? clientID : clientID - 1) * 3 + 1;
+}
+
+/* Raids come from few addresses: four consecutive clients share one, every 25th hides it */
+static std::string clientAddress(anyID clientID) {
+	if(clientID % 25 == 0) {
+		return std::string();
+	}
+	return "10.0." + std::to_string(clientID / 4 / 256) + "." + std::to_string(clientID / 4 % 256);
+}
+
+/* Caller holds mockMutex. NULL unless the connection is established. */
+static MockServer* findServer(uint64 serverConnectionHandlerID) {
+	std::map<uint64, MockServer>::iterator it = servers.find(serverConnectionHandlerID);
+	if(it == servers.end() || it->second.status != STATUS_CONNECTION_ESTABLISHED) {
+		return NULL;
+	}
+	return &it->second;
+}
+
+/* Clients of a channel are only known while subscribed, your own channel always is */
+static bool isVisible(const MockServer& server, uint64 channelID) {
+	std::map<uint64, MockChannel>::const_iterator ch = server.channels.find(channelID);
+	if(ch == server.channels.end()) {
+		return false;
+	}
+	if(ch->second.subscribed) {
+		return true;
+	}
+	std::map<anyID, uint64>::const_iterator self = server.clients.find(server.myID);
+	return self != server.clients.end() && self->second == channelID;
+}
+
+static void unlinkMember(MockServer& server, anyID clientID, uint64 channelID) {
+	std::vector<anyID>& members = server.channels[channelID].members;
+	std::vector<anyID>::iterator it = std::find(members.begin(), members.end(), clientID);
+	if(it != members.end()) {
+		*it = members.back();
+		members.pop_back();
+	}
+}
+
+/* Caller holds mockMutex, the matching plugin event is appended to notify */
+static void moveClient(uint64 serverConnectionHandlerID, MockServer& server, anyID clientID, uint64 newChannelID, enum MoveKind kind, std::vector<std::function<void()> >& notify) {
+	const uint64 oldChannelID = server.clients[clientID];
+	const bool wasVisible = isVisible(server, oldChannelID);
+	unlinkMember(server, clientID, oldChannelID);
+	server.clients[clientID] = newChannelID;
+	server.channels[newChannelID].members.push_back(clientID);
+	if(clientID == server.myID) {
+		server.channels[newChannelID].subscribed = 1;
+	}
+	const bool nowVisible = isVisible(server, newChannelID);
+	if(!wasVisible && !nowVisible) {
+		return;
+	}
+
+	const int visibility = (wasVisible && nowVisible) ? RETAIN_VISIBILITY : (wasVisible ? LEAVE_VISIBILITY : ENTER_VISIBILITY);
+	const anyID myID = server.myID;
+	switch(kind) {
+		case MOVE_BY_REQUEST:
+			notify.push_back([=]() {
+				if(plugin.onClientMoveMovedEvent) plugin.onClientMoveMovedEvent(serverConnectionHandlerID, clientID, oldChannelID, newChannelID, visibility, myID, "mock", "mock", "");
+			});
+			break;
+		case MOVE_BY_KICK:
+			notify.push_back([=]() {
+				if(plugin.onClientKickFromChannelEvent) plugin.onClientKickFromChannelEvent(serverConnectionHandlerID, clientID, oldChannelID, newChannelID, visibility, myID, "mock", "mock", "");
+			});
+			break;
+		case MOVE_BY_DELETE:
+			notify.push_back([=]() {
+				if(plugin.onClientMoveEvent) plugin.onClientMoveEvent(serverConnectionHandlerID, clientID, oldChannelID, newChannelID, visibility, "");
+			});
+			break;
+	}
+}
+
+static const char* errorText(unsigned int error) {
+	if(error == ERROR_ok) return "ok";
+	if(error == ERROR_client_is_flooding) return "client is flooding";
+	if(error == ERROR_client_invalid_id) return "invalid clientID";
+	if(error == ERROR_channel_invalid_id) return "invalid channelID";
+	if(error == ERROR_channel_already_in) return "already member of channel";
+	if(error == ERROR_channel_not_empty) return "channel not empty";
+	if(error == ERROR_channel_can_not_delete_default) return "cannot delete default channel";
+	if(error == ERROR_not_connected) return "not connected";
+	if(error == ERROR_database_empty_result) return "database empty result set";
+	if(error == ERROR_database_duplicate_entry) return "database duplicated entry";
+	if(error == ERROR_permission_invalid_group_id) return "invalid group ID";
+	return "undefined error";
+}
+
+/* Runs on the server thread once the round trip is over */
+static void answerRequest(uint64 serverConnectionHandlerID, unsigned int requestGeneration, const std::string& returnCode, bool flooded, const MockApply& apply) {
+	std::vector<std::function<void()> > notify;
+	unsigned int error;
+	{
+		std::lock_guard<std::mutex> lock(mockMutex);
+		stats.pending--;
+		touch();
+		MockServer* server = findServer(serverConnectionHandlerID);
+		if(requestGeneration != generation || !server) {
+			return;  /* Disconnected meanwhile, the answer is lost like on a real connection */
+		}
+		error = flooded ? ERROR_client_is_flooding : apply(serverConnectionHandlerID, *server, notify);
+		stats.answered++;
+		if(error == ERROR_ok) {
+			stats.succeeded++;
+		} else if(error == ERROR_client_is_flooding) {
+			stats.flooded++;
+		} else {
+			stats.failed++;
+		}
+	}
+
+	for(size_t i = 0; i < notify.size(); i++) {
+		notify[i]();
+	}
+	if(!returnCode.empty() && plugin.onServerErrorEvent) {
+		plugin.onServerErrorEvent(serverConnectionHandlerID, errorText(error), error, returnCode.c_str(), "");
+	}
+}
+
+/* Sends a request to the simulated server: anti-flood check now, effect and answer after the round trip */
+static unsigned int queueRequest(uint64 serverConnectionHandlerID, const char* returnCode, const MockApply& apply) {
+	std::lock_guard<std::mutex> lock(mockMutex);
+	MockServer* server = findServer(serverConnectionHandlerID);
+	if(!server) {
+		return ERROR_not_connected;
+	}
+	stats.requests++;
+	if(returnCode && *returnCode) {
+		stats.reported++;
+	}
+	touch();
+
+	const Clock::time_point now = Clock::now();
+	bool flooded = false;
+	if(config.floodRate > 0) {
+		server->tokens = std::min(config.floodBurst, server->tokens + config.floodRate * std::chrono::duration<double>(now - server->refilledAt).count());
+		server->refilledAt = now;
+		if(server->tokens < 1.0) {
+			flooded = true;
+		} else {
+			server->tokens -= 1.0;
+		}
+	}
+
+	const std::string code = returnCode ? returnCode : "";
+	const unsigned int requestGeneration = generation;
+	stats.pending++;
+	events.insert(std::make_pair(now + std::chrono::milliseconds(config.roundTripMs), [=]() {
+		answerRequest(serverConnectionHandlerID, requestGeneration, code, flooded, apply);
+	}));
+	mockWake.notify_one();
+	return ERROR_ok;
+}
+
+static void serverLoop() {
+	std::unique_lock<std::mutex> lock(mockMutex);
+	while(running) {
+		if(events.empty()) {
+			mockWake.wait(lock);
+			continue;
+		}
+		std::multimap<Clock::time_point, std::function<void()> >::iterator next = events.begin();
+		if(Clock::now() < next->first) {
+			mockWake.wait_until(lock, next->first);
+			continue;
+		}
+		std::function<void()> event = next->second;
+		events.erase(next);
+
+		/* Events call into the plugin, which calls back into the mock */
+		lock.unlock();
+		event();
+		lock.lock();
+	}
+}
+
+/************************** Client lib functions ***************************/
+
+static unsigned int mockGetErrorMessage(unsigned int errorCode, char** error) {
+	const char* text = errorText(errorCode);
+	*error = (char*)mockAlloc(strlen(text) + 1);
+	strcpy(*error, text);
+	return ERROR_ok;
+}
+
+static unsigned int mockFreeMemory(void* pointer) {
+	if(pointer) {
+		liveAllocations--;
+		free(pointer);
+	}
+	return ERROR_ok;
+}
+
+static unsigned int mockGetClientID(uint64 serverConnectionHandlerID, anyID* result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	MockServer* server = findServer(serverConnectionHandlerID);
+	if(!server) {
+		return ERROR_not_connected;
+	}
+	*result = server->myID;
+	return ERROR_ok;
+}
+
+static unsigned int mockGetClientList(uint64 serverConnectionHandlerID, anyID** result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	MockServer* server = findServer(serverConnectionHandlerID);
+	if(!server) {
+		return ERROR_not_connected;
+	}
+	std::vector<anyID> visible;
+	for(std::map<anyID, uint64>::const_iterator it = server->clients.begin(); it != server->clients.end(); ++it) {
+		if(isVisible(*server, it->second)) {
+			visible.push_back(it->first);
+		}
+	}
+	*result = (anyID*)mockAlloc((visible.size() + 1) * sizeof(anyID));
+	std::copy(visible.begin(), visible.end(), *result);
+	(*result)[visible.size()] = 0;
+	return ERROR_ok;
+}
+
+static unsigned int mockGetChannelOfClient(uint64 serverConnectionHandlerID, anyID clientID, uint64* result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	MockServer* server = findServer(serverConnectionHandlerID);
+	if(!server) {
+		return ERROR_not_connected;
+	}
+	std::map<anyID, uint64>::const_iterator it = server->clients.find(clientID);
+	if(it == server->clients.end() || !isVisible(*server, it->second)) {
+		return ERROR_client_invalid_id;
+	}
+	*result = it->second;
+	return ERROR_ok;
+}
+
+static unsigned int mockGetChannelList(uint64 serverConnectionHandlerID, uint64** result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	MockServer* server = findServer(serverConnectionHandlerID);
+	if(!server) {
+		return ERROR_not_connected;
+	}
+	*result = (uint64*)mockAlloc((server->channels.size() + 1) * sizeof(uint64));
+	size_t n = 0;
+	for(std::map<uint64, MockChannel>::const_iterator it = server->channels.begin(); it != server->channels.end(); ++it) {
+		(*result)[n++] = it->first;
+	}
+	(*result)[n] = 0;
+	return ERROR_ok;
+}
+
+static unsigned int mockGetChannelClientList(uint64 serverConnectionHandlerID, uint64 channelID, anyID** result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	MockServer* server = findServer(serverConnectionHandlerID);
+	if(!server) {
+		return ERROR_not_connected;
+	}
+	std::map<uint64, MockChannel>::const_iterator ch = server->channels.find(channelID);
+	if(ch == server->channels.end()) {
+		return ERROR_channel_invalid_id;
+	}
+	const size_t count = isVisible(*server, channelID) ? ch->second.members.size() : 0;
+	*result = (anyID*)mockAlloc((count + 1) * sizeof(anyID));
+	std::copy(ch->second.members.begin(), ch->second.members.begin() + count, *result);
+	(*result)[count] = 0;
+	return ERROR_ok;
+}
+
+static unsigned int mockGetParentChannelOfChannel(uint64 serverConnectionHandlerID, uint64 channelID, uint64* result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	MockServer* server = findServer(serverConnectionHandlerID);
+	if(!server) {
+		return ERROR_not_connected;
+	}
+	std::map<uint64, MockChannel>::const_iterator ch = server->channels.find(channelID);
+	if(ch == server->channels.end()) {
+		return ERROR_channel_invalid_id;
+	}
+	*result = ch->second.parent;
+	return ERROR_ok;
+}
+
+static unsigned int mockGetChannelVariableAsInt(uint64 serverConnectionHandlerID, uint64 channelID, size_t flag, int* result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	MockServer* server = findServer(serverConnectionHandlerID);
+	if(!server) {
+		return ERROR_not_connected;
+	}
+	std::map<uint64, MockChannel>::const_iterator ch = server->channels.find(channelID);
+	if(ch == server->channels.end()) {
+		return ERROR_channel_invalid_id;
+	}
+	switch(flag) {
+		case CHANNEL_FLAG_DEFAULT:
+			*result = (channelID == server->defaultChannel);
+			break;
+		case CHANNEL_FLAG_ARE_SUBSCRIBED:
+			*result = isVisible(*server, channelID);
+			break;
+		default:
+			*result = 0;
+			break;
+	}
+	return ERROR_ok;
+}
+
+static unsigned int mockGetServerVariableAsString(uint64 serverConnectionHandlerID, size_t flag, char** result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	MockServer* server = findServer(serverConnectionHandlerID);
+	if(!server) {
+		return ERROR_not_connected;
+	}
+	const std::string value = (flag == VIRTUALSERVER_UNIQUE_IDENTIFIER) ? server->uid : std::string();
+	*result = (char*)mockAlloc(value.size() + 1);
+	strcpy(*result, value.c_str());
+	return ERROR_ok;
+}
+
+/* Channel groups 5 to 8 exist, clients joining get 8 and channel creators 5 */
+static unsigned int mockGetServerVariableAsUInt64(uint64 serverConnectionHandlerID, size_t flag, uint64* result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	if(!findServer(serverConnectionHandlerID)) {
+		return ERROR_not_connected;
+	}
+	switch(flag) {
+		case VIRTUALSERVER_DEFAULT_CHANNEL_GROUP:
+			*result = 8;
+			break;
+		case VIRTUALSERVER_DEFAULT_CHANNEL_ADMIN_GROUP:
+			*result = 5;
+			break;
+		default:
+			*result = 0;
+	}
+	return ERROR_ok;
+}
+
+static unsigned int returnString(const std::string& value, char** result) {
+	*result = (char*)mockAlloc(value.size() + 1);
+	strcpy(*result, value.c_str());
+	return ERROR_ok;
+}
+
+/* A client the plugin can see, NULL with the error to return otherwise. Call with mockMutex held. */
+static MockServer* findVisibleClient(uint64 serverConnectionHandlerID, anyID clientID, unsigned int* error) {
+	MockServer* server = findServer(serverConnectionHandlerID);
+	if(!server) {
+		*error = ERROR_not_connected;
+		return NULL;
+	}
+	std::map<anyID, uint64>::const_iterator it = server->clients.find(clientID);
+	if(it == server->clients.end() || !isVisible(*server, it->second)) {
+		*error = ERROR_client_invalid_id;
+		return NULL;
+	}
+	return server;
+}
+
+/*
+ * Clients are "Client <id>" with a made up unique identifier, channels "Channel <id>". Everything else is
+ * spread over the IDs so filters have something to pick, platform, version and idle time like on a real
+ * server only once they were requested.
+ */
+static unsigned int mockGetClientVariableAsString(uint64 serverConnectionHandlerID, anyID clientID, size_t flag, char** result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	unsigned int error;
+	const MockServer* server = findVisibleClient(serverConnectionHandlerID, clientID, &error);
+	if(!server) {
+		return error;
+	}
+	static const char* const platforms[] = { "Windows", "Linux", "OS X", "Android" };
+	const bool detailed = (clientID == server->myID) || server->detailed.count(clientID);
+	switch(flag) {
+		case CLIENT_NICKNAME:
+			return returnString("Client " + std::to_string(clientID), result);
+		case CLIENT_UNIQUE_IDENTIFIER:
+			return returnString("mock" + std::to_string(clientID) + "=", result);
+		case CLIENT_PLATFORM:
+			return returnString(detailed ? platforms[clientID % 4] : "", result);
+		case CLIENT_VERSION:
+			return returnString(detailed ? (clientID % 3 ? "3.2.0 [Build: 1533739581]" : "3.1.10 [Build: 1528456304]") : "", result);
+		case CLIENT_SERVERGROUPS: {
+			std::string groups;
+			for(std::map<uint64, std::set<uint64> >::const_iterator it = server->serverGroups.begin(); it != server->serverGroups.end(); ++it) {
+				if(it->second.count(databaseID(clientID))) {
+					groups += (groups.empty() ? "" : ",") + std::to_string(it->first);
+				}
+			}
+			return returnString(groups, result);
+		}
+	}
+	return returnString(std::string(), result);
+}
+
+static unsigned int mockGetClientVariableAsInt(uint64 serverConnectionHandlerID, anyID clientID, size_t flag, int* result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	unsigned int error;
+	const MockServer* server = findVisibleClient(serverConnectionHandlerID, clientID, &error);
+	if(!server) {
+		return error;
+	}
+	switch(flag) {
+		case CLIENT_AWAY:
+			*result = (clientID % 7) == 0;
+			break;
+		case CLIENT_INPUT_MUTED:
+			*result = (clientID % 4) == 0;
+			break;
+		case CLIENT_OUTPUT_MUTED:
+			*result = (clientID % 9) == 0;
+			break;
+		case CLIENT_IS_TALKER:
+			*result = server->talkers.count(clientID) ? 1 : 0;
+			break;
+		case CLIENT_TALK_POWER:
+			*result = (clientID * 7) % 100;
+			break;
+		case CLIENT_IS_RECORDING:
+			*result = (clientID % 50) == 0;
+			break;
+		default:
+			*result = 0;
+	}
+	return ERROR_ok;
+}
+
+static unsigned int mockGetClientVariableAsUInt64(uint64 serverConnectionHandlerID, anyID clientID, size_t flag, uint64* result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	unsigned int error;
+	const MockServer* server = findVisibleClient(serverConnectionHandlerID, clientID, &error);
+	if(!server) {
+		return error;
+	}
+	switch(flag) {
+		case CLIENT_CHANNEL_GROUP_ID: {
+			std::map<std::pair<uint64, uint64>, uint64>::const_iterator it = server->channelGroups.find(std::make_pair(server->clients.at(clientID), databaseID(clientID)));
+			*result = (it != server->channelGroups.end()) ? it->second : ((clientID % 10) ? 8 : 5);
+			break;
+		}
+		case CLIENT_DATABASE_ID:
+			*result = databaseID(clientID);
+			break;
+		case CLIENT_IDLE_TIME:
+			if(clientID == server->myID) {
+				*result = 0;
+			} else {
+				std::map<anyID, uint64>::const_iterator it = server->detailed.find(clientID);
+				*result = (it != server->detailed.end()) ? it->second : 0;
+			}
+			break;
+		default:
+			*result = 0;
+	}
+	return ERROR_ok;
+}
+
+static unsigned int mockGetClientSelfVariableAsString(uint64 serverConnectionHandlerID, size_t flag, char** result) {
+	anyID myID;
+	const unsigned int error = mockGetClientID(serverConnectionHandlerID, &myID);
+	return (error == ERROR_ok) ? mockGetClientVariableAsString(serverConnectionHandlerID, myID, flag, result) : error;
+}
+
+static unsigned int mockGetChannelVariableAsString(uint64 serverConnectionHandlerID, uint64 channelID, size_t flag, char** result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	MockServer* server = findServer(serverConnectionHandlerID);
+	if(!server) {
+		return ERROR_not_connected;
+	}
+	if(!server->channels.count(channelID)) {
+		return ERROR_channel_invalid_id;
+	}
+	return returnString(flag == CHANNEL_NAME ? "Channel " + std::to_string(channelID) : std::string(), result);
+}
+
+static unsigned int mockGetServerConnectionHandlerList(uint64** result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	*result = (uint64*)mockAlloc((servers.size() + 1) * sizeof(uint64));
+	size_t n = 0;
+	for(std::map<uint64, MockServer>::const_iterator it = servers.begin(); it != servers.end(); ++it) {
+		(*result)[n++] = it->first;
+	}
+	(*result)[n] = 0;
+	return ERROR_ok;
+}
+
+static unsigned int mockGetConnectionStatus(uint64 serverConnectionHandlerID, int* result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	std::map<uint64, MockServer>::const_iterator it = servers.find(serverConnectionHandlerID);
+	*result = (it != servers.end()) ? it->second.status : STATUS_DISCONNECTED;
+	return ERROR_ok;
+}
+
+static uint64 mockGetCurrentServerConnectionHandlerID() {
+	return 1;
+}
+
+static unsigned int mockRequestClientMove(uint64 serverConnectionHandlerID, anyID clientID, uint64 newChannelID, const char* password, const char* returnCode) {
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		std::map<anyID, uint64>::const_iterator it = server.clients.find(clientID);
+		if(it == server.clients.end()) {
+			return ERROR_client_invalid_id;
+		}
+		if(!server.channels.count(newChannelID)) {
+			return ERROR_channel_invalid_id;
+		}
+		if(it->second == newChannelID) {
+			return ERROR_channel_already_in;
+		}
+		moveClient(schid, server, clientID, newChannelID, MOVE_BY_REQUEST, notify);
+		return ERROR_ok;
+	});
+}
+
+static unsigned int mockRequestClientKickFromChannel(uint64 serverConnectionHandlerID, anyID clientID, const char* kickReason, const char* returnCode) {
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		std::map<anyID, uint64>::const_iterator it = server.clients.find(clientID);
+		if(it == server.clients.end()) {
+			return ERROR_client_invalid_id;
+		}
+		if(it->second != server.defaultChannel) {
+			moveClient(schid, server, clientID, server.defaultChannel, MOVE_BY_KICK, notify);
+		}
+		return ERROR_ok;
+	});
+}
+
+/* Caller holds mockMutex. Takes the client off the server like a kick or ban does. */
+static void dropClient(uint64 serverConnectionHandlerID, MockServer& server, std::map<anyID, uint64>::iterator it, bool banned, std::vector<std::function<void()> >& notify) {
+	const anyID clientID = it->first;
+	const uint64 oldChannelID = it->second;
+	const bool wasVisible = isVisible(server, oldChannelID);
+	unlinkMember(server, clientID, oldChannelID);
+	server.clients.erase(it);
+	server.connectionInfo.erase(clientID);
+
+	const anyID myID = server.myID;
+	if(wasVisible) {
+		notify.push_back([=]() {
+			if(!banned && plugin.onClientKickFromServerEvent) plugin.onClientKickFromServerEvent(serverConnectionHandlerID, clientID, oldChannelID, 0, LEAVE_VISIBILITY, myID, "mock", "mock", "");
+			if(banned && plugin.onClientBanFromServerEvent) plugin.onClientBanFromServerEvent(serverConnectionHandlerID, clientID, oldChannelID, 0, LEAVE_VISIBILITY, myID, "mock", "mock", 0, "");
+		});
+	}
+	if(clientID == myID) {
+		server.status = STATUS_DISCONNECTED;
+		stats.connectionsLost++;
+		notify.push_back([=]() {
+			if(plugin.onConnectStatusChangeEvent) plugin.onConnectStatusChangeEvent(serverConnectionHandlerID, STATUS_DISCONNECTED, ERROR_ok);
+		});
+	}
+}
+
+static unsigned int mockRequestClientKickFromServer(uint64 serverConnectionHandlerID, anyID clientID, const char* kickReason, const char* returnCode) {
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		std::map<anyID, uint64>::iterator it = server.clients.find(clientID);
+		if(it == server.clients.end()) {
+			return ERROR_client_invalid_id;
+		}
+		dropClient(schid, server, it, false, notify);
+		return ERROR_ok;
+	});
+}
+
+/* Bans the client's unique identifier and, if it has one, its address */
+static unsigned int mockBanclient(uint64 serverConnectionHandlerID, anyID clientID, uint64 timeInSeconds, const char* banReason, const char* returnCode) {
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		std::map<anyID, uint64>::iterator it = server.clients.find(clientID);
+		if(it == server.clients.end()) {
+			return ERROR_client_invalid_id;
+		}
+		server.bans.push_back("mock" + std::to_string(clientID) + "=");
+		if(!clientAddress(clientID).empty()) {
+			server.bans.push_back(clientAddress(clientID));
+		}
+		dropClient(schid, server, it, true, notify);
+		return ERROR_ok;
+	});
+}
+
+/* Like the real server an address ban only keeps clients from connecting, nobody online is kicked */
+static unsigned int mockBanadd(uint64 serverConnectionHandlerID, const char* ipRegExp, const char* nameRegexp, const char* uniqueIdentity, uint64 timeInSeconds, const char* banReason, const char* returnCode) {
+	const std::string pattern = ipRegExp ? ipRegExp : "";
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		if(pattern.empty()) {
+			return ERROR_parameter_invalid;
+		}
+		server.bans.push_back(pattern);
+		return ERROR_ok;
+	});
+}
+
+static unsigned int mockRequestChannelDelete(uint64 serverConnectionHandlerID, uint64 channelID, int force, const char* returnCode) {
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		if(!server.channels.count(channelID)) {
+			return ERROR_channel_invalid_id;
+		}
+
+		/* Parents first, so deleting in reverse removes children first */
+		std::vector<uint64> subtree(1, channelID);
+		for(size_t k = 0; k < subtree.size(); k++) {
+			for(std::map<uint64, MockChannel>::const_iterator ch = server.channels.begin(); ch != server.channels.end(); ++ch) {
+				if(ch->second.parent == subtree[k]) {
+					subtree.push_back(ch->first);
+				}
+			}
+		}
+		if(std::find(subtree.begin(), subtree.end(), server.defaultChannel) != subtree.end()) {
+			return ERROR_channel_can_not_delete_default;
+		}
+		if(!force && (subtree.size() > 1 || !server.channels[channelID].members.empty())) {
+			return ERROR_channel_not_empty;
+		}
+
+		const anyID myID = server.myID;
+		for(size_t k = subtree.size(); k-- > 0; ) {
+			const uint64 deleted = subtree[k];
+			const std::vector<anyID> members(server.channels[deleted].members);
+			for(size_t c = 0; c < members.size(); c++) {
+				moveClient(schid, server, members[c], server.defaultChannel, MOVE_BY_DELETE, notify);
+			}
+			server.channels.erase(deleted);
+			notify.push_back([=]() {
+				if(plugin.onDelChannelEvent) plugin.onDelChannelEvent(schid, deleted, myID, "mock", "mock");
+			});
+		}
+		return ERROR_ok;
+	});
+}
+
+static unsigned int mockRequestClientSetIsTalker(uint64 serverConnectionHandlerID, anyID clientID, int isTalker, const char* returnCode) {
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		if(!server.clients.count(clientID)) {
+			return ERROR_client_invalid_id;
+		}
+		if(isTalker) {
+			server.talkers.insert(clientID);
+		} else {
+			server.talkers.erase(clientID);
+		}
+		const anyID invokerID = server.myID;
+		notify.push_back([=]() { if(plugin.onUpdateClientEvent) plugin.onUpdateClientEvent(schid, clientID, invokerID, "", ""); });
+		return ERROR_ok;
+	});
+}
+
+/* Everyone has been idle for up to four hours at mockStart and stays idle */
+static uint64 idleTime(anyID clientID) {
+	const uint64 sinceStart = (uint64)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - startedAt).count();
+	return (uint64)((clientID * 7919) % 14400) * 1000 + sinceStart;
+}
+
+static unsigned int mockRequestClientVariables(uint64 serverConnectionHandlerID, anyID clientID, const char* returnCode) {
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		if(!server.clients.count(clientID)) {
+			return ERROR_client_invalid_id;
+		}
+		server.detailed[clientID] = idleTime(clientID);
+		notify.push_back([=]() { if(plugin.onUpdateClientEvent) plugin.onUpdateClientEvent(schid, clientID, 0, "", ""); });
+		return ERROR_ok;
+	});
+}
+
+static unsigned int mockRequestConnectionInfo(uint64 serverConnectionHandlerID, anyID clientID, const char* returnCode) {
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		if(!server.clients.count(clientID)) {
+			return ERROR_client_invalid_id;
+		}
+		server.connectionInfo.insert(clientID);
+		notify.push_back([=]() { if(plugin.onConnectionInfoEvent) plugin.onConnectionInfoEvent(schid, clientID); });
+		return ERROR_ok;
+	});
+}
+
+/* Only the address, and only between requestConnectionInfo and cleanUpConnectionInfo */
+static unsigned int mockGetConnectionVariableAsString(uint64 serverConnectionHandlerID, anyID clientID, size_t flag, char** result) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	MockServer* server = findServer(serverConnectionHandlerID);
+	if(!server) {
+		return ERROR_not_connected;
+	}
+	if(!server->connectionInfo.count(clientID)) {
+		return ERROR_no_cached_connection_info;
+	}
+	return returnString(flag == CONNECTION_CLIENT_IP ? clientAddress(clientID) : std::string(), result);
+}
+
+static unsigned int mockCleanUpConnectionInfo(uint64 serverConnectionHandlerID, anyID clientID) {
+	simulateCall();
+	std::lock_guard<std::mutex> lock(mockMutex);
+	MockServer* server = findServer(serverConnectionHandlerID);
+	if(!server) {
+		return ERROR_not_connected;
+	}
+	server->connectionInfo.erase(clientID);
+	return ERROR_ok;
+}
+
+/* Caller holds mockMutex. Tells the plugin about every connection in view of a database ID whose server groups changed. */
+static void notifyGroupChange(uint64 serverConnectionHandlerID, const MockServer& server, uint64 groupID, uint64 clientDatabaseID, bool added, std::vector<std::function<void()> >& notify) {
+	const anyID invokerID = server.myID;
+	for(std::map<anyID, uint64>::const_iterator it = server.clients.begin(); it != server.clients.end(); ++it) {
+		if(databaseID(it->first) != clientDatabaseID || !isVisible(server, it->second)) {
+			continue;
+		}
+		const anyID clientID = it->first;
+		notify.push_back([=]() {
+			if(added && plugin.onServerGroupClientAddedEvent) plugin.onServerGroupClientAddedEvent(serverConnectionHandlerID, clientID, "", "", groupID, invokerID, "mock", "mock");
+			if(!added && plugin.onServerGroupClientDeletedEvent) plugin.onServerGroupClientDeletedEvent(serverConnectionHandlerID, clientID, "", "", groupID, invokerID, "mock", "mock");
+		});
+	}
+}
+
+/* Like the real server an empty group is answered with an error after listing nothing */
+static unsigned int mockRequestServerGroupClientList(uint64 serverConnectionHandlerID, uint64 serverGroupID, int withNames, const char* returnCode) {
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		std::map<uint64, std::set<uint64> >::const_iterator group = server.serverGroups.find(serverGroupID);
+		if(group == server.serverGroups.end()) {
+			return ERROR_permission_invalid_group_id;
+		}
+		if(group->second.empty()) {
+			return ERROR_database_empty_result;
+		}
+		const std::vector<uint64> members(group->second.begin(), group->second.end());
+		notify.push_back([=]() {
+			for(size_t i = 0; i < members.size() && plugin.onServerGroupClientListEvent; i++) {
+				plugin.onServerGroupClientListEvent(schid, serverGroupID, members[i], "", "");
+			}
+		});
+		return ERROR_ok;
+	});
+}
+
+static unsigned int mockRequestServerGroupAddClient(uint64 serverConnectionHandlerID, uint64 serverGroupID, uint64 clientDatabaseID, const char* returnCode) {
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		std::map<uint64, std::set<uint64> >::iterator group = server.serverGroups.find(serverGroupID);
+		if(group == server.serverGroups.end()) {
+			return ERROR_permission_invalid_group_id;
+		}
+		if(!group->second.insert(clientDatabaseID).second) {
+			return ERROR_database_duplicate_entry;
+		}
+		notifyGroupChange(schid, server, serverGroupID, clientDatabaseID, true, notify);
+		return ERROR_ok;
+	});
+}
+
+static unsigned int mockRequestServerGroupDelClient(uint64 serverConnectionHandlerID, uint64 serverGroupID, uint64 clientDatabaseID, const char* returnCode) {
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		std::map<uint64, std::set<uint64> >::iterator group = server.serverGroups.find(serverGroupID);
+		if(group == server.serverGroups.end()) {
+			return ERROR_permission_invalid_group_id;
+		}
+		if(!group->second.erase(clientDatabaseID)) {
+			return ERROR_database_empty_result;
+		}
+		notifyGroupChange(schid, server, serverGroupID, clientDatabaseID, false, notify);
+		return ERROR_ok;
+	});
+}
+
+static unsigned int mockRequestSetClientChannelGroup(uint64 serverConnectionHandlerID, const uint64* channelGroupIDArray, const uint64* channelIDArray, const uint64* clientDatabaseIDArray, int arraySize, const char* returnCode) {
+	const std::vector<uint64> groups(channelGroupIDArray, channelGroupIDArray + arraySize);
+	const std::vector<uint64> channels(channelIDArray, channelIDArray + arraySize);
+	const std::vector<uint64> databaseIDs(clientDatabaseIDArray, clientDatabaseIDArray + arraySize);
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		for(size_t i = 0; i < groups.size(); i++) {
+			if(groups[i] < 5 || groups[i] > 8) {
+				return ERROR_permission_invalid_group_id;
+			}
+			if(!server.channels.count(channels[i])) {
+				return ERROR_channel_invalid_id;
+			}
+		}
+		const anyID invokerID = server.myID;
+		for(size_t i = 0; i < groups.size(); i++) {
+			server.channelGroups[std::make_pair(channels[i], databaseIDs[i])] = groups[i];
+			const std::vector<anyID>& members = server.channels[channels[i]].members;
+			for(size_t c = 0; c < members.size(); c++) {
+				const anyID clientID = members[c];
+				const uint64 groupID = groups[i], channelID = channels[i];
+				if(databaseID(clientID) == databaseIDs[i] && isVisible(server, channelID)) {
+					notify.push_back([=]() {
+						if(plugin.onClientChannelGroupChangedEvent) plugin.onClientChannelGroupChangedEvent(schid, groupID, channelID, clientID, invokerID, "mock", "mock");
+					});
+				}
+			}
+		}
+		return ERROR_ok;
+	});
+}
+
+/* Like the real server a channel without permissions is answered with an error after listing nothing */
+static unsigned int mockRequestChannelPermList(uint64 serverConnectionHandlerID, uint64 channelID, const char* returnCode) {
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		if(!server.channels.count(channelID)) {
+			return ERROR_channel_invalid_id;
+		}
+		const std::map<unsigned int, int> permissions = server.channelPermissions[channelID];
+		if(permissions.empty()) {
+			return ERROR_database_empty_result;
+		}
+		notify.push_back([=]() {
+			for(std::map<unsigned int, int>::const_iterator it = permissions.begin(); it != permissions.end() && plugin.onChannelPermListEvent; ++it) {
+				plugin.onChannelPermListEvent(schid, channelID, it->first, it->second, 0, 0);
+			}
+		});
+		return ERROR_ok;
+	});
+}
+
+static unsigned int mockRequestChannelAddPerm(uint64 serverConnectionHandlerID, uint64 channelID, const unsigned int* permissionIDArray, const int* permissionValueArray, int arraySize, const char* returnCode) {
+	const std::vector<unsigned int> permissions(permissionIDArray, permissionIDArray + arraySize);
+	const std::vector<int> values(permissionValueArray, permissionValueArray + arraySize);
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		if(!server.channels.count(channelID)) {
+			return ERROR_channel_invalid_id;
+		}
+		for(size_t i = 0; i < permissions.size(); i++) {
+			server.channelPermissions[channelID][permissions[i]] = values[i];
+		}
+		return ERROR_ok;
+	});
+}
+
+static unsigned int mockRequestChannelDelPerm(uint64 serverConnectionHandlerID, uint64 channelID, const unsigned int* permissionIDArray, int arraySize, const char* returnCode) {
+	const std::vector<unsigned int> permissions(permissionIDArray, permissionIDArray + arraySize);
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		if(!server.channels.count(channelID)) {
+			return ERROR_channel_invalid_id;
+		}
+		for(size_t i = 0; i < permissions.size(); i++) {
+			server.channelPermissions[channelID].erase(permissions[i]);
+		}
+		return ERROR_ok;
+	});
+}
+
+static unsigned int changeSubscription(uint64 serverConnectionHandlerID, const uint64* channelIDArray, const char* returnCode, int subscribe) {
+	std::vector<uint64> channels;
+	for(size_t i = 0; channelIDArray[i]; i++) {
+		channels.push_back(channelIDArray[i]);
+	}
+	return queueRequest(serverConnectionHandlerID, returnCode, [=](uint64 schid, MockServer& server, std::vector<std::function<void()> >& notify) -> unsigned int {
+		for(size_t i = 0; i < channels.size(); i++) {
+			std::map<uint64, MockChannel>::iterator ch = server.channels.find(channels[i]);
+			if(ch == server.channels.end() || ch->second.subscribed == subscribe) {
+				continue;
+			}
+			const bool wasVisible = isVisible(server, ch->first);
+			ch->second.subscribed = subscribe;
+			if(wasVisible == isVisible(server, ch->first)) {
+				continue;  /* Your own channel stays visible */
+			}
+
+			const uint64 channelID = ch->first;
+			const std::vector<anyID> members(ch->second.members);
+			notify.push_back([=]() {
+				for(size_t c = 0; c < members.size() && plugin.onClientMoveSubscriptionEvent; c++) {
+					if(subscribe) {
+						plugin.onClientMoveSubscriptionEvent(schid, members[c], 0, channelID, ENTER_VISIBILITY);
+					} else {
+						plugin.onClientMoveSubscriptionEvent(schid, members[c], channelID, 0, LEAVE_VISIBILITY);
+					}
+				}
+			});
+		}
+		if(subscribe) {
+			notify.push_back([=]() {
+				if(plugin.onChannelSubscribeFinishedEvent) plugin.onChannelSubscribeFinishedEvent(schid);
+			});
+		}
+		return ERROR_ok;
+	});
+}
+
+static unsigned int mockRequestChannelSubscribe(uint64 serverConnectionHandlerID, const uint64* channelIDArray, const char* returnCode) {
+	return changeSubscription(serverConnectionHandlerID, channelIDArray, returnCode, 1);
+}
+
+static unsigned int mockRequestChannelUnsubscribe(uint64 serverConnectionHandlerID, const uint64* channelIDArray, const char* returnCode) {
+	return changeSubscription(serverConnectionHandlerID, channelIDArray, returnCode, 0);
+}
+
+/* Muting is local to the client, nothing goes to the server */
+static unsigned int localMute(uint64 serverConnectionHandlerID, const anyID* clientIDArray) {
+	std::lock_guard<std::mutex> lock(mockMutex);
+	if(!findServer(serverConnectionHandlerID)) {
+		return ERROR_not_connected;
+	}
+	stats.localCalls++;
+	touch();
+	return ERROR_ok;
+}
+
+static unsigned int mockRequestMuteClients(uint64 serverConnectionHandlerID, const anyID* clientIDArray, const char* returnCode) {
+	return localMute(serverConnectionHandlerID, clientIDArray);
+}
+
+static unsigned int mockRequestUnmuteClients(uint64 serverConnectionHandlerID, const anyID* clientIDArray, const char* returnCode) {
+	return localMute(serverConnectionHandlerID, clientIDArray);
+}
+
+static void mockPrintMessage(uint64 serverConnectionHandlerID, const char* message, enum PluginMessageTarget messageTarget) {
+	{
+		std::lock_guard<std::mutex> lock(mockMutex);
+		touch();
+	}
+	if(messageHook) {
+		messageHook(serverConnectionHandlerID, message);
+	}
+}
+
+static void mockPrintMessageToCurrentTab(const char* message) {
+	mockPrintMessage(mockGetCurrentServerConnectionHandlerID(), message, PLUGIN_MESSAGE_TARGET_SERVER);
+}
+
+static void mockCreateReturnCode(const char* pluginID, char* returnCode, size_t maxLen) {
+	snprintf(returnCode, maxLen, "mock:%u", ++returnCodes);
+}
+
+static void mockSetPluginMenuEnabled(const char* pluginID, int menuID, int enabled) {
+}
+
+static void mockEmptyPath(char* path, size_t maxLen) {
+	snprintf(path, maxLen, "%s", "");
+}
+
+static void mockCurrentDirectory(char* path, size_t maxLen) {
+	snprintf(path, maxLen, "%s", "./");
+}
+
+static void mockGetPluginPath(char* path, size_t maxLen, const char* pluginID) {
+	mockCurrentDirectory(path, maxLen);
+}
+
+/************************** Mock control ***************************/
+
+void mockDefaultConfig(struct MockConfig* defaults) {
+	defaults->connections = 1;
+	defaults->clients = 100;
+	defaults->channels = 20;
+	defaults->depth = 1;
+	defaults->unsubscribedPercent = 0;
+	defaults->callLatencyUs = 0;
+	defaults->roundTripMs = 20;
+	defaults->floodRate = 0;
+	defaults->floodBurst = 10;
+	defaults->freshServerUIDs = 0;
+}
+
+void mockInstall(struct TS3Functions* functions, const struct MockPluginCallbacks& callbacks, MockMessageHook onMessage) {
+	memset(functions, 0, sizeof(*functions));
+	functions->getErrorMessage = mockGetErrorMessage;
+	functions->freeMemory = mockFreeMemory;
+	functions->getClientID = mockGetClientID;
+	functions->getClientList = mockGetClientList;
+	functions->getChannelOfClient = mockGetChannelOfClient;
+	functions->getChannelList = mockGetChannelList;
+	functions->getChannelClientList = mockGetChannelClientList;
+	functions->getParentChannelOfChannel = mockGetParentChannelOfChannel;
+	functions->getChannelVariableAsInt = mockGetChannelVariableAsInt;
+	functions->getChannelVariableAsString = mockGetChannelVariableAsString;
+	functions->getClientVariableAsString = mockGetClientVariableAsString;
+	functions->getClientVariableAsInt = mockGetClientVariableAsInt;
+	functions->getClientVariableAsUInt64 = mockGetClientVariableAsUInt64;
+	functions->getClientSelfVariableAsString = mockGetClientSelfVariableAsString;
+	functions->getServerVariableAsString = mockGetServerVariableAsString;
+	functions->getServerVariableAsUInt64 = mockGetServerVariableAsUInt64;
+	functions->getServerConnectionHandlerList = mockGetServerConnectionHandlerList;
+	functions->getConnectionStatus = mockGetConnectionStatus;
+	functions->getCurrentServerConnectionHandlerID = mockGetCurrentServerConnectionHandlerID;
+	functions->requestClientMove = mockRequestClientMove;
+	functions->requestClientKickFromChannel = mockRequestClientKickFromChannel;
+	functions->requestClientKickFromServer = mockRequestClientKickFromServer;
+	functions->requestChannelDelete = mockRequestChannelDelete;
+	functions->requestClientSetIsTalker = mockRequestClientSetIsTalker;
+	functions->requestClientVariables = mockRequestClientVariables;
+	functions->requestServerGroupClientList = mockRequestServerGroupClientList;
+	functions->requestServerGroupAddClient = mockRequestServerGroupAddClient;
+	functions->requestServerGroupDelClient = mockRequestServerGroupDelClient;
+	functions->requestSetClientChannelGroup = mockRequestSetClientChannelGroup;
+	functions->requestChannelPermList = mockRequestChannelPermList;
+	functions->requestChannelAddPerm = mockRequestChannelAddPerm;
+	functions->requestChannelDelPerm = mockRequestChannelDelPerm;
+	functions->requestConnectionInfo = mockRequestConnectionInfo;
+	functions->getConnectionVariableAsString = mockGetConnectionVariableAsString;
+	functions->cleanUpConnectionInfo = mockCleanUpConnectionInfo;
+	functions->banadd = mockBanadd;
+	functions->banclient = mockBanclient;
+	functions->requestChannelSubscribe = mockRequestChannelSubscribe;
+	functions->requestChannelUnsubscribe = mockRequestChannelUnsubscribe;
+	functions->requestMuteClients = mockRequestMuteClients;
+	functions->requestUnmuteClients = mockRequestUnmuteClients;
+	functions->printMessage = mockPrintMessage;
+	functions->printMessageToCurrentTab = mockPrintMessageToCurrentTab;
+	functions->createReturnCode = mockCreateReturnCode;
+	functions->setPluginMenuEnabled = mockSetPluginMenuEnabled;
+	functions->getAppPath = mockEmptyPath;
+	functions->getResourcesPath = mockEmptyPath;
+	functions->getConfigPath = mockCurrentDirectory;
+	functions->getPluginPath = mockGetPluginPath;
+
+	plugin = callbacks;
+	messageHook = onMessage;
+}
+
+void mockStart(const struct MockConfig& newConfig) {
+	std::lock_guard<std::mutex> lock(mockMutex);
+	config = newConfig;
+	generation++;
+	events.clear();
+	servers.clear();
+	memset(&stats, 0, sizeof(stats));
+	startedAt = Clock::now();
+
+	const unsigned int channelCount = std::max(1u, config.channels);
+	const unsigned int depth = std::max(1u, config.depth);
+	const unsigned int clientCount = std::min(std::max(1u, config.clients), 65534u);
+	for(uint64 schid = 1; schid <= std::max(1u, config.connections); schid++) {
+		MockServer& server = servers[schid];
+		char uid[64];
+		snprintf(uid, sizeof(uid), "mock-server-%u-%llu", config.freshServerUIDs ? generation : 0, (long long unsigned int)schid);
+		server.uid = uid;
+		server.status = STATUS_CONNECTION_ESTABLISHED;
+		server.defaultChannel = 1;
+		server.tokens = config.floodBurst;
+		server.refilledAt = startedAt;
+
+		/* Chains of depth channels each: channel i hangs below i - 1 unless it starts a new chain */
+		for(uint64 i = 1; i <= channelCount; i++) {
+			MockChannel& channel = server.channels[i];
+			channel.parent = ((i - 1) % depth) ? i - 1 : 0;
+			channel.subscribed = (i == server.defaultChannel) || (i * 37 % 100) >= config.unsubscribedPercent;
+			/* A few permissions each, every fourth channel has none */
+			if(i % 4) {
+				std::map<unsigned int, int>& permissions = server.channelPermissions[i];
+				permissions[20] = (int)(i % 3) * 25;
+				if(i % 2) {
+					permissions[21] = 75;
+				}
+				if(i % 5 == 0) {
+					permissions[22] = -1;
+				}
+			}
+		}
+
+		/* Yourself in the default channel, everyone else round robin */
+		server.myID = 1;
+		for(anyID c = 1; c <= clientCount; c++) {
+			const uint64 channelID = (c == server.myID) ? server.defaultChannel : (uint64)((c - 2) % channelCount) + 1;
+			server.clients[c] = channelID;
+			server.channels[channelID].members.push_back(c);
+			if(c % 6 == 0) {
+				server.talkers.insert(c);
+			}
+			server.serverGroups[c % 5 ? 8 : 7].insert(databaseID(c));
+			if(c % 20 == 0) {
+				server.serverGroups[6].insert(databaseID(c));
+			}
+		}
+		server.serverGroups[9];  /* Empty */
+	}
+
+	if(!running) {
+		running = true;
+		serverThread = std::thread(serverLoop);
+	}
+}
+
+void mockConnect() {
+	std::vector<uint64> connected;
+	{
+		std::lock_guard<std::mutex> lock(mockMutex);
+		for(std::map<uint64, MockServer>::const_iterator it = servers.begin(); it != servers.end(); ++it) {
+			if(it->second.status == STATUS_CONNECTION_ESTABLISHED) {
+				connected.push_back(it->first);
+			}
+		}
+	}
+	for(size_t i = 0; i < connected.size(); i++) {
+		if(plugin.onConnectStatusChangeEvent) {
+			plugin.onConnectStatusChangeEvent(connected[i], STATUS_CONNECTION_ESTABLISHED, ERROR_ok);
+		}
+	}
+}
+
+void mockDisconnect() {
+	std::vector<uint64> disconnected;
+	{
+		std::lock_guard<std::mutex> lock(mockMutex);
+		for(std::map<uint64, MockServer>::iterator it = servers.begin(); it != servers.end(); ++it) {
+			if(it->second.status == STATUS_CONNECTION_ESTABLISHED) {
+				it->second.status = STATUS_DISCONNECTED;
+				disconnected.push_back(it->first);
+			}
+		}
+	}
+	for(size_t i = 0; i < disconnected.size(); i++) {
+		if(plugin.onConnectStatusChangeEvent) {
+			plugin.onConnectStatusChangeEvent(disconnected[i], STATUS_DISCONNECTED, ERROR_ok);
+		}
+	}
+}
+
+void mockStop() {
+	{
+		std::lock_guard<std::mutex> lock(mockMutex);
+		if(!running) {
+			return;
+		}
+		running = false;
+		events.clear();
+	}
+	mockWake.notify_all();
+	serverThread.join();
+}
+
+struct MockStats mockStats() {
+	std::lock_guard<std::mutex> lock(mockMutex);
+	struct MockStats current = stats;
+	current.getterCalls = getterCalls.load();
+	current.liveAllocations = liveAllocations.load();
+	return current;
+}
+
+void mockResetStats() {
+	std::lock_guard<std::mutex> lock(mockMutex);
+	const size_t pending = stats.pending;
+	memset(&stats, 0, sizeof(stats));
+	stats.pending = pending;
+	getterCalls = 0;
+	touch();
+}
+
+uint64 mockBusyChannel(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(mockMutex);
+	MockServer* server = findServer(serverConnectionHandlerID);
+	if(!server) {
+		return 0;
+	}
+	const uint64 myChannel = server->clients[server->myID];
+	for(std::map<uint64, MockChannel>::const_iterator it = server->channels.begin(); it != server->channels.end(); ++it) {
+		if(it->first != myChannel && !it->second.members.empty()) {
+			return it->first;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * Keyinator's Mass Actions
+ *
+ * Copyright (c) 2018-2018 Immanuel "Keyinator" von Neumann
+ */
+
+#ifndef MOCK_TS3_H
+#define MOCK_TS3_H
+
+#include <stddef.h>
+#include "teamspeak/public_definitions.h"
+#include "plugin_definitions.h"
+#include "ts3_functions.h"
+
+/*
+ * In-process stand-in for the TeamSpeak 3 client lib, so the plugin can be loaded and driven without a client.
+ * It fills a TS3Functions table with everything the plugin calls and simulates one or more servers: a channel
+ * tree, clients spread over it, channel subscriptions, per-call latency of the getters, a round trip for
+ * requests and the server's anti-flood protection. Requests are answered from a server thread through the
+ * plugin's own callbacks, like the real client lib does.
+ */
+
+struct MockConfig {
+	unsigned int connections;          /* Server tabs, handler IDs 1..connections */
+	unsigned int clients;              /* Per server, including yourself */
+	unsigned int channels;             /* Per server */
+	unsigned int depth;                /* Levels of the channel tree, 1 = flat */
+	unsigned int unsubscribedPercent;  /* Channels we start out not subscribed to */
+	unsigned int callLatencyUs;        /* Cost of every getter call */
+	unsigned int roundTripMs;          /* Until the server answers a request */
+	double floodRate;                  /* Requests per second the server accepts, 0 = no anti-flood */
+	double floodBurst;
+	int freshServerUIDs;               /* Every mockStart gives the servers new unique IDs, so nothing learned about them carries over */
+};
+
+/* Plugin callbacks the mock fires, resolved from the loaded plugin. Missing ones are skipped. */
+struct MockPluginCallbacks {
+	void (*onConnectStatusChangeEvent)(uint64 serverConnectionHandlerID, int newStatus, unsigned int errorNumber);
+	void (*onDelChannelEvent)(uint64 serverConnectionHandlerID, uint64 channelID, anyID invokerID, const char* invokerName, const char* invokerUniqueIdentifier);
+	void (*onClientMoveEvent)(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, const char* moveMessage);
+	void (*onClientMoveSubscriptionEvent)(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility);
+	void (*onClientMoveMovedEvent)(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID moverID, const char* moverName, const char* moverUniqueIdentifier, const char* moveMessage);
+	void (*onClientKickFromChannelEvent)(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID kickerID, const char* kickerName, const char* kickerUniqueIdentifier, const char* kickMessage);
+	void (*onClientKickFromServerEvent)(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID kickerID, const char* kickerName, const char* kickerUniqueIdentifier, const char* kickMessage);
+	int  (*onServerErrorEvent)(uint64 serverConnectionHandlerID, const char* errorMessage, unsigned int error, const char* returnCode, const char* extraMessage);
+	void (*onChannelSubscribeFinishedEvent)(uint64 serverConnectionHandlerID);
+	void (*onUpdateClientEvent)(uint64 serverConnectionHandlerID, anyID clientID, anyID invokerID, const char* invokerName, const char* invokerUniqueIdentifier);
+	void (*onServerGroupClientListEvent)(uint64 serverConnectionHandlerID, uint64 serverGroupID, uint64 clientDatabaseID, const char* clientNameIdentifier, const char* clientUniqueID);
+	void (*onServerGroupClientAddedEvent)(uint64 serverConnectionHandlerID, anyID clientID, const char* clientName, const char* clientUniqueIdentity, uint64 serverGroupID, anyID invokerClientID, const char* invokerName, const char* invokerUniqueIdentity);
+	void (*onServerGroupClientDeletedEvent)(uint64 serverConnectionHandlerID, anyID clientID, const char* clientName, const char* clientUniqueIdentity, uint64 serverGroupID, anyID invokerClientID, const char* invokerName, const char* invokerUniqueIdentity);
+	void (*onClientChannelGroupChangedEvent)(uint64 serverConnectionHandlerID, uint64 channelGroupID, uint64 channelID, anyID clientID, anyID invokerClientID, const char* invokerName, const char* invokerUniqueIdentity);
+	void (*onConnectionInfoEvent)(uint64 serverConnectionHandlerID, anyID clientID);
+	void (*onClientBanFromServerEvent)(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID kickerID, const char* kickerName, const char* kickerUniqueIdentifier, uint64 time, const char* kickMessage);
+	void (*onChannelPermListEvent)(uint64 serverConnectionHandlerID, uint64 channelID, unsigned int permissionID, int permissionValue, int permissionNegated, int permissionSkip);
+};
+
+/* Everything counted since the last mockResetStats */
+struct MockStats {
+	size_t requests;         /* Server requests sent by the plugin */
+	size_t reported;         /* Of those, sent with a return code, the dispatcher's, which end up in a batch report */
+	size_t answered;         /* Answers delivered through onServerErrorEvent */
+	size_t succeeded;
+	size_t flooded;          /* Refused by the anti-flood protection */
+	size_t failed;           /* Any other error */
+	size_t localCalls;       /* Client side only requests like mute */
+	size_t getterCalls;      /* Calls into the client lib that only read state */
+	size_t pending;          /* Answers not delivered yet */
+	size_t connectionsLost;  /* Servers that kicked yourself */
+	size_t liveAllocations;  /* Buffers handed to the plugin and not freed yet, never reset */
+	double lastActivity;     /* Seconds since mockStart when the last request, answer or message happened */
+};
+
+/* Called for every printMessage, on whatever thread the plugin printed from */
+typedef void (*MockMessageHook)(uint64 serverConnectionHandlerID, const char* message);
+
+void mockDefaultConfig(struct MockConfig* config);
+
+/* Fills functions with the mock, must be called before the plugin gets the table */
+void mockInstall(struct TS3Functions* functions, const struct MockPluginCallbacks& callbacks, MockMessageHook onMessage);
+
+/* Builds fresh servers from config and starts the server thread. A handler ID keeps its server's unique ID unless config.freshServerUIDs. */
+void mockStart(const struct MockConfig& config);
+
+/* Fires STATUS_CONNECTION_ESTABLISHED resp. STATUS_DISCONNECTED for every server still connected */
+void mockConnect();
+void mockDisconnect();
+
+/* Stops the server thread, undelivered answers are dropped */
+void mockStop();
+
+struct MockStats mockStats();
+void mockResetStats();
+
+/* A channel with clients in it other than yourself, 0 if there is none */
+uint64 mockBusyChannel(uint64 serverConnectionHandlerID);
+
+#endif